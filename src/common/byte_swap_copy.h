@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Copies count 16, 32 or 64-bit values from src to dst, swapping the byte
+//  order of each value.  This uses SSSE3 when the host supports it and SSE2
+//  otherwise.  dst may be the same as src to swap in place, but the buffers
+//  must not otherwise overlap.  Neither pointer has to be aligned.
+void
+byte_swap_copy_16(void *dst, const void *src, size_t count);
+
+void
+byte_swap_copy_32(void *dst, const void *src, size_t count);
+
+void
+byte_swap_copy_64(void *dst, const void *src, size_t count);
@@ -0,0 +1,20 @@
+#pragma once
+
+// Optional instruction set extensions which the host CPU supports, and which
+//  the operating system has enabled where that matters.  FMA3 and AVX are
+//  only reported when the OS saves the YMM register state (OSXSAVE + XCR0).
+struct CpuFeatures
+{
+   bool ssse3 = false;
+   bool sse42 = false;
+   bool avx = false;
+   bool fma3 = false;
+   bool movbe = false;
+   bool lzcnt = false;
+   bool bmi1 = false;
+   bool bmi2 = false;
+};
+
+// Detected on the first call, safe to call from multiple threads.
+const CpuFeatures &
+getCpuFeatures();
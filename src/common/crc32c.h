@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Computes a 64-bit change detection hash of a block of memory, made from
+//  two interleaved CRC32C streams.  This uses the SSE4.2 crc32 instruction
+//  when the host supports it and a table driven implementation otherwise.
+//  It is meant for detecting modifications, not for hash tables.
+uint64_t
+crc32c_x2_64(const void *data, size_t size);
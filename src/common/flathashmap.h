@@ -0,0 +1,276 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Mixes the bits of a 64-bit key, this is needed because most of our keys
+//  are built from guest addresses shifted into the high bits, which would
+//  otherwise all land in the same bucket.
+inline uint64_t
+flatHashMix64(uint64_t value)
+{
+   value ^= value >> 33;
+   value *= 0xff51afd7ed558ccdull;
+   value ^= value >> 33;
+   value *= 0xc4ceb9fe1a85ec53ull;
+   value ^= value >> 33;
+   return value;
+}
+
+struct FlatHash64
+{
+   uint64_t operator()(uint64_t key) const
+   {
+      return flatHashMix64(key);
+   }
+};
+
+/*
+ * Open addressing hash table with linear probing.
+ *
+ * The 64-bit hash of every key is computed once on insert and stored next to
+ * the entry, so probing only has to compare keys on a hash match and growing
+ * the table never rehashes keys.
+ *
+ * Entries live inline in a single array, which means references returned by
+ * operator[] or find() are invalidated when a new key is inserted and the
+ * table grows.  Store pointers as the value if stable references are needed.
+ * Looking up a key which already exists never moves entries.
+ *
+ * Erased entries leave a tombstone behind so probe sequences running through
+ * them are not cut short, inserts reuse tombstones and growing the table
+ * drops them.
+ */
+template<typename KeyType, typename ValueType, typename HashType = FlatHash64>
+class FlatHashMap
+{
+   static const size_t MinimumCapacity = 16;
+
+   struct Slot
+   {
+      uint64_t hash = 0;
+      bool used = false;
+      bool deleted = false;
+      std::pair<KeyType, ValueType> entry;
+   };
+
+public:
+   class iterator
+   {
+   public:
+      iterator(Slot *slot, Slot *end) :
+         mSlot(slot),
+         mEnd(end)
+      {
+         skipUnused();
+      }
+
+      std::pair<KeyType, ValueType> &operator*() const
+      {
+         return mSlot->entry;
+      }
+
+      std::pair<KeyType, ValueType> *operator->() const
+      {
+         return &mSlot->entry;
+      }
+
+      iterator &operator++()
+      {
+         ++mSlot;
+         skipUnused();
+         return *this;
+      }
+
+      bool operator==(const iterator &other) const
+      {
+         return mSlot == other.mSlot;
+      }
+
+      bool operator!=(const iterator &other) const
+      {
+         return mSlot != other.mSlot;
+      }
+
+   private:
+      void skipUnused()
+      {
+         while (mSlot != mEnd && !mSlot->used) {
+            ++mSlot;
+         }
+      }
+
+   private:
+      Slot *mSlot;
+      Slot *mEnd;
+   };
+
+public:
+   iterator begin()
+   {
+      return iterator { mSlots.data(), mSlots.data() + mSlots.size() };
+   }
+
+   iterator end()
+   {
+      return iterator { mSlots.data() + mSlots.size(), mSlots.data() + mSlots.size() };
+   }
+
+   size_t size() const
+   {
+      return mSize;
+   }
+
+   bool empty() const
+   {
+      return mSize == 0;
+   }
+
+   void clear()
+   {
+      mSlots.clear();
+      mSize = 0;
+      mDeleted = 0;
+   }
+
+   ValueType *find(const KeyType &key)
+   {
+      if (mSlots.empty()) {
+         return nullptr;
+      }
+
+      auto &slot = mSlots[findSlot(HashType {}(key), key)];
+
+      if (!slot.used) {
+         return nullptr;
+      }
+
+      return &slot.entry.second;
+   }
+
+   ValueType &operator[](const KeyType &key)
+   {
+      auto hash = HashType {}(key);
+
+      if (!mSlots.empty()) {
+         auto &slot = mSlots[findSlot(hash, key)];
+
+         if (slot.used) {
+            return slot.entry.second;
+         }
+      }
+
+      // Keep the load factor, tombstones included, at or below 1/2 so probe
+      //  sequences stay short
+      if ((mSize + mDeleted + 1) * 2 > mSlots.size()) {
+         grow();
+      }
+
+      auto &slot = mSlots[findInsertSlot(hash)];
+
+      if (slot.deleted) {
+         slot.deleted = false;
+         --mDeleted;
+      }
+
+      slot.hash = hash;
+      slot.used = true;
+      slot.entry.first = key;
+      slot.entry.second = ValueType {};
+      ++mSize;
+      return slot.entry.second;
+   }
+
+   bool erase(const KeyType &key)
+   {
+      if (mSlots.empty()) {
+         return false;
+      }
+
+      auto &slot = mSlots[findSlot(HashType {}(key), key)];
+
+      if (!slot.used) {
+         return false;
+      }
+
+      // Reset the entry so its value is destroyed now rather than on reuse
+      slot.used = false;
+      slot.deleted = true;
+      slot.entry = std::pair<KeyType, ValueType> {};
+      --mSize;
+      ++mDeleted;
+      return true;
+   }
+
+private:
+   // Returns the slot holding key, or the empty slot which ends its probe
+   //  sequence if it is not in the table.
+   size_t findSlot(uint64_t hash, const KeyType &key) const
+   {
+      auto mask = mSlots.size() - 1;
+      auto index = static_cast<size_t>(hash) & mask;
+
+      while (mSlots[index].used || mSlots[index].deleted) {
+         auto &slot = mSlots[index];
+
+         if (slot.used && slot.hash == hash && slot.entry.first == key) {
+            break;
+         }
+
+         index = (index + 1) & mask;
+      }
+
+      return index;
+   }
+
+   // Returns the first empty slot or tombstone in the probe sequence of hash
+   size_t findInsertSlot(uint64_t hash) const
+   {
+      auto mask = mSlots.size() - 1;
+      auto index = static_cast<size_t>(hash) & mask;
+
+      while (mSlots[index].used) {
+         index = (index + 1) & mask;
+      }
+
+      return index;
+   }
+
+   void grow()
+   {
+      // Only double the capacity if the live entries need it, otherwise this
+      //  is just rehashing in place to get rid of tombstones.
+      auto capacity = MinimumCapacity;
+
+      if (!mSlots.empty()) {
+         capacity = (mSize + 1) * 4 > mSlots.size() ? mSlots.size() * 2 : mSlots.size();
+      }
+
+      auto oldSlots = std::vector<Slot>(capacity);
+      std::swap(oldSlots, mSlots);
+
+      auto mask = capacity - 1;
+
+      for (auto &oldSlot : oldSlots) {
+         if (!oldSlot.used) {
+            continue;
+         }
+
+         auto index = static_cast<size_t>(oldSlot.hash) & mask;
+
+         while (mSlots[index].used) {
+            index = (index + 1) & mask;
+         }
+
+         mSlots[index] = std::move(oldSlot);
+      }
+
+      mDeleted = 0;
+   }
+
+private:
+   std::vector<Slot> mSlots;
+   size_t mSize = 0;
+   size_t mDeleted = 0;
+};
@@ -28,4 +28,10 @@ uncommitMemory(size_t address, size_t size);
 bool
 protectMemory(size_t address, size_t size, ProtectFlags flags);
 
+size_t
+getResidentMemorySize(size_t address, size_t size);
+
+bool
+enableHugePages(size_t address, size_t size);
+
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <chrono>
 #include <thread>
 #include <string>
 
@@ -12,4 +13,7 @@ setThreadName(std::thread *thread,
 void
 exitThread(int result);
 
+void
+setCurrentThreadTimerSlack(std::chrono::nanoseconds slack);
+
 } // namespace platform
@@ -0,0 +1,128 @@
+#pragma once
+#include "align.h"
+#include "decaf_assert.h"
+#include <cstddef>
+
+/*
+ * Allocates ranges from a fixed size ring of memory.
+ *
+ * This only manages offsets, the backing memory is owned by the user, which
+ * allows it to sit on top of things such as persistently mapped GPU buffers.
+ *
+ * Allocations must be released in the same order they were allocated in, this
+ * fits with memory which is consumed by a queue of work such as a GPU command
+ * stream where each allocation is released once a fence signals.
+ */
+class RingAllocator
+{
+public:
+   struct Allocation
+   {
+      //! Offset of the allocation from the start of the ring
+      size_t offset = 0;
+
+      //! Size of the allocation, aligned up to the ring alignment
+      size_t size = 0;
+
+      //! Number of bytes this allocation occupies in the ring, this includes
+      //!  any space skipped at the end of the ring when wrapping around
+      size_t consumed = 0;
+   };
+
+   RingAllocator(size_t size, size_t alignment) :
+      mSize(size),
+      mAlignment(alignment)
+   {
+   }
+
+   size_t
+   getSize() const
+   {
+      return mSize;
+   }
+
+   size_t
+   getUsedSize() const
+   {
+      return mUsed;
+   }
+
+   bool
+   allocate(size_t size,
+            Allocation &allocation)
+   {
+      size = align_up(size, mAlignment);
+
+      if (size == 0 || size > mSize) {
+         return false;
+      }
+
+      if (mUsed == 0) {
+         // Nothing is in flight, so start again from the beginning to keep
+         //  allocations contiguous for as long as possible
+         mHead = 0;
+         mTail = 0;
+      } else if (mHead == mTail) {
+         // The ring is completely full
+         return false;
+      }
+
+      if (mHead >= mTail) {
+         if (mSize - mHead >= size) {
+            allocation.offset = mHead;
+            allocation.consumed = size;
+         } else if (mTail >= size) {
+            // Skip the space at the end of the ring and wrap around
+            allocation.offset = 0;
+            allocation.consumed = (mSize - mHead) + size;
+         } else {
+            return false;
+         }
+      } else {
+         if (mTail - mHead >= size) {
+            allocation.offset = mHead;
+            allocation.consumed = size;
+         } else {
+            return false;
+         }
+      }
+
+      allocation.size = size;
+      mHead = allocation.offset + size;
+      mUsed += allocation.consumed;
+
+      if (mHead == mSize) {
+         mHead = 0;
+      }
+
+      return true;
+   }
+
+   void
+   release(const Allocation &allocation)
+   {
+      decaf_check(allocation.consumed <= mUsed);
+      mUsed -= allocation.consumed;
+      mTail = allocation.offset + allocation.size;
+
+      if (mTail == mSize) {
+         mTail = 0;
+      }
+   }
+
+private:
+   //! Total size of the ring
+   size_t mSize;
+
+   //! Alignment of every allocation
+   size_t mAlignment;
+
+   //! Offset where the next allocation will start
+   size_t mHead = 0;
+
+   //! Offset of the oldest allocation which has not been released
+   size_t mTail = 0;
+
+   //! Number of bytes currently allocated, including skipped space
+   size_t mUsed = 0;
+};
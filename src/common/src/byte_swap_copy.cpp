@@ -0,0 +1,131 @@
+#include "byte_swap_copy.h"
+#include "byte_swap.h"
+#include "cpufeatures.h"
+#include "platform.h"
+#include <cstring>
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#ifdef PLATFORM_WINDOWS
+#define BYTE_SWAP_TARGET_SSSE3
+#else
+#define BYTE_SWAP_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+template<typename Type>
+static inline void
+byteSwapTail(uint8_t *dst, const uint8_t *src, size_t count)
+{
+   for (auto i = 0u; i < count; ++i) {
+      Type value;
+      std::memcpy(&value, src + i * sizeof(Type), sizeof(Type));
+      value = byte_swap(value);
+      std::memcpy(dst + i * sizeof(Type), &value, sizeof(Type));
+   }
+}
+
+BYTE_SWAP_TARGET_SSSE3 static __m128i
+getShuffleMask(size_t elementSize)
+{
+   if (elementSize == 2) {
+      return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+   } else if (elementSize == 4) {
+      return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+   } else {
+      return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+   }
+}
+
+// Returns the number of bytes it swapped, always a multiple of 16
+BYTE_SWAP_TARGET_SSSE3 static size_t
+byteSwapSSSE3(uint8_t *dst, const uint8_t *src, size_t size, size_t elementSize)
+{
+   auto mask = getShuffleMask(elementSize);
+   auto done = size_t { 0 };
+
+   for (; done + 64 <= size; done += 64) {
+      auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done));
+      auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done + 16));
+      auto c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done + 32));
+      auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done + 48));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done), _mm_shuffle_epi8(a, mask));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done + 16), _mm_shuffle_epi8(b, mask));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done + 32), _mm_shuffle_epi8(c, mask));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done + 48), _mm_shuffle_epi8(d, mask));
+   }
+
+   for (; done + 16 <= size; done += 16) {
+      auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done), _mm_shuffle_epi8(a, mask));
+   }
+
+   return done;
+}
+
+static inline __m128i
+swapBytesSSE2(__m128i value, size_t elementSize)
+{
+   // Reorder the 16-bit words within each element first, then swap the
+   //  two bytes of every word.
+   if (elementSize == 4) {
+      value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+      value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+   } else if (elementSize == 8) {
+      value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+      value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+   }
+
+   return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+}
+
+// Returns the number of bytes it swapped, always a multiple of 16
+static size_t
+byteSwapSSE2(uint8_t *dst, const uint8_t *src, size_t size, size_t elementSize)
+{
+   auto done = size_t { 0 };
+
+   for (; done + 16 <= size; done += 16) {
+      auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done), swapBytesSSE2(a, elementSize));
+   }
+
+   return done;
+}
+
+template<typename Type>
+static void
+byteSwapCopy(void *dst, const void *src, size_t count)
+{
+   static const auto useSSSE3 = getCpuFeatures().ssse3;
+   auto dstBytes = reinterpret_cast<uint8_t *>(dst);
+   auto srcBytes = reinterpret_cast<const uint8_t *>(src);
+   auto size = count * sizeof(Type);
+   auto done = size_t { 0 };
+
+   if (useSSSE3) {
+      done = byteSwapSSSE3(dstBytes, srcBytes, size, sizeof(Type));
+   } else {
+      done = byteSwapSSE2(dstBytes, srcBytes, size, sizeof(Type));
+   }
+
+   byteSwapTail<Type>(dstBytes + done, srcBytes + done, (size - done) / sizeof(Type));
+}
+
+void
+byte_swap_copy_16(void *dst, const void *src, size_t count)
+{
+   byteSwapCopy<uint16_t>(dst, src, count);
+}
+
+void
+byte_swap_copy_32(void *dst, const void *src, size_t count)
+{
+   byteSwapCopy<uint32_t>(dst, src, count);
+}
+
+void
+byte_swap_copy_64(void *dst, const void *src, size_t count)
+{
+   byteSwapCopy<uint64_t>(dst, src, count);
+}
@@ -0,0 +1,89 @@
+#include "cpufeatures.h"
+#include "platform.h"
+#include <cstdint>
+
+#ifdef PLATFORM_WINDOWS
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static void
+cpuid(uint32_t leaf,
+      uint32_t subleaf,
+      uint32_t regs[4])
+{
+#ifdef PLATFORM_WINDOWS
+   int cpuInfo[4];
+   __cpuidex(cpuInfo, static_cast<int>(leaf), static_cast<int>(subleaf));
+
+   for (auto i = 0; i < 4; ++i) {
+      regs[i] = static_cast<uint32_t>(cpuInfo[i]);
+   }
+#else
+   __asm__("cpuid"
+           : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+           : "0" (leaf), "2" (subleaf));
+#endif
+}
+
+// Only valid to call when CPUID reports OSXSAVE
+static uint64_t
+xgetbv(uint32_t index)
+{
+#ifdef PLATFORM_WINDOWS
+   return _xgetbv(index);
+#else
+   uint32_t eax, edx;
+   __asm__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (index));
+   return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static CpuFeatures
+detectCpuFeatures()
+{
+   CpuFeatures features;
+   uint32_t regs[4];
+
+   cpuid(0, 0, regs);
+   auto maxLeaf = regs[0];
+
+   // CPUID leaf 1 ECX
+   cpuid(1, 0, regs);
+   features.ssse3 = (regs[2] & (1 << 9)) != 0;
+   features.sse42 = (regs[2] & (1 << 20)) != 0;
+   features.movbe = (regs[2] & (1 << 22)) != 0;
+
+   // VEX encoded SSE / AVX instructions fault unless the OS has enabled the
+   //  XMM and YMM state components in XCR0.
+   auto osxsave = (regs[2] & (1 << 27)) != 0;
+   auto cpuAVX = (regs[2] & (1 << 28)) != 0;
+   auto cpuFMA3 = (regs[2] & (1 << 12)) != 0;
+   auto osYMM = osxsave && (xgetbv(0) & 0x6) == 0x6;
+   features.avx = cpuAVX && osYMM;
+   features.fma3 = features.avx && cpuFMA3;
+
+   // CPUID leaf 7 EBX, BMI only operates on general purpose registers
+   if (maxLeaf >= 7) {
+      cpuid(7, 0, regs);
+      features.bmi1 = (regs[1] & (1 << 3)) != 0;
+      features.bmi2 = (regs[1] & (1 << 8)) != 0;
+   }
+
+   // CPUID leaf 0x80000001 ECX
+   cpuid(0x80000000, 0, regs);
+
+   if (regs[0] >= 0x80000001) {
+      cpuid(0x80000001, 0, regs);
+      features.lzcnt = (regs[2] & (1 << 5)) != 0;
+   }
+
+   return features;
+}
+
+const CpuFeatures &
+getCpuFeatures()
+{
+   static const CpuFeatures features = detectCpuFeatures();
+   return features;
+}
@@ -0,0 +1,100 @@
+#include "cpufeatures.h"
+#include "crc32c.h"
+#include "platform.h"
+#include <cstring>
+
+#include <nmmintrin.h>
+
+#ifdef PLATFORM_WINDOWS
+#define CRC32C_TARGET_SSE42
+#else
+#define CRC32C_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+static const uint32_t
+Crc32cPolynomial = 0x82F63B78;
+
+static uint32_t
+sCrc32cTable[256];
+
+static void
+initialiseTable()
+{
+   for (auto i = 0u; i < 256; ++i) {
+      auto crc = i;
+
+      for (auto j = 0; j < 8; ++j) {
+         crc = (crc >> 1) ^ ((crc & 1) ? Crc32cPolynomial : 0);
+      }
+
+      sCrc32cTable[i] = crc;
+   }
+}
+
+static bool
+initialise()
+{
+   initialiseTable();
+   return getCpuFeatures().sse42;
+}
+
+static inline uint32_t
+crc32cByteSoftware(uint32_t crc, uint8_t value)
+{
+   return sCrc32cTable[(crc ^ value) & 0xFF] ^ (crc >> 8);
+}
+
+static uint64_t
+crc32cSoftware(const uint8_t *data, size_t size)
+{
+   auto crcA = uint32_t { 0xFFFFFFFF };
+   auto crcB = uint32_t { 0xFFFFFFFF };
+
+   for (; size >= 16; size -= 16, data += 16) {
+      for (auto i = 0; i < 8; ++i) {
+         crcA = crc32cByteSoftware(crcA, data[i]);
+         crcB = crc32cByteSoftware(crcB, data[8 + i]);
+      }
+   }
+
+   for (; size > 0; --size, ++data) {
+      crcA = crc32cByteSoftware(crcA, *data);
+   }
+
+   return (static_cast<uint64_t>(~crcB) << 32) | ~crcA;
+}
+
+CRC32C_TARGET_SSE42 static uint64_t
+crc32cSSE42(const uint8_t *data, size_t size)
+{
+   auto crcA = uint64_t { 0xFFFFFFFF };
+   auto crcB = uint64_t { 0xFFFFFFFF };
+
+   // Two independent streams hide the latency of the crc32 instruction
+   for (; size >= 16; size -= 16, data += 16) {
+      uint64_t a, b;
+      std::memcpy(&a, data, 8);
+      std::memcpy(&b, data + 8, 8);
+      crcA = _mm_crc32_u64(crcA, a);
+      crcB = _mm_crc32_u64(crcB, b);
+   }
+
+   for (; size > 0; --size, ++data) {
+      crcA = _mm_crc32_u8(static_cast<uint32_t>(crcA), *data);
+   }
+
+   return (static_cast<uint64_t>(~static_cast<uint32_t>(crcB)) << 32) | ~static_cast<uint32_t>(crcA);
+}
+
+uint64_t
+crc32c_x2_64(const void *data, size_t size)
+{
+   static const auto useSSE42 = initialise();
+   auto bytes = reinterpret_cast<const uint8_t *>(data);
+
+   if (useSSE42) {
+      return crc32cSSE42(bytes, size);
+   } else {
+      return crc32cSoftware(bytes, size);
+   }
+}
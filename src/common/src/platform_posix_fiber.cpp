@@ -1,34 +1,190 @@
+#include "decaf_assert.h"
 #include "platform.h"
 #include "platform_fiber.h"
 #include "log.h"
 
 #ifdef PLATFORM_POSIX
-#include <array>
+#include <cstdint>
 #include <errno.h>
+#include <mutex>
 #include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __x86_64__
+#define DECAF_FIBER_ASM
+#else
 #include <ucontext.h>
+#endif
 
 #ifdef DECAF_VALGRIND
    #include <valgrind/valgrind.h>
 #endif
 
+#ifdef DECAF_FIBER_ASM
+
+#ifdef PLATFORM_APPLE
+#define FIBER_ASM_SYMBOL(name) "_" #name
+#else
+#define FIBER_ASM_SYMBOL(name) #name
+#endif
+
+/*
+ * swapcontext saves and restores the signal mask, which on glibc means an
+ * rt_sigprocmask syscall for every switch.  We never change the signal mask
+ * per fiber, so instead we switch stacks by hand and only save what the
+ * System V x86-64 ABI requires to be preserved across a call: the callee
+ * saved registers plus the MXCSR and x87 control words.
+ *
+ * Layout of a suspended fiber's stack, from the saved stack pointer upwards:
+ *    +0   MXCSR
+ *    +4   x87 control word
+ *    +8   r15
+ *    +16  r14
+ *    +24  r13
+ *    +32  r12
+ *    +40  rbx
+ *    +48  rbp
+ *    +56  return address
+ */
+extern "C" void
+platformFiberSwitch(void **saveStackPointer, void *loadStackPointer);
+
+extern "C" void
+platformFiberStart();
+
+asm(R"(
+   .text
+   .globl )" FIBER_ASM_SYMBOL(platformFiberSwitch) R"(
+   .p2align 4
+)" FIBER_ASM_SYMBOL(platformFiberSwitch) R"(:
+   pushq %rbp
+   pushq %rbx
+   pushq %r12
+   pushq %r13
+   pushq %r14
+   pushq %r15
+   subq $8, %rsp
+   stmxcsr (%rsp)
+   fnstcw 4(%rsp)
+   movq %rsp, (%rdi)
+   movq %rsi, %rsp
+   ldmxcsr (%rsp)
+   fldcw 4(%rsp)
+   addq $8, %rsp
+   popq %r15
+   popq %r14
+   popq %r13
+   popq %r12
+   popq %rbx
+   popq %rbp
+   ret
+
+   .globl )" FIBER_ASM_SYMBOL(platformFiberStart) R"(
+   .p2align 4
+)" FIBER_ASM_SYMBOL(platformFiberStart) R"(:
+   movq %r12, %rdi
+   callq *%r13
+   ud2
+)");
+
+#endif // DECAF_FIBER_ASM
+
 namespace platform
 {
 
 static const size_t
 DefaultStackSize = 1024 * 1024;
 
+// Number of unused stacks we keep around for new fibers to reuse
+static const size_t
+MaxFreeStacks = 32;
+
 struct Fiber
 {
+#ifdef DECAF_FIBER_ASM
+   void *stackPointer = nullptr;
+#else
    ucontext_t context;
+#endif
    FiberEntryPoint entry = nullptr;
    void *entryParam = nullptr;
 #ifdef DECAF_VALGRIND
    unsigned int valgrindStackId;
 #endif
-   std::array<char, DefaultStackSize> stack;
+   uint8_t *stack = nullptr;
+   size_t stackSize = 0;
 };
 
+static std::mutex
+sFreeStacksMutex;
+
+static std::vector<uint8_t *>
+sFreeStacks;
+
+static size_t
+getGuardSize()
+{
+   static const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+   return pageSize;
+}
+
+/*
+ * Stacks are mapped with a no access guard page below them so that a stack
+ * overflow faults rather than silently corrupting whatever is next in the
+ * heap.  The rest of the mapping is only backed by physical memory once it
+ * is touched, so a fiber which never uses more than a few pages of stack
+ * only ever commits a few pages.
+ */
+static uint8_t *
+allocateStack()
+{
+   {
+      std::unique_lock<std::mutex> lock { sFreeStacksMutex };
+
+      if (!sFreeStacks.empty()) {
+         auto stack = sFreeStacks.back();
+         sFreeStacks.pop_back();
+         return stack;
+      }
+   }
+
+   auto guardSize = getGuardSize();
+   auto base = mmap(nullptr, guardSize + DefaultStackSize,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                    -1, 0);
+
+   if (base == MAP_FAILED) {
+      decaf_abort(fmt::format("Failed to allocate fiber stack, errno = {}", errno));
+   }
+
+   if (mprotect(base, guardSize, PROT_NONE) != 0) {
+      auto error = errno;
+      munmap(base, guardSize + DefaultStackSize);
+      decaf_abort(fmt::format("Failed to protect fiber stack guard page, errno = {}", error));
+   }
+
+   return reinterpret_cast<uint8_t *>(base) + guardSize;
+}
+
+static void
+freeStack(uint8_t *stack)
+{
+   {
+      std::unique_lock<std::mutex> lock { sFreeStacksMutex };
+
+      if (sFreeStacks.size() < MaxFreeStacks) {
+         sFreeStacks.push_back(stack);
+         return;
+      }
+   }
+
+   auto guardSize = getGuardSize();
+   munmap(stack - guardSize, guardSize + DefaultStackSize);
+}
+
 Fiber *
 getThreadFiber()
 {
@@ -42,23 +198,56 @@ fiberEntryPoint(Fiber *fiber)
    fiber->entry(fiber->entryParam);
 }
 
+#ifdef DECAF_FIBER_ASM
+static void
+initialiseFiberStack(Fiber *fiber)
+{
+   uint32_t mxcsr;
+   uint16_t fpucw;
+   asm volatile("stmxcsr %0" : "=m"(mxcsr));
+   asm volatile("fnstcw %0" : "=m"(fpucw));
+
+   // Align so that platformFiberStart is entered with a 16 byte aligned
+   //  stack, as its call to fiberEntryPoint then pushes the return address.
+   auto top = reinterpret_cast<uintptr_t>(fiber->stack + fiber->stackSize) & ~static_cast<uintptr_t>(15);
+   auto frame = reinterpret_cast<uint64_t *>(top - 16 - 8 * 8);
+
+   frame[0] = mxcsr | (static_cast<uint64_t>(fpucw) << 32);
+   frame[1] = 0; // r15
+   frame[2] = 0; // r14
+   frame[3] = reinterpret_cast<uint64_t>(&fiberEntryPoint); // r13
+   frame[4] = reinterpret_cast<uint64_t>(fiber); // r12
+   frame[5] = 0; // rbx
+   frame[6] = 0; // rbp
+   frame[7] = reinterpret_cast<uint64_t>(&platformFiberStart);
+   fiber->stackPointer = frame;
+}
+#endif
+
 Fiber *
 createFiber(FiberEntryPoint entry, void *entryParam)
 {
+   auto stack = allocateStack();
    auto fiber = new Fiber();
    fiber->entry = entry;
    fiber->entryParam = entryParam;
+   fiber->stack = stack;
+   fiber->stackSize = DefaultStackSize;
 
 #ifdef DECAF_VALGRIND
-   fiber->valgrindStackId = VALGRIND_STACK_REGISTER(&fiber->stack[0], &fiber->stack[fiber->stack.size() - 1]);
+   fiber->valgrindStackId = VALGRIND_STACK_REGISTER(fiber->stack, fiber->stack + fiber->stackSize - 1);
 #endif
 
+#ifdef DECAF_FIBER_ASM
+   initialiseFiberStack(fiber);
+#else
    getcontext(&fiber->context);
-   fiber->context.uc_stack.ss_sp = &fiber->stack[0];
-   fiber->context.uc_stack.ss_size = fiber->stack.size();
+   fiber->context.uc_stack.ss_sp = fiber->stack;
+   fiber->context.uc_stack.ss_size = fiber->stackSize;
    fiber->context.uc_link = nullptr;
 
    makecontext(&fiber->context, reinterpret_cast<void(*)()>(&fiberEntryPoint), 1, fiber);
+#endif
    return fiber;
 }
 
@@ -69,17 +258,31 @@ destroyFiber(Fiber *fiber)
    VALGRIND_STACK_DEREGISTER(fiber->valgrindStackId);
 #endif
 
+   if (fiber->stack) {
+      freeStack(fiber->stack);
+   }
+
    delete fiber;
 }
 
 void
 swapToFiber(Fiber *current, Fiber *target)
 {
+#ifdef DECAF_FIBER_ASM
+   if (!current) {
+      // Nothing will ever switch back to this context
+      void *discard;
+      platformFiberSwitch(&discard, target->stackPointer);
+   } else {
+      platformFiberSwitch(&current->stackPointer, target->stackPointer);
+   }
+#else
    if (!current) {
       setcontext(&target->context);
    } else {
       swapcontext(&current->context, &target->context);
    }
+#endif
 }
 
 } // namespace platform
@@ -2,7 +2,10 @@
 #include "platform_memory.h"
 
 #ifdef PLATFORM_POSIX
+#include <algorithm>
 #include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
 
 namespace platform
 {
@@ -61,10 +64,12 @@ commitMemory(size_t address, size_t size, ProtectFlags flags)
 bool
 uncommitMemory(size_t address, size_t size)
 {
-   // On *nix systems, there is not really a way to forcibly uncommit
-   //   a particular region of code.  We just lock it out.
+   // Mapping fresh anonymous pages over the region throws away the old
+   //  pages, which returns them to the OS, while keeping the address range
+   //  reserved for us.
    auto baseAddress = reinterpret_cast<void *>(address);
-   return mprotect(baseAddress, size, PROT_NONE);
+   auto result = mmap(baseAddress, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+   return result == baseAddress;
 }
 
 bool
@@ -74,6 +79,66 @@ protectMemory(size_t address, size_t size, ProtectFlags flags)
    return mprotect(baseAddress, size, flagsToProt(flags)) == 0;
 }
 
+bool
+enableHugePages(size_t address, size_t size)
+{
+#ifdef PLATFORM_LINUX
+   auto baseAddress = reinterpret_cast<void *>(address);
+
+   // Explicit huge pages are only available when they have been reserved
+   //  through /proc/sys/vm/nr_hugepages, but when they are they are all
+   //  allocated up front and can never be split back into small pages.
+   auto result = mmap(baseAddress, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+
+   if (result == baseAddress) {
+      return true;
+   }
+
+   // A failed MAP_FIXED mmap may have already unmapped the old pages, so
+   //  map normal pages back in and ask for transparent huge pages instead.
+   result = mmap(baseAddress, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+
+   if (result != baseAddress) {
+      return false;
+   }
+
+   return madvise(baseAddress, size, MADV_HUGEPAGE) == 0;
+#else
+   return false;
+#endif
+}
+
+size_t
+getResidentMemorySize(size_t address, size_t size)
+{
+   static const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+   static const size_t PagesPerQuery = 16 * 1024;
+#ifdef PLATFORM_APPLE
+   auto pages = std::vector<char>(PagesPerQuery);
+#else
+   auto pages = std::vector<unsigned char>(PagesPerQuery);
+#endif
+   auto resident = size_t { 0 };
+   auto end = address + size;
+
+   for (auto start = address; start < end; start += PagesPerQuery * pageSize) {
+      auto querySize = std::min(end - start, PagesPerQuery * pageSize);
+      auto numPages = (querySize + pageSize - 1) / pageSize;
+
+      if (mincore(reinterpret_cast<void *>(start), querySize, pages.data()) != 0) {
+         continue;
+      }
+
+      for (auto i = 0u; i < numPages; ++i) {
+         if (pages[i] & 1) {
+            resident += pageSize;
+         }
+      }
+   }
+
+   return resident;
+}
+
 } // namespace platform
 
 #endif
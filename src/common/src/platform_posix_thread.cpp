@@ -5,6 +5,10 @@
 #include <cstdlib>
 #include <pthread.h>
 
+#ifdef PLATFORM_LINUX
+#include <sys/prctl.h>
+#endif
+
 namespace platform
 {
 
@@ -26,6 +30,18 @@ exitThread(int result)
    pthread_exit(res);
 }
 
+/**
+ * Limit how late the kernel may deliver timed waits on this thread, Linux
+ * defaults to 50us which it uses to coalesce wakeups.
+ */
+void
+setCurrentThreadTimerSlack(std::chrono::nanoseconds slack)
+{
+#ifdef PLATFORM_LINUX
+   prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(slack.count()), 0, 0, 0);
+#endif
+}
+
 } // namespace platform
 
 #endif
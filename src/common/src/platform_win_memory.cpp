@@ -2,7 +2,10 @@
 #include "platform_memory.h"
 
 #ifdef PLATFORM_WINDOWS
+#include <algorithm>
+#include <vector>
 #include <Windows.h>
+#include <Psapi.h>
 
 namespace platform
 {
@@ -71,6 +74,44 @@ protectMemory(size_t address, size_t size, ProtectFlags flags)
    return (result != 0);
 }
 
+bool
+enableHugePages(size_t address, size_t size)
+{
+   // Large pages on Windows have to be committed at the same time as they
+   //  are reserved, which does not fit how we reserve the guest address space
+   return false;
+}
+
+size_t
+getResidentMemorySize(size_t address, size_t size)
+{
+   static const size_t PageSize = 4096;
+   static const size_t PagesPerQuery = 16 * 1024;
+   auto pages = std::vector<PSAPI_WORKING_SET_EX_INFORMATION>(PagesPerQuery);
+   auto resident = size_t { 0 };
+   auto end = address + size;
+
+   for (auto start = address; start < end; start += PagesPerQuery * PageSize) {
+      auto numPages = std::min((end - start + PageSize - 1) / PageSize, PagesPerQuery);
+
+      for (auto i = 0u; i < numPages; ++i) {
+         pages[i].VirtualAddress = reinterpret_cast<PVOID>(start + i * PageSize);
+      }
+
+      if (!QueryWorkingSetEx(GetCurrentProcess(), pages.data(), static_cast<DWORD>(numPages * sizeof(pages[0])))) {
+         continue;
+      }
+
+      for (auto i = 0u; i < numPages; ++i) {
+         if (pages[i].VirtualAttributes.Valid) {
+            resident += PageSize;
+         }
+      }
+   }
+
+   return resident;
+}
+
 } // namespace platform
 
 #endif
@@ -46,6 +46,12 @@ exitThread(int result)
    ExitThread(result);
 }
 
+void
+setCurrentThreadTimerSlack(std::chrono::nanoseconds slack)
+{
+   // Windows has no per thread timer slack, only the global timer resolution
+}
+
 } // namespace platform
 
 #endif
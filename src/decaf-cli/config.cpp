@@ -14,6 +14,8 @@ bool async = false;
 bool to_file = false;
 bool to_stdout = true;
 std::string level = "debug";
+std::string scheduler_trace_path;
+std::string jit_profile_path;
 
 } // namespace log
 
@@ -31,7 +33,8 @@ struct CerealDebugger
    {
       using namespace decaf::config::debugger;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(break_on_entry));
+         CEREAL_NVP(break_on_entry),
+         CEREAL_NVP(scheduler_checks));
    }
 };
 
@@ -46,6 +49,8 @@ struct CerealLog
          CEREAL_NVP(to_file),
          CEREAL_NVP(to_stdout),
          CEREAL_NVP(kernel_trace),
+         CEREAL_NVP(instruction_trace),
+         CEREAL_NVP(scheduler_trace),
          CEREAL_NVP(level));
    }
 };
@@ -57,7 +62,8 @@ struct CerealJit
    {
       using namespace decaf::config::jit;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(verify));
+         CEREAL_NVP(verify),
+         CEREAL_NVP(profile));
    }
 };
 
@@ -80,7 +86,9 @@ struct CerealSystem
       using namespace decaf::config::system;
       ar(CEREAL_NVP(region),
          CEREAL_NVP(mlc_path),
-         CEREAL_NVP(timeout_ms));
+         CEREAL_NVP(timeout_ms),
+         CEREAL_NVP(huge_pages),
+         CEREAL_NVP(redirect_libc));
    }
 };
 
@@ -18,6 +18,8 @@ extern bool async;
 extern bool to_file;
 extern bool to_stdout;
 extern std::string level;
+extern std::string scheduler_trace_path;
+extern std::string jit_profile_path;
 
 } // namespace log
 
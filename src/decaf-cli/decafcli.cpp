@@ -69,6 +69,26 @@ DecafCLI::run(const std::string &gamePath)
       timeoutThread.join();
    }
 
+   if (!config::log::scheduler_trace_path.empty()) {
+      if (decaf::writeSchedulerTrace(config::log::scheduler_trace_path)) {
+         gCliLog->info("Wrote scheduler trace to {}", config::log::scheduler_trace_path);
+      } else {
+         gCliLog->error("Failed to write scheduler trace to {}", config::log::scheduler_trace_path);
+      }
+   }
+
+   if (!config::log::jit_profile_path.empty()) {
+      if (decaf::writeJitProfile(config::log::jit_profile_path)) {
+         gCliLog->info("Wrote JIT profile to {}", config::log::jit_profile_path);
+      } else {
+         gCliLog->error("Failed to write JIT profile to {}", config::log::jit_profile_path);
+      }
+
+      if (!decaf::writeJitPerfMap()) {
+         gCliLog->warn("Failed to write JIT perf map");
+      }
+   }
+
    // Wait for the GPU thread to exit
    if (graphicsThread.joinable()) {
       graphicsThread.join();
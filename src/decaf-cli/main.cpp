@@ -37,7 +37,10 @@ getCommandLineParser()
       .add_option("jit",
                   description { "Enables the JIT engine." })
       .add_option("jit-verify",
-                  description { "Verify JIT implementation against interpreter." });
+                  description { "Verify JIT implementation against interpreter." })
+      .add_option("jit-profile",
+                  description { "Write a profile of JIT blocks to this file and a perf map to /tmp on exit." },
+                  value<std::string> {});
 
    auto log_options = parser.add_option_group("Log Options")
       .add_option("log-file",
@@ -52,7 +55,10 @@ getCommandLineParser()
                   allowed<std::string> { {
                      "trace", "debug", "info", "notice", "warning",
                      "error", "critical", "alert", "emerg", "off"
-                  } });
+                  } })
+      .add_option("scheduler-trace",
+                  description { "Write a Chrome trace of guest thread scheduling to this file on exit." },
+                  value<std::string> {});
 
    auto sys_options = parser.add_option_group("System Options")
       .add_option("config",
@@ -72,7 +78,11 @@ getCommandLineParser()
                   default_value<double> { 1.0 })
       .add_option("timeout_ms",
                   description { "How long to execute the game for before quitting." },
-                  value<uint32_t> {});
+                  value<uint32_t> {})
+      .add_option("huge-pages",
+                  description { "Back guest memory with huge pages where supported." })
+      .add_option("redirect-libc",
+                  description { "Replace recognised guest libc functions with host implementations." });
 
    parser.add_command("play")
       .add_option_group(jit_options)
@@ -142,6 +152,11 @@ start(excmd::parser &parser,
       decaf::config::jit::enabled = true;
    }
 
+   if (options.has("jit-profile")) {
+      config::log::jit_profile_path = options.get<std::string>("jit-profile");
+      decaf::config::jit::profile = true;
+   }
+
    if (options.has("log-no-stdout")) {
       config::log::to_stdout = true;
    }
@@ -158,6 +173,11 @@ start(excmd::parser &parser,
       config::log::level = options.get<std::string>("log-level");
    }
 
+   if (options.has("scheduler-trace")) {
+      config::log::scheduler_trace_path = options.get<std::string>("scheduler-trace");
+      decaf::config::log::scheduler_trace = true;
+   }
+
    if (options.has("region")) {
       const std::string region = options.get<std::string>("region");
       if (region.compare("JAP") == 0) {
@@ -183,6 +203,14 @@ start(excmd::parser &parser,
       config::system::timeout_ms = options.get<uint32_t>("timeout_ms");
    }
 
+   if (options.has("huge-pages")) {
+      decaf::config::system::huge_pages = true;
+   }
+
+   if (options.has("redirect-libc")) {
+      decaf::config::system::redirect_libc = true;
+   }
+
    auto gamePath = options.get<std::string>("game directory");
    auto logFile = getPathBasename(gamePath);
    auto logLevel = spdlog::level::info;
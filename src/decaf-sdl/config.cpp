@@ -92,7 +92,8 @@ struct CerealDebugger
    {
       using namespace decaf::config::debugger;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(break_on_entry));
+         CEREAL_NVP(break_on_entry),
+         CEREAL_NVP(scheduler_checks));
    }
 };
 
@@ -168,6 +169,8 @@ struct CerealLog
          CEREAL_NVP(kernel_trace_res),
          CEREAL_NVP(kernel_trace_filters),
          CEREAL_NVP(branch_trace),
+         CEREAL_NVP(instruction_trace),
+         CEREAL_NVP(scheduler_trace),
          CEREAL_NVP(level));
    }
 };
@@ -179,7 +182,8 @@ struct CerealJit
    {
       using namespace decaf::config::jit;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(verify));
+         CEREAL_NVP(verify),
+         CEREAL_NVP(profile));
    }
 };
 
@@ -200,7 +204,9 @@ struct CerealSystem
    {
       using namespace decaf::config::system;
       ar(CEREAL_NVP(region),
-         CEREAL_NVP(mlc_path));
+         CEREAL_NVP(mlc_path),
+         CEREAL_NVP(huge_pages),
+         CEREAL_NVP(redirect_libc));
    }
 };
 
@@ -111,7 +111,11 @@ getCommandLineParser()
                   value<std::string> {})
       .add_option("time-scale",
                   description { "Time scale factor for emulated clock." },
-                  default_value<double> { 1.0 });
+                  default_value<double> { 1.0 })
+      .add_option("huge-pages",
+                  description { "Back guest memory with huge pages where supported." })
+      .add_option("redirect-libc",
+                  description { "Replace recognised guest libc functions with host implementations." });
 
    parser.add_command("play")
       .add_option_group(gpu_options)
@@ -280,6 +284,14 @@ start(excmd::parser &parser,
       decaf::config::system::time_scale = options.get<double>("time-scale");
    }
 
+   if (options.has("huge-pages")) {
+      decaf::config::system::huge_pages = true;
+   }
+
+   if (options.has("redirect-libc")) {
+      decaf::config::system::redirect_libc = true;
+   }
+
    auto gamePath = options.get<std::string>("game directory");
    auto logFile = config::log::directory + "/" + getPathBasename(gamePath);
    auto logLevel = spdlog::level::info;
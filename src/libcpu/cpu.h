@@ -3,6 +3,7 @@
 #include <atomic>
 #include <functional>
 #include <utility>
+#include <vector>
 #include "state.h"
 #include "common/types.h"
 
@@ -26,6 +27,13 @@ const uint32_t USER_BPFLAG = 1 << 1;
 
 const uint32_t InvalidCoreId = 0xFF;
 
+// The kernel call never switches thread or otherwise changes nia
+const uint32_t KCFLAG_NO_RESCHEDULE = 1 << 0;
+
+// The kernel call touches no guest registers other than those in its
+//  gpr_reads and gpr_writes masks, and r1 which it restores.
+const uint32_t KCFLAG_ARGUMENTS_ONLY = 1 << 1;
+
 enum class jit_mode {
    disabled,
    enabled,
@@ -45,6 +53,59 @@ struct KernelCallEntry
 {
    KernelCallFunction func;
    void *user_data;
+
+   //! KCFLAG_* flags describing what the call may do
+   uint32_t flags = 0;
+
+   //! Mask of the GPRs the call reads, used with KCFLAG_ARGUMENTS_ONLY
+   uint32_t gpr_reads = 0xFFFFFFFF;
+
+   //! Mask of the GPRs the call writes, used with KCFLAG_ARGUMENTS_ONLY
+   uint32_t gpr_writes = 0xFFFFFFFF;
+};
+
+struct AlarmLatencyStats
+{
+   //! Number of alarm interrupts raised by the timer thread
+   uint64_t count = 0;
+
+   //! Total time between when alarms were due and when they were raised
+   std::chrono::nanoseconds total { 0 };
+
+   //! Largest time between when an alarm was due and when it was raised
+   std::chrono::nanoseconds max { 0 };
+
+   //! Sum of squared lateness in nanoseconds, used to calculate jitter
+   double totalSquared = 0.0;
+};
+
+struct JitBlockProfile
+{
+   //! Guest address of the first instruction in the block
+   uint32_t address;
+
+   //! Number of guest instructions in the block
+   uint32_t instructions;
+
+   //! Host code generated for the block, for a block thrown away by a cache
+   //! clear this range may since have been reused by newer blocks
+   const void *hostStart;
+   size_t hostSize;
+
+   //! Number of times the block was entered at its start
+   uint64_t entries;
+
+   //! Number of profiler samples taken while executing the block
+   uint64_t samples;
+};
+
+struct JitProfile
+{
+   //! Every block generated while profiling since the JIT cache was cleared
+   std::vector<JitBlockProfile> blocks;
+
+   //! Total profiler samples taken, including those outside of JIT code
+   uint64_t samples = 0;
 };
 
 void
@@ -109,6 +170,15 @@ removeBreakpoint(ppcaddr_t address,
 uint64_t *
 getJitFallbackStats();
 
+AlarmLatencyStats
+getAlarmLatencyStats();
+
+void
+setJitProfilingEnabled(bool enabled);
+
+JitProfile
+getJitProfile();
+
 namespace this_core
 {
 
@@ -142,6 +212,9 @@ setNextAlarm(std::chrono::steady_clock::time_point alarm_time);
 cpu::Core *
 state();
 
+void
+setState(cpu::Core *core);
+
 static uint32_t id()
 {
    auto core = state();
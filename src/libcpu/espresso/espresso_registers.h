@@ -134,8 +134,8 @@ enum Value : uint32_t {
    VXCVIShift  = 8,
 
    FX       = 1u << FXShift,
-   FEX      = 1u << FXShift,
-   VX       = 1u << FXShift,
+   FEX      = 1u << FEXShift,
+   VX       = 1u << VXShift,
    OX       = 1u << OXShift,
    UX       = 1u << UXShift,
    ZX       = 1u << ZXShift,
@@ -3,6 +3,8 @@
 #include "common/decaf_assert.h"
 #include "common/types.h"
 #include <cassert>
+#include <string>
+#include <vector>
 
 namespace mem
 {
@@ -49,6 +51,9 @@ enum AddressSpace : ppcaddr_t
    LoaderSize        = LoaderEnd - LoaderBase,
 };
 
+void
+setHugePagesEnabled(bool enabled);
+
 void
 initialise();
 
@@ -64,6 +69,20 @@ commit(ppcaddr_t address, ppcaddr_t size);
 bool
 uncommit(ppcaddr_t address, ppcaddr_t size);
 
+struct MappingUsage
+{
+   std::string name;
+   ppcaddr_t start;
+   ppcaddr_t end;
+   bool committed;
+
+   //! Number of bytes of the mapping which are backed by physical memory
+   size_t resident;
+};
+
+std::vector<MappingUsage>
+getMappingUsage();
+
 // Translate WiiU virtual address to host address
 template<typename Type = uint8_t>
 inline Type *
@@ -225,6 +225,16 @@ state()
    return tCurrentCore;
 }
 
+/**
+ * Bind a core to the calling host thread, for tools which run guest code
+ * on their own threads rather than on the threads created by start().
+ */
+void
+setState(cpu::Core *core)
+{
+   tCurrentCore = core;
+}
+
 void
 resume()
 {
@@ -250,7 +260,13 @@ executeSub()
 {
    auto lr = tCurrentCore->lr;
    tCurrentCore->lr = CALLBACK_ADDR;
-   resume();
+
+   if (!hasBreakpoints() && gJitMode != jit_mode::disabled) {
+      jit::executeSub();
+   } else {
+      interpreter::resume();
+   }
+
    tCurrentCore->lr = lr;
 }
 
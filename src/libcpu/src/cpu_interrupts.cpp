@@ -1,20 +1,32 @@
 #include "cpu.h"
 #include "cpu_internal.h"
 #include "common/decaf_assert.h"
+#include "common/platform_thread.h"
+#include <algorithm>
 #include <condition_variable>
 #include <atomic>
 
 namespace cpu
 {
 
+/*
+ * Each core sleeps on its own condition variable so that an interrupt only
+ * wakes the core it was sent to.  The sleeping flag lets interrupt() skip
+ * taking the mutex entirely when the target core is busy executing, which
+ * is by far the most common case.
+ */
+struct InterruptWaiter
+{
+   std::mutex mutex;
+   std::condition_variable condition;
+   std::atomic<bool> sleeping { false };
+};
+
 InterruptHandler
 gInterruptHandler;
 
-std::mutex
-gInterruptMutex;
-
-std::condition_variable
-gInterruptCondition;
+static InterruptWaiter
+sInterruptWaiter[3];
 
 std::mutex
 gTimerMutex;
@@ -25,6 +37,17 @@ gTimerCondition;
 std::thread
 gTimerThread;
 
+// How late the host may wake the timer thread to coalesce wakeups
+static const std::chrono::nanoseconds
+TimerSlack = std::chrono::microseconds { 10 };
+
+// The time the timer thread is currently sleeping until, protected by gTimerMutex
+static std::chrono::steady_clock::time_point
+sTimerWakeup = std::chrono::steady_clock::time_point::max();
+
+static AlarmLatencyStats
+sAlarmLatencyStats;
+
 void
 setInterruptHandler(InterruptHandler handler)
 {
@@ -34,33 +57,54 @@ setInterruptHandler(InterruptHandler handler)
 void
 interrupt(int core_idx, uint32_t flags)
 {
-   std::unique_lock<std::mutex> lock { gInterruptMutex };
+   auto &waiter = sInterruptWaiter[core_idx];
    gCore[core_idx].interrupt.fetch_or(flags);
-   gInterruptCondition.notify_all();
+
+   // This pairs with waitForInterrupt, which sets sleeping before checking
+   //  the interrupt flags, so at least one of us always sees the other.
+   if (waiter.sleeping.load()) {
+      std::unique_lock<std::mutex> lock { waiter.mutex };
+      waiter.condition.notify_one();
+   }
+}
+
+AlarmLatencyStats
+getAlarmLatencyStats()
+{
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+   return sAlarmLatencyStats;
 }
 
 void
 timerEntryPoint()
 {
+   platform::setCurrentThreadTimerSlack(TimerSlack);
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+
    while (gRunning.load()) {
-      std::unique_lock<std::mutex> lock{ gTimerMutex };
       auto now = std::chrono::steady_clock::now();
       auto next = std::chrono::steady_clock::time_point::max();
-      bool timedWait = false;
 
       for (auto i = 0; i < 3; ++i) {
          auto core = &gCore[i];
 
          if (core->next_alarm <= now) {
+            auto late = std::chrono::duration_cast<std::chrono::nanoseconds>(now - core->next_alarm);
+            sAlarmLatencyStats.count++;
+            sAlarmLatencyStats.total += late;
+            sAlarmLatencyStats.max = std::max(sAlarmLatencyStats.max, late);
+            sAlarmLatencyStats.totalSquared += static_cast<double>(late.count()) * static_cast<double>(late.count());
+
             core->next_alarm = std::chrono::steady_clock::time_point::max();
             cpu::interrupt(i, ALARM_INTERRUPT);
          } else if (core->next_alarm < next) {
             next = core->next_alarm;
-            timedWait = true;
          }
       }
 
-      if (timedWait) {
+      sTimerWakeup = next;
+
+      if (next != std::chrono::steady_clock::time_point::max()) {
          gTimerCondition.wait_until(lock, next);
       } else {
          gTimerCondition.wait(lock);
@@ -113,7 +157,7 @@ void
 waitForInterrupt()
 {
    auto core = this_core::state();
-   std::unique_lock<std::mutex> lock { gInterruptMutex };
+   auto &waiter = sInterruptWaiter[core->id];
 
    while (true) {
       if (!(core->interrupt_mask & ~NONMASKABLE_INTERRUPTS)) {
@@ -124,12 +168,18 @@ waitForInterrupt()
       auto flags = core->interrupt.fetch_and(~mask);
 
       if (flags & mask) {
-         lock.unlock();
          gInterruptHandler(flags);
-         lock.lock();
-      } else {
-         gInterruptCondition.wait(lock);
+         continue;
       }
+
+      std::unique_lock<std::mutex> lock { waiter.mutex };
+      waiter.sleeping.store(true);
+
+      if (!(core->interrupt.load() & mask)) {
+         waiter.condition.wait(lock);
+      }
+
+      waiter.sleeping.store(false);
    }
 }
 
@@ -139,7 +189,12 @@ setNextAlarm(std::chrono::steady_clock::time_point time)
    auto core = this_core::state();
    std::unique_lock<std::mutex> lock { gTimerMutex };
    core->next_alarm = time;
-   gTimerCondition.notify_all();
+
+   // Only wake the timer thread if it would otherwise sleep past this alarm
+   if (time < sTimerWakeup) {
+      sTimerWakeup = time;
+      gTimerCondition.notify_one();
+   }
 }
 
 } // namespace this_core
@@ -4,6 +4,7 @@
 #include "../cpu_internal.h"
 #include "interpreter_insreg.h"
 #include "interpreter.h"
+#include "interpreter_float.h"
 #include "common/bitutils.h"
 #include "common/floatutils.h"
 
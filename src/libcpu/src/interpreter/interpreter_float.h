@@ -1,6 +1,13 @@
 #pragma once
 #include "../state.h"
 
+// Lookup tables used by the Espresso reciprocal estimate
+extern const int
+fres_expected_base[32];
+
+extern const int
+fres_expected_dec[32];
+
 double
 ppc_estimate_reciprocal(double v);
 
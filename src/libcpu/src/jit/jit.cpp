@@ -7,16 +7,20 @@
 #include "cpu_internal.h"
 #include "espresso/espresso_instructionset.h"
 #include "jit.h"
+#include "jit_hostfeatures.h"
 #include "jit_internal.h"
 #include "jit_insreg.h"
+#include "jit_profile.h"
 #include "jit_verify.h"
 #include "jit_vmemruntime.h"
 #include "mem.h"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cfenv>
 #include <map>
 #include <vector>
+#include <xmmintrin.h>
 
 namespace cpu
 {
@@ -24,9 +28,18 @@ namespace cpu
 namespace jit
 {
 
-static const bool JIT_DEBUG = true;
+// Store NIA before every instruction and pad instructions with NOPs, this
+//  makes generated code easier to follow but costs a store per instruction.
+static const bool JIT_DEBUG =
+#ifdef NDEBUG
+   false;
+#else
+   true;
+#endif
+
 static const int JIT_MAX_INST = 3000;
 static const bool JIT_REGCACHE = true;
+static const bool JIT_LIVENESS = true;
 
 // Insert NOPs at the beginning of a generated block of code.
 //  The Visual Studio disassembler can get confused without these.
@@ -46,6 +59,24 @@ sRuntime;
 static FastRegionMap<JitCode>
 sJitBlocks;
 
+// Number of callback targets remembered per host thread by executeSub
+static const size_t
+CallGateCacheSize = 64;
+
+struct CallGateEntry
+{
+   uint32_t address;
+   uint32_t generation;
+   JitCode code;
+};
+
+// Bumped by clearCache to invalidate every thread's call gate cache
+static std::atomic<uint32_t>
+sCacheGeneration { 1 };
+
+static thread_local std::array<CallGateEntry, CallGateCacheSize>
+tCallGateCache;
+
 static std::array<uint8_t, 32>
 sBaseRelocCode;
 
@@ -272,6 +303,7 @@ freeRuntime()
 void
 initialise()
 {
+   logHostFeatures();
    initialiseRuntime();
 
    sInstructionMap.resize(static_cast<size_t>(espresso::InstructionID::InstructionCount), nullptr);
@@ -320,6 +352,8 @@ clearCache()
    initialiseRuntime();
 
    sJitBlocks.clear();
+   clearBlockProfiles();
+   sCacheGeneration.fetch_add(1);
 }
 
 using JumpTargetList = std::vector<uint32_t>;
@@ -354,12 +388,147 @@ jit_b_direct(PPCEmuAssembler& a, ppcaddr_t addr)
    }
 }
 
+static uint64_t
+getLivenessMask(espresso::Instruction instr,
+                espresso::InstructionField field)
+{
+   switch (field) {
+   case espresso::InstructionField::rA:
+      return 1ull << instr.rA;
+   case espresso::InstructionField::rB:
+      return 1ull << instr.rB;
+   case espresso::InstructionField::rD:
+      return 1ull << instr.rD;
+   case espresso::InstructionField::rS:
+      return 1ull << instr.rS;
+   case espresso::InstructionField::frA:
+      return 1ull << (32 + instr.frA);
+   case espresso::InstructionField::frB:
+      return 1ull << (32 + instr.frB);
+   case espresso::InstructionField::frC:
+      return 1ull << (32 + instr.frC);
+   case espresso::InstructionField::frD:
+      return 1ull << (32 + instr.frD);
+   case espresso::InstructionField::frS:
+      return 1ull << (32 + instr.frS);
+   default:
+      return 0;
+   }
+}
+
+static bool
+isLivenessBarrier(espresso::Instruction instr,
+                  espresso::InstructionID id)
+{
+   switch (id) {
+   // Calls out to code which may access any register
+   case espresso::InstructionID::kc:
+   case espresso::InstructionID::sc:
+   case espresso::InstructionID::tw:
+   case espresso::InstructionID::twi:
+   case espresso::InstructionID::rfi:
+   // Access more registers than their fields describe
+   case espresso::InstructionID::lmw:
+   case espresso::InstructionID::stmw:
+   case espresso::InstructionID::lswi:
+   case espresso::InstructionID::lswx:
+   case espresso::InstructionID::stswi:
+   case espresso::InstructionID::stswx:
+   // Always handled by jit_fallback from their own handlers
+   case espresso::InstructionID::psq_l:
+   case espresso::InstructionID::psq_lu:
+   case espresso::InstructionID::psq_lx:
+   case espresso::InstructionID::psq_lux:
+   case espresso::InstructionID::psq_st:
+   case espresso::InstructionID::psq_stu:
+   case espresso::InstructionID::psq_stx:
+   case espresso::InstructionID::psq_stux:
+      return true;
+   // Paired single multiply-add needs FMA3, see fmaGeneric
+   case espresso::InstructionID::ps_madd:
+   case espresso::InstructionID::ps_madds0:
+   case espresso::InstructionID::ps_madds1:
+   case espresso::InstructionID::ps_msub:
+   case espresso::InstructionID::ps_nmadd:
+   case espresso::InstructionID::ps_nmsub:
+      if (!hostHasFMA3()) {
+         return true;
+      }
+      break;
+   default:
+      break;
+   }
+
+   // Registered straight to the interpreter
+   if (sInstructionMap[static_cast<size_t>(id)] == &jit_fallback) {
+      return true;
+   }
+
+   // The record forms of the floating point and paired single instructions
+   //  all fall back to the interpreter
+   if (instr.rc && (instr.opcd == 4 || instr.opcd == 59 || instr.opcd == 63)) {
+      return true;
+   }
+
+   return false;
+}
+
+/**
+ * Find which guest registers every instruction in the block reads and
+ * writes, so the register cache can keep the values which are needed soonest
+ * and avoid storing values which are overwritten before they are read.
+ */
+static void
+analyseLiveness(const JitBlock &block,
+                BlockLiveness &liveness)
+{
+   liveness.start = block.start;
+   liveness.instrs.clear();
+   liveness.instrs.reserve((block.end - block.start) / 4);
+
+   for (auto cia = block.start; cia < block.end; cia += 4) {
+      auto instr = mem::read<espresso::Instruction>(cia);
+      auto data = espresso::decodeInstruction(instr);
+      auto info = BlockLiveness::Instruction { };
+
+      if (!data || !sInstructionMap[static_cast<size_t>(data->id)] || isLivenessBarrier(instr, data->id)) {
+         // Anything we fall back to the interpreter for is treated as a
+         //  barrier, as everything is written back around it anyway.
+         info.barrier = true;
+      } else {
+         for (auto &field : data->read) {
+            info.reads |= getLivenessMask(instr, field);
+         }
+
+         for (auto &field : data->write) {
+            auto mask = getLivenessMask(instr, field);
+
+            // Writes to an FPR can leave ps1 untouched, so only a GPR
+            //  write is known to replace the whole register.
+            info.writes |= mask & 0xFFFFFFFFull;
+            info.reads |= mask & ~0xFFFFFFFFull;
+         }
+      }
+
+      liveness.instrs.push_back(info);
+   }
+}
+
 bool
 gen(JitBlock &block)
 {
    PPCEmuAssembler a(sRuntime);
    a.relocLabels.reserve(10);
 
+   // Verification compares the whole register state after every
+   //  instruction, so every value has to be written back.
+   BlockLiveness liveness;
+
+   if (JIT_LIVENESS && gJitMode != jit_mode::verify) {
+      analyseLiveness(block, liveness);
+      a.liveness = &liveness;
+   }
+
    struct TargetLblPair {
       uint32_t idx;
       asmjit::Label label;
@@ -379,6 +548,16 @@ gen(JitBlock &block)
       }
    }
 
+   // Count entries to the block, nothing is cached in RAX on entry.
+   BlockProfile *profile = nullptr;
+
+   if (isProfilingEnabled()) {
+      profile = allocateBlockProfile(block.start, block.end);
+      auto entriesAddr = reinterpret_cast<intptr_t>(&profile->entries);
+      a.mov(asmjit::x86::rax, asmjit::Ptr(entriesAddr));
+      a.lock().inc(asmjit::X86Mem(asmjit::x86::rax, 0, 8));
+   }
+
    for (lclCia = block.start; lclCia < block.end; lclCia += 4)
    {
       auto targetIter = targetLbls.find(lclCia);
@@ -388,7 +567,7 @@ gen(JitBlock &block)
          a.bind(targetIter->second.label);
       }
 
-      if (JIT_DEBUG) {
+      if (JIT_DEBUG || gJitMode == jit_mode::verify) {
          a.mov(a.niaMem, lclCia + 4);
       }
 
@@ -443,6 +622,10 @@ gen(JitBlock &block)
       return false;
    }
 
+   if (profile) {
+      setBlockProfileCode(profile, func, a.getCodeSize());
+   }
+
    // Write in the relocation data that jumps to the Finale, which can
    //  later be overwritten atomically by the generator.
    for (auto &reloc : a.relocLabels) {
@@ -625,6 +808,75 @@ resume()
    decaf_check(core->nia == CALLBACK_ADDR);
 }
 
+static JitCode
+getCallTarget(uint32_t address)
+{
+   // Branch tracing wants to see every entry
+   if (gBranchTraceHandler) {
+      return jit_continue(address, nullptr);
+   }
+
+   auto generation = sCacheGeneration.load(std::memory_order_relaxed);
+   auto &entry = tCallGateCache[(address >> 2) & (CallGateCacheSize - 1)];
+
+   if (entry.address == address && entry.generation == generation && entry.code) {
+      return entry.code;
+   }
+
+   entry.address = address;
+   entry.generation = generation;
+   entry.code = get(address);
+   return entry.code;
+}
+
+/**
+ * Call into guest code from the host, for callbacks made from HLE functions.
+ *
+ * This does the same as resume, but callbacks are frequent enough that the
+ * full FP environment reset is worth avoiding.  The rounding mode is only
+ * set again when host code has left a different one behind in either MXCSR
+ * or the x87 control word, which fegetround reads for the interpreter
+ * fallbacks, and only MXCSR exception flags are cleared.
+ */
+void
+executeSub()
+{
+   // MXCSR rounding control and fenv rounding mode for each of the FPSCR
+   //  rounding modes
+   static const uint32_t mxcsrRounding[4] = {
+      0 << 13, 3 << 13, 2 << 13, 1 << 13
+   };
+   static const int fenvRounding[4] = {
+      FE_TONEAREST, FE_TOWARDZERO, FE_UPWARD, FE_DOWNWARD
+   };
+   static const uint32_t mxcsrRoundingMask = 3 << 13;
+   static const uint32_t mxcsrExceptionFlags = 0x3F;
+
+   auto core = this_core::state();
+   auto mxcsr = _mm_getcsr();
+
+   if ((mxcsr & mxcsrRoundingMask) != mxcsrRounding[core->fpscr.rn]
+    || std::fegetround() != fenvRounding[core->fpscr.rn]) {
+      this_core::updateRoundingMode();
+      mxcsr = _mm_getcsr();
+   }
+
+   if (mxcsr & mxcsrExceptionFlags) {
+      _mm_setcsr(mxcsr & ~mxcsrExceptionFlags);
+   }
+
+   // Just to help when debugging
+   core->cia = 0xFFFFFFFD;
+
+   decaf_check(core->nia != CALLBACK_ADDR);
+
+   auto jitFn = getCallTarget(core->nia);
+   core = execute(core, jitFn);
+
+   decaf_check(core == this_core::state());
+   decaf_check(core->nia == CALLBACK_ADDR);
+}
+
 bool
 PPCEmuAssembler::ErrorHandler::handleError(asmjit::Error code, const char* message, void *origin) noexcept
 {
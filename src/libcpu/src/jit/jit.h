@@ -11,6 +11,7 @@ void initialise();
 
 void clearCache();
 void resume();
+void executeSub();
 
 bool hasInstruction(espresso::InstructionID instrId);
 
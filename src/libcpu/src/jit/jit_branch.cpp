@@ -1,3 +1,4 @@
+#include "jit_float.h"
 #include "jit_insreg.h"
 #include "../cpu_internal.h"
 #include "common/bitutils.h"
@@ -37,6 +38,7 @@ jit_b_check_interrupt(PPCEmuAssembler& a)
    // We need to evict everything in case we call back to the
    //  interrupt handler which is C++ code...
    a.evictAll();
+   a.forgetKnownGprs();
 
    // Jump to interrupt handler if there is an interrupt
    auto noInterrupt = a.newLabel();
@@ -44,9 +46,20 @@ jit_b_check_interrupt(PPCEmuAssembler& a)
    a.cmp(a.interruptMem, 0);
    a.je(noInterrupt);
 
+   // The interrupt handler may switch threads, so fold the exceptions the
+   //  guest has raised into its FPSCR first, the same as kc does.
+   {
+      auto fpscr = a.loadRegisterReadWrite(a.fpscr);
+      syncFPSCRExceptions(a, fpscr);
+   }
+
+   a.evictAll();
+   a.forgetKnownGprs();
+
    a.mov(a.niaMem, a.genCia + 4);
    a.call(asmjit::Ptr(jit_interrupt_stub));
    a.mov(a.stateReg, asmjit::x86::rax);
+   clearHostFPExceptions(a);
 
    a.bind(noInterrupt);
 }
@@ -1,8 +1,10 @@
 #include "jit_insreg.h"
+#include "jit_float.h"
 #include "common/bitutils.h"
 
 using espresso::XERegisterBits;
 using espresso::ConditionRegisterFlag;
+using espresso::FPSCRRegisterBits;
 
 namespace cpu
 {
@@ -152,27 +154,184 @@ enum FCmpFlags
 {
    FCmpOrdered = 1 << 0,
    FCmpUnordered = 1 << 1,
-   FCmpSingle0 = 1 << 2,
-   FCmpSingle1 = 1 << 3,
+   FCmpPS1 = 1 << 2,
 };
 
-template<typename Type, unsigned flags>
+// Position of FPCC in FPSCR
+static const uint32_t
+FpccShift = 12;
+
+// FPSCR invalid operation exception enable
+static const uint32_t
+FpscrVE = 1 << 7;
+
+// Jumps to isSnan if the double in the low lane of src is a signalling NaN,
+//  that is an all ones exponent, a clear quiet bit and a non zero mantissa.
+static void
+jumpIfSignallingNan(PPCEmuAssembler& a,
+                    const PPCEmuAssembler::XmmRegister& src,
+                    const PPCEmuAssembler::GpRegister& bits,
+                    const PPCEmuAssembler::GpRegister& tmp,
+                    asmjit::Label isSnan)
+{
+   auto notSnan = a.newLabel();
+
+   a.movq(bits, src);
+   a.mov(tmp, bits);
+   a.shl(tmp, 1);
+   a.shr(tmp, 52);
+   a.cmp(tmp, 0xFFE);
+   a.jne(notSnan);
+   a.shl(bits, 13);
+   a.jnz(isSnan);
+   a.bind(notSnan);
+}
+
+// The ordered and unordered compares only differ in the FPSCR exception bits
+//  they set for NaN operands, which only happens on the unordered path.
+template<unsigned flags>
 static bool
 fcmpGeneric(PPCEmuAssembler& a, Instruction instr)
 {
-   return jit_fallback(a, instr);
+   uint32_t crshift = (7 - instr.crfD) * 4;
+
+   // We allocate these up here so that any spill/alloc that
+   //  need to occur do not interfer with SETxx or the NaN path.
+   auto isUnordered = a.allocGpTmp().r32();
+   auto isLesser = a.allocGpTmp().r32();
+   auto isGreater = a.allocGpTmp().r32();
+   auto isEqual = a.allocGpTmp().r32();
+   auto ppccr = a.loadRegisterReadWrite(a.cr);
+   auto ppcfpscr = a.loadRegisterReadWrite(a.fpscr);
+   a.mov(isUnordered, 0);
+   a.mov(isLesser, 0);
+   a.mov(isGreater, 0);
+   a.mov(isEqual, 0);
+
+   PPCEmuAssembler::XmmRegister srcA, srcB;
+
+   if (flags & FCmpPS1) {
+      srcA = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+      srcB = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frB]));
+      a.unpckhpd(srcA, srcA);
+      a.unpckhpd(srcB, srcB);
+   } else {
+      srcA = a.loadRegisterRead(a.fprps[instr.frA]);
+      srcB = a.loadRegisterRead(a.fprps[instr.frB]);
+   }
+
+   a.ucomisd(srcA, srcB);
+   a.setp(isUnordered.r8());
+   a.setb(isLesser.r8());
+   a.seta(isGreater.r8());
+   a.sete(isEqual.r8());
+
+   // An unordered result also sets CF and ZF
+   a.xor_(isLesser, isUnordered);
+   a.xor_(isEqual, isUnordered);
+
+   a.shl(isLesser, ConditionRegisterFlag::NegativeShift);
+   a.shl(isGreater, ConditionRegisterFlag::PositiveShift);
+   a.shl(isEqual, ConditionRegisterFlag::ZeroShift);
+   a.or_(isLesser, isGreater);
+   a.or_(isLesser, isEqual);
+   a.or_(isLesser, isUnordered);
+
+   a.and_(ppccr, ~(0xF << crshift));
+   a.mov(isGreater, isLesser);
+   a.shl(isGreater, crshift);
+   a.or_(ppccr, isGreater);
+
+   a.and_(ppcfpscr, ~(0xF << FpccShift));
+   a.shl(isLesser, FpccShift);
+   a.or_(ppcfpscr, isLesser);
+
+   // A NaN operand raises VXSNAN if it is signalling, ordered compares also
+   //  raise VXVC unless VXSNAN was raised with invalid exceptions enabled.
+   auto doneLbl = a.newLabel();
+   auto snanLbl = a.newLabel();
+   auto summaryLbl = a.newLabel();
+   auto oldFpscr = isLesser;
+   auto bits = isGreater.r64();
+   auto tmp = isEqual.r64();
+
+   a.test(isUnordered, isUnordered);
+   a.jz(doneLbl);
+   a.mov(oldFpscr, ppcfpscr);
+
+   jumpIfSignallingNan(a, srcA, bits, tmp, snanLbl);
+   jumpIfSignallingNan(a, srcB, bits, tmp, snanLbl);
+
+   if (flags & FCmpOrdered) {
+      a.or_(ppcfpscr, FPSCRRegisterBits::VXVC);
+   }
+
+   a.jmp(summaryLbl);
+
+   a.bind(snanLbl);
+   a.or_(ppcfpscr, FPSCRRegisterBits::VXSNAN);
+
+   if (flags & FCmpOrdered) {
+      a.test(ppcfpscr, FpscrVE);
+      a.jnz(summaryLbl);
+      a.or_(ppcfpscr, FPSCRRegisterBits::VXVC);
+   }
+
+   // Only invalid operation bits can have changed, so VX is now set and
+   //  FEX follows VE, FX is set if any exception bit went from clear to set.
+   a.bind(summaryLbl);
+   a.or_(ppcfpscr, FPSCRRegisterBits::VX);
+   a.mov(tmp.r32(), ppcfpscr);
+   a.shl(tmp.r32(), FPSCRRegisterBits::FEXShift - 7);
+   a.and_(tmp.r32(), FPSCRRegisterBits::FEX);
+   a.or_(ppcfpscr, tmp.r32());
+
+   a.not_(oldFpscr);
+   a.and_(oldFpscr, ppcfpscr);
+   a.and_(oldFpscr, FPSCRRegisterBits::AllExceptions);
+   a.neg(oldFpscr);
+   a.sbb(oldFpscr, oldFpscr);
+   a.and_(oldFpscr, FPSCRRegisterBits::FX);
+   a.or_(ppcfpscr, oldFpscr);
+
+   a.bind(doneLbl);
+   return true;
 }
 
 static bool
 fcmpo(PPCEmuAssembler& a, Instruction instr)
 {
-   return fcmpGeneric<double, FCmpOrdered>(a, instr);
+   return fcmpGeneric<FCmpOrdered>(a, instr);
 }
 
 static bool
 fcmpu(PPCEmuAssembler& a, Instruction instr)
 {
-   return fcmpGeneric<double, FCmpUnordered>(a, instr);
+   return fcmpGeneric<FCmpUnordered>(a, instr);
+}
+
+static bool
+ps_cmpo0(PPCEmuAssembler& a, Instruction instr)
+{
+   return fcmpGeneric<FCmpOrdered>(a, instr);
+}
+
+static bool
+ps_cmpo1(PPCEmuAssembler& a, Instruction instr)
+{
+   return fcmpGeneric<FCmpOrdered | FCmpPS1>(a, instr);
+}
+
+static bool
+ps_cmpu0(PPCEmuAssembler& a, Instruction instr)
+{
+   return fcmpGeneric<FCmpUnordered>(a, instr);
+}
+
+static bool
+ps_cmpu1(PPCEmuAssembler& a, Instruction instr)
+{
+   return fcmpGeneric<FCmpUnordered | FCmpPS1>(a, instr);
 }
 
 // Condition Register AND
@@ -287,6 +446,34 @@ mcrf(PPCEmuAssembler& a, Instruction instr)
    return true;
 }
 
+// Move to Condition Register from FPSCR
+static bool
+mcrfs(PPCEmuAssembler& a, Instruction instr)
+{
+   uint32_t shifts = (7 - instr.crfS) * 4;
+   uint32_t crshiftd = (7 - instr.crfD) * 4;
+
+   auto ppcfpscr = a.loadRegisterReadWrite(a.fpscr);
+   syncFPSCRExceptions(a, ppcfpscr);
+
+   auto tmp = a.allocGpTmp().r32();
+   a.mov(tmp, ppcfpscr);
+   a.shiftTo(tmp, shifts, crshiftd);
+   a.and_(tmp, 0xF << crshiftd);
+
+   auto ppccr = a.loadRegisterReadWrite(a.cr);
+   a.and_(ppccr, ~(0xF << crshiftd));
+   a.or_(ppccr, tmp);
+
+   // All exception bits copied are cleared, FEX and VX are then updated
+   //  following the normal rules.
+   const uint32_t exceptionBits = FPSCRRegisterBits::FX | FPSCRRegisterBits::AllExceptions;
+   a.and_(ppcfpscr, ~(exceptionBits & (0xF << shifts)));
+   updateFEX_VX(a, ppcfpscr);
+
+   return true;
+}
+
 // Move to Condition Register from XER
 static bool
 mcrxr(PPCEmuAssembler& a, Instruction instr)
@@ -365,14 +552,14 @@ void registerConditionInstructions()
    RegisterInstruction(crorc);
    RegisterInstruction(crxor);
    RegisterInstruction(mcrf);
-   RegisterInstructionFallback(mcrfs);
+   RegisterInstruction(mcrfs);
    RegisterInstruction(mcrxr);
    RegisterInstruction(mfcr);
    RegisterInstruction(mtcrf);
-   RegisterInstructionFallback(ps_cmpu0);
-   RegisterInstructionFallback(ps_cmpo0);
-   RegisterInstructionFallback(ps_cmpu1);
-   RegisterInstructionFallback(ps_cmpo1);
+   RegisterInstruction(ps_cmpu0);
+   RegisterInstruction(ps_cmpo0);
+   RegisterInstruction(ps_cmpu1);
+   RegisterInstruction(ps_cmpo1);
 }
 
 } // namespace jit
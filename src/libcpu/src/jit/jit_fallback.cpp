@@ -26,6 +26,7 @@ bool jit_fallback(PPCEmuAssembler& a, espresso::Instruction instr)
    decaf_assert(fptr, fmt::format("Unimplemented instruction {}", static_cast<int>(data->id)));
 
    a.evictAll();
+   a.forgetKnownGprs();
 
    if (TRACK_FALLBACK_CALLS) {
       auto fallbackAddr = reinterpret_cast<intptr_t>(&sFallbackCalls[static_cast<uint32_t>(data->id)]);
@@ -1,43 +1,20 @@
 #include "jit_insreg.h"
 #include "jit_float.h"
+#include "jit_hostfeatures.h"
+#include "interpreter/interpreter_float.h"
 #include "common/bitutils.h"
 #include "common/decaf_assert.h"
 #include "common/log.h"
 #include <cstdint>
 
+using espresso::FPSCRRegisterBits;
+
 namespace cpu
 {
 
 namespace jit
 {
 
-static bool
-hostHasFMA3()
-{
-   static bool checked = false;
-   static bool hasFMA3;
-
-   if (!checked) {
-      checked = true;
-#ifdef PLATFORM_WINDOWS
-      int cpuInfo[4];
-      __cpuid(cpuInfo, 1);
-      hasFMA3 = ((cpuInfo[2] & (1 << 12)) != 0);
-#else
-      // We don't need the value in EAX, but we have to declare it as an
-      // output since GCC complains if it's a clobber.
-      uint32_t eax, ecx;
-      __asm__("cpuid" : "=a" (eax), "=c" (ecx) : "0" (1) : "rbx", "rdx");
-      hasFMA3 = ((ecx & (1 << 12)) != 0);
-#endif
-      if (!hasFMA3) {
-         gLog->warn("FMA3 instructions not available; fused multiply-add results will be inaccurate");
-      }
-   }
-
-   return hasFMA3;
-}
-
 void
 roundToSingleSd(PPCEmuAssembler& a,
                 const PPCEmuAssembler::XmmRegister& dst,
@@ -106,6 +83,154 @@ absXmmSd(PPCEmuAssembler& a,
    a.pand(reg, maskXmm);
 }
 
+// Host MXCSR exception flags and rounding control
+static const uint32_t
+MxcsrExceptionMask = 0x3F;
+
+static const uint32_t
+MxcsrRoundingShift = 13;
+
+// Host x87 control word rounding control
+static const uint32_t
+X87RoundingShift = 10;
+
+// The JIT entry point reserves shadow space at the bottom of the host stack,
+//  which is free for us to use while we are not calling out to the host.
+static asmjit::X86Mem
+stackScratch(int32_t offset, uint32_t size)
+{
+   return asmjit::X86Mem(asmjit::x86::rsp, offset, size);
+}
+
+void
+updateFEX_VX(PPCEmuAssembler& a,
+             const PPCEmuAssembler::GpRegister& fpscr)
+{
+   auto tmp = a.allocGpTmp().r32();
+   a.and_(fpscr, ~(FPSCRRegisterBits::FEX | FPSCRRegisterBits::VX));
+
+   // VX is set if any of the individual invalid operation bits are set
+   a.mov(tmp, fpscr);
+   a.and_(tmp, FPSCRRegisterBits::AllVX);
+   a.neg(tmp);
+   a.sbb(tmp, tmp);
+   a.and_(tmp, FPSCRRegisterBits::VX);
+   a.or_(fpscr, tmp);
+
+   // FEX is set if any of VX, OX, UX, ZX or XX is set along with its
+   //  enable bit, each enable bit sits exactly 22 bits below its exception.
+   a.mov(tmp, fpscr);
+   a.shr(tmp, 22);
+   a.and_(tmp, fpscr);
+   a.and_(tmp, 0xF8);
+   a.neg(tmp);
+   a.sbb(tmp, tmp);
+   a.and_(tmp, FPSCRRegisterBits::FEX);
+   a.or_(fpscr, tmp);
+}
+
+/*
+ * The JIT does not update FPSCR after every floating point instruction,
+ * instead the host MXCSR exception flags are treated as pending sticky
+ * exception bits and folded into FPSCR whenever the guest reads or writes
+ * FPSCR.  Interpreter fallbacks pick up the same host flags after their
+ * own instruction, so no exception is lost between the two.
+ *
+ * Invalid operation is not folded as the host does not tell us which of
+ * the VX bits it should be.
+ */
+void
+syncFPSCRExceptions(PPCEmuAssembler& a,
+                    const PPCEmuAssembler::GpRegister& fpscr)
+{
+   static const struct
+   {
+      uint32_t hostShift;
+      uint32_t fpscrShift;
+   } exceptionMap[] = {
+      { 2, FPSCRRegisterBits::ZXShift },
+      { 3, FPSCRRegisterBits::OXShift },
+      { 4, FPSCRRegisterBits::UXShift },
+      { 5, FPSCRRegisterBits::XXShift },
+   };
+
+   auto mxcsr = a.allocGpTmp().r32();
+   auto bits = a.allocGpTmp().r32();
+   auto tmp = a.allocGpTmp().r32();
+
+   // Read and clear the host exception flags
+   a.stmxcsr(stackScratch(0, 4));
+   a.mov(mxcsr, stackScratch(0, 4));
+   a.and_(stackScratch(0, 4), ~MxcsrExceptionMask);
+   a.ldmxcsr(stackScratch(0, 4));
+
+   a.xor_(bits, bits);
+
+   for (auto &exception : exceptionMap) {
+      a.mov(tmp, mxcsr);
+      a.and_(tmp, 1 << exception.hostShift);
+      a.shl(tmp, exception.fpscrShift - exception.hostShift);
+      a.or_(bits, tmp);
+   }
+
+   // FX is set by any exception bit which goes from clear to set
+   a.mov(tmp, fpscr);
+   a.not_(tmp);
+   a.and_(tmp, bits);
+   a.neg(tmp);
+   a.sbb(tmp, tmp);
+   a.and_(tmp, FPSCRRegisterBits::FX);
+   a.or_(bits, tmp);
+   a.or_(fpscr, bits);
+
+   updateFEX_VX(a, fpscr);
+}
+
+// Drops whatever exception flags host code has left in MXCSR, so they are
+//  not folded into FPSCR as if the guest had raised them.
+void
+clearHostFPExceptions(PPCEmuAssembler& a)
+{
+   a.stmxcsr(stackScratch(0, 4));
+   a.and_(stackScratch(0, 4), ~MxcsrExceptionMask);
+   a.ldmxcsr(stackScratch(0, 4));
+}
+
+// Equivalent of this_core::updateRoundingMode for JIT code, this has to
+//  update the x87 control word too as fegetround reads it on some hosts.
+static void
+updateHostRoundingMode(PPCEmuAssembler& a,
+                       const PPCEmuAssembler::GpRegister& fpscr)
+{
+   auto mode = a.allocGpTmp().r32();
+   auto tmp = a.allocGpTmp().r32();
+
+   // The host encodes Nearest, Zero, Positive, Negative as 0, 3, 2, 1 so
+   //  bit 1 has to be flipped whenever bit 0 is set.
+   a.mov(mode, fpscr);
+   a.and_(mode, 3);
+   a.mov(tmp, mode);
+   a.and_(tmp, 1);
+   a.shl(tmp, 1);
+   a.xor_(mode, tmp);
+
+   a.stmxcsr(stackScratch(0, 4));
+   a.mov(tmp, stackScratch(0, 4));
+   a.and_(tmp, ~(3 << MxcsrRoundingShift));
+   a.shl(mode, MxcsrRoundingShift);
+   a.or_(tmp, mode);
+   a.mov(stackScratch(0, 4), tmp);
+   a.ldmxcsr(stackScratch(0, 4));
+
+   a.fnstcw(stackScratch(4, 2));
+   a.movzx(tmp, stackScratch(4, 2));
+   a.and_(tmp, ~(3 << X87RoundingShift));
+   a.shr(mode, MxcsrRoundingShift - X87RoundingShift);
+   a.or_(tmp, mode);
+   a.mov(stackScratch(4, 2), tmp.r16());
+   a.fldcw(stackScratch(4, 2));
+}
+
 enum FPArithOperator {
     FPAdd,
     FPSub,
@@ -212,6 +337,157 @@ fdivs(PPCEmuAssembler& a, Instruction instr)
    return fpArithGeneric<FPDiv, true>(a, instr);
 }
 
+// Floating Reciprocal Estimate Single
+static bool
+fres(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // FPSCR, FPRF supposed to be updated here...
+
+   // Everything is allocated before the first branch so that no spill is
+   //  only emitted on one of the paths.
+   auto src = a.loadRegisterRead(a.fprps[instr.frB]);
+   auto result = a.allocXmmTmp();
+   auto bits = a.allocGpTmp();
+   auto sign = a.allocGpTmp();
+   auto exponent = a.allocGpTmp();
+   auto index = a.allocGpTmp();
+   auto table = a.allocGpTmp();
+   auto tmp = a.allocGpTmp();
+
+   auto smallLbl = a.newLabel();
+   auto largeLbl = a.newLabel();
+   auto zeroLbl = a.newLabel();
+   auto doneLbl = a.newLabel();
+
+   a.movq(bits, src);
+   a.mov(sign, bits);
+   a.shr(sign, 63);
+   a.shl(sign, 63);
+   a.mov(exponent, bits);
+   a.shr(exponent, 52);
+   a.and_(exponent, 0x7FF);
+
+   a.cmp(exponent, 895);
+   a.jb(smallLbl);
+   a.cmp(exponent, 1150);
+   a.ja(largeLbl);
+
+   // The top 5 bits of the mantissa select an entry in the Espresso tables
+   //  and the next 10 bits how far along its slope we are, exactly as in
+   //  ppc_estimate_reciprocal.
+   a.mov(tmp, bits);
+   a.shr(tmp, 47);
+   a.and_(tmp, 0x1F);
+   a.mov(index, bits);
+   a.shr(index, 37);
+   a.and_(index, 0x3FF);
+
+   a.mov(table, reinterpret_cast<uint64_t>(&fres_expected_dec[0]));
+   a.imul(index.r32(), asmjit::X86Mem(table, tmp, 2, 0, 4));
+   a.add(index, 1);
+   a.shr(index, 1);
+
+   a.mov(table, reinterpret_cast<uint64_t>(&fres_expected_base[0]));
+   a.mov(table.r32(), asmjit::X86Mem(table, tmp, 2, 0, 4));
+   a.sub(table, index);
+   a.shl(table, 29);
+
+   a.mov(tmp, 0x7FD);
+   a.sub(tmp, exponent);
+   a.shl(tmp, 52);
+   a.or_(table, tmp);
+   a.or_(table, sign);
+
+   // The smallest results are denormal as a single
+   a.movq(result, table);
+   roundToSingleSd(a, result, result);
+   a.jmp(doneLbl);
+
+   // Zero gives infinity, anything else this small overflows to FLT_MAX
+   a.bind(smallLbl);
+   a.mov(tmp, bits);
+   a.add(tmp, tmp);
+   a.mov(table, UINT64_C(0x7FF0000000000000));
+   a.mov(index, UINT64_C(0x47EFFFFFE0000000));
+   a.cmovnz(table, index);
+   a.or_(table, sign);
+   a.movq(result, table);
+   a.jmp(doneLbl);
+
+   // A NaN is returned as a single, anything else this large gives zero
+   a.bind(largeLbl);
+   a.cmp(exponent, 0x7FF);
+   a.jne(zeroLbl);
+   a.mov(tmp, bits);
+   a.shl(tmp, 12);
+   a.jz(zeroLbl);
+   roundToSingleSd(a, result, src);
+   a.jmp(doneLbl);
+
+   a.bind(zeroLbl);
+   a.movq(result, sign);
+
+   a.bind(doneLbl);
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movddup(dst, result);
+   return true;
+}
+
+// Floating Reciprocal Square Root Estimate
+static bool
+frsqrte(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // FPSCR, FPRF supposed to be updated here...
+
+   auto src = a.loadRegisterRead(a.fprps[instr.frB]);
+   auto result = a.allocXmmTmp();
+   auto root = a.allocXmmTmp();
+   auto bits = a.allocGpTmp();
+   auto tmp = a.allocGpTmp();
+
+   auto computeLbl = a.newLabel();
+   auto doneLbl = a.newLabel();
+
+   // Anything negative other than -0.0 gives the default NaN, which includes
+   //  a negative quiet NaN but not a negative signalling NaN.
+   a.movq(bits, src);
+   a.test(bits, bits);
+   a.jns(computeLbl);
+   a.add(bits, bits);
+   a.jz(computeLbl);
+
+   // With the sign shifted out a signalling NaN is exactly the range
+   //  0xFFE0000000000001 to 0xFFEFFFFFFFFFFFFF
+   a.mov(tmp, UINT64_C(0xFFE0000000000001));
+   a.sub(bits, tmp);
+   a.mov(tmp, UINT64_C(0x000FFFFFFFFFFFFF));
+   a.cmp(bits, tmp);
+   a.jb(computeLbl);
+
+   a.mov(tmp, UINT64_C(0x7FF8000000000000));
+   a.movq(result, tmp);
+   a.jmp(doneLbl);
+
+   a.bind(computeLbl);
+   a.sqrtsd(root, src);
+   a.mov(tmp, UINT64_C(0x3FF0000000000000));
+   a.movq(result, tmp);
+   a.divsd(result, root);
+
+   a.bind(doneLbl);
+   auto dst = a.loadRegisterReadWrite(a.fprps[instr.frD]);
+   a.movsd(dst, result);
+   return true;
+}
+
 static bool
 fsel(PPCEmuAssembler& a, Instruction instr)
 {
@@ -340,6 +616,64 @@ fnmsubs(PPCEmuAssembler& a, Instruction instr)
    return fmaddGeneric<true, true, true>(a, instr);
 }
 
+// fctiw/fctiwz common implementation
+template<bool RoundToZero>
+static bool
+fctiwGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // FPSCR, FPRF supposed to be updated here...
+
+   auto src = a.loadRegisterRead(a.fprps[instr.frB]);
+   auto limit = a.allocXmmTmp();
+   auto result = a.allocGpTmp();
+   auto tmp = a.allocGpTmp();
+
+   // The host returns 0x80000000 for NaN and anything out of range, which
+   //  matches the Espresso for everything but values above INT_MAX.  The
+   //  conversion uses the host rounding mode, which always reflects FPSCR.
+   if (RoundToZero) {
+      a.cvttsd2si(result.r32(), src);
+   } else {
+      a.cvtsd2si(result.r32(), src);
+   }
+
+   a.mov(tmp, UINT64_C(0x41DFFFFFFFC00000));
+   a.movq(limit, tmp);
+   a.mov(tmp.r32(), 0x7FFFFFFF);
+   a.ucomisd(src, limit);
+   a.cmova(result.r32(), tmp.r32());
+
+   // The upper word is 0xFFF80000, with the low bit set only for -0.0
+   a.movq(tmp, src);
+   a.btc(tmp, 63);
+   a.cmp(tmp, 1);
+   a.mov(tmp.r32(), 0xFFF80000);
+   a.adc(tmp.r32(), 0);
+   a.shl(tmp, 32);
+   a.or_(tmp, result);
+
+   a.movq(limit, tmp);
+   auto dst = a.loadRegisterReadWrite(a.fprps[instr.frD]);
+   a.movsd(dst, limit);
+   return true;
+}
+
+static bool
+fctiw(PPCEmuAssembler& a, Instruction instr)
+{
+   return fctiwGeneric<false>(a, instr);
+}
+
+static bool
+fctiwz(PPCEmuAssembler& a, Instruction instr)
+{
+   return fctiwGeneric<true>(a, instr);
+}
+
 static bool
 frsp(PPCEmuAssembler& a, Instruction instr)
 {
@@ -407,6 +741,137 @@ fneg(PPCEmuAssembler& a, Instruction instr)
    return fmrGeneric<false, true>(a, instr);
 }
 
+// Move from FPSCR
+static bool
+mffs(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   auto fpscr = a.loadRegisterReadWrite(a.fpscr);
+   syncFPSCRExceptions(a, fpscr);
+
+   auto tmp = a.allocXmmTmp();
+   a.movd(tmp, fpscr);
+
+   auto dst = a.loadRegisterReadWrite(a.fprps[instr.frD]);
+   a.movss(dst, tmp);
+   return true;
+}
+
+// mtfsb0/mtfsb1 common implementation
+template<bool ShouldSet>
+static bool
+mtfsbGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   const uint32_t bit = 1u << (31 - instr.crbD);
+   auto fpscr = a.loadRegisterReadWrite(a.fpscr);
+   syncFPSCRExceptions(a, fpscr);
+
+   if (ShouldSet) {
+      if (bit & FPSCRRegisterBits::AllExceptions) {
+         // Setting a clear exception bit also sets FX
+         auto tmp = a.allocGpTmp().r32();
+         a.mov(tmp, fpscr);
+         a.not_(tmp);
+         a.and_(tmp, bit);
+         a.shl(tmp, instr.crbD);
+         a.or_(fpscr, tmp);
+      }
+
+      a.or_(fpscr, bit);
+   } else {
+      a.and_(fpscr, ~bit);
+   }
+
+   updateFEX_VX(a, fpscr);
+
+   if (instr.crbD >= 30) {
+      updateHostRoundingMode(a, fpscr);
+   }
+
+   return true;
+}
+
+static bool
+mtfsb0(PPCEmuAssembler& a, Instruction instr)
+{
+   return mtfsbGeneric<false>(a, instr);
+}
+
+static bool
+mtfsb1(PPCEmuAssembler& a, Instruction instr)
+{
+   return mtfsbGeneric<true>(a, instr);
+}
+
+// Move to FPSCR Fields
+static bool
+mtfsf(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // Bit n of FM selects the n-th field counting up from the low end
+   auto mask = 0u;
+
+   for (auto field = 0; field < 8; ++field) {
+      if (get_bit(instr.fm, field)) {
+         mask |= 0xFu << (4 * field);
+      }
+   }
+
+   auto fpscr = a.loadRegisterReadWrite(a.fpscr);
+   syncFPSCRExceptions(a, fpscr);
+
+   auto tmp = a.allocGpTmp().r32();
+   a.movd(tmp, a.loadRegisterRead(a.fprps[instr.frB]));
+   a.and_(tmp, mask);
+   a.and_(fpscr, ~mask);
+   a.or_(fpscr, tmp);
+
+   updateFEX_VX(a, fpscr);
+
+   if (get_bit(instr.fm, 0)) {
+      updateHostRoundingMode(a, fpscr);
+   }
+
+   return true;
+}
+
+// Move to FPSCR Field Immediate
+static bool
+mtfsfi(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   const uint32_t shift = 4 * (7 - instr.crfD);
+   auto fpscr = a.loadRegisterReadWrite(a.fpscr);
+   syncFPSCRExceptions(a, fpscr);
+
+   a.and_(fpscr, ~(0xFu << shift));
+
+   if (instr.imm) {
+      a.or_(fpscr, instr.imm << shift);
+   }
+
+   updateFEX_VX(a, fpscr);
+
+   if (instr.crfD == 7) {
+      updateHostRoundingMode(a, fpscr);
+   }
+
+   return true;
+}
+
 void registerFloatInstructions()
 {
    // TODO: fmXXX instructions are CLOSE, but not perfectly
@@ -420,8 +885,8 @@ void registerFloatInstructions()
    RegisterInstruction(fmuls);
    RegisterInstruction(fsub);
    RegisterInstruction(fsubs);
-   RegisterInstructionFallback(fres);
-   RegisterInstructionFallback(frsqrte);
+   RegisterInstruction(fres);
+   RegisterInstruction(frsqrte);
    RegisterInstruction(fsel);
    RegisterInstruction(fmadd);
    RegisterInstruction(fmadds);
@@ -431,18 +896,18 @@ void registerFloatInstructions()
    RegisterInstruction(fnmadds);
    RegisterInstruction(fnmsub);
    RegisterInstruction(fnmsubs);
-   RegisterInstructionFallback(fctiw);
-   RegisterInstructionFallback(fctiwz);
+   RegisterInstruction(fctiw);
+   RegisterInstruction(fctiwz);
    RegisterInstruction(frsp);
    RegisterInstruction(fabs);
    RegisterInstruction(fnabs);
    RegisterInstruction(fmr);
    RegisterInstruction(fneg);
-   RegisterInstructionFallback(mffs);
-   RegisterInstructionFallback(mtfsb0);
-   RegisterInstructionFallback(mtfsb1);
-   RegisterInstructionFallback(mtfsf);
-   RegisterInstructionFallback(mtfsfi);
+   RegisterInstruction(mffs);
+   RegisterInstruction(mtfsb0);
+   RegisterInstruction(mtfsb1);
+   RegisterInstruction(mtfsf);
+   RegisterInstruction(mtfsfi);
 }
 
 } // namespace jit
@@ -17,6 +17,17 @@ truncateToSingleSd(PPCEmuAssembler& a,
                    const PPCEmuAssembler::XmmRegister& dst,
                    const PPCEmuAssembler::XmmRegister& src);
 
+void
+syncFPSCRExceptions(PPCEmuAssembler& a,
+                    const PPCEmuAssembler::GpRegister& fpscr);
+
+void
+clearHostFPExceptions(PPCEmuAssembler& a);
+
+void
+updateFEX_VX(PPCEmuAssembler& a,
+             const PPCEmuAssembler::GpRegister& fpscr);
+
 } // namespace jit
 
 } // namespace cpu
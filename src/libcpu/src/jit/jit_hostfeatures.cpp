@@ -0,0 +1,30 @@
+#include "common/log.h"
+#include "jit_hostfeatures.h"
+
+namespace cpu
+{
+
+namespace jit
+{
+
+/**
+ * Report the optional instruction set extensions the instruction generators
+ * can pick between alternative sequences with.
+ */
+void
+logHostFeatures()
+{
+   auto &features = getCpuFeatures();
+
+   if (!features.fma3) {
+      gLog->warn("FMA3 instructions not available; fused multiply-add results will be inaccurate");
+   }
+
+   gLog->debug("JIT host features: SSSE3 {}, FMA3 {}, MOVBE {}, LZCNT {}, BMI1 {}, BMI2 {}",
+               features.ssse3, features.fma3, features.movbe,
+               features.lzcnt, features.bmi1, features.bmi2);
+}
+
+} // namespace jit
+
+} // namespace cpu
@@ -0,0 +1,51 @@
+#pragma once
+#include "common/cpufeatures.h"
+
+namespace cpu
+{
+
+namespace jit
+{
+
+void
+logHostFeatures();
+
+inline bool
+hostHasSSSE3()
+{
+   return getCpuFeatures().ssse3;
+}
+
+inline bool
+hostHasFMA3()
+{
+   return getCpuFeatures().fma3;
+}
+
+inline bool
+hostHasMOVBE()
+{
+   return getCpuFeatures().movbe;
+}
+
+inline bool
+hostHasLZCNT()
+{
+   return getCpuFeatures().lzcnt;
+}
+
+inline bool
+hostHasBMI1()
+{
+   return getCpuFeatures().bmi1;
+}
+
+inline bool
+hostHasBMI2()
+{
+   return getCpuFeatures().bmi2;
+}
+
+} // namespace jit
+
+} // namespace cpu
@@ -1,5 +1,6 @@
 #include <cassert>
 #include "jit_insreg.h"
+#include "jit_hostfeatures.h"
 #include "common/bitutils.h"
 
 using espresso::ConditionRegisterFlag;
@@ -77,6 +78,24 @@ template<unsigned flags = 0>
 static bool
 addGeneric(PPCEmuAssembler& a, Instruction instr)
 {
+   // addi and addis of a known value, which includes li and lis, give a known
+   //  value so that later loads and stores can use it as an absolute address.
+   if ((flags & AddImmediate) && (flags & AddZeroRA)) {
+      auto value = 0u;
+
+      if (instr.rA == 0 || a.getKnownGpr(instr.rA, value)) {
+         if (flags & AddShifted) {
+            value += static_cast<uint32_t>(instr.simm) << 16;
+         } else {
+            value += sign_extend<16>(instr.simm);
+         }
+
+         a.mov(a.loadRegisterWrite(a.gpr[instr.rD]), value);
+         a.setKnownGpr(instr.rD, value);
+         return true;
+      }
+   }
+
    auto eaxLockout = a.lockRegister(asmjit::x86::rax);
 
    bool recordCarry = false;
@@ -131,12 +150,9 @@ addGeneric(PPCEmuAssembler& a, Instruction instr)
          a.shl(src1, 16);
       }
 
-      // Mark x64 CF based on PPC CF
+      // Mark x64 CF based on PPC CF, BT copies the bit straight into CF
       if (flags & AddExtended) {
-         auto carry = a.allocGpTmp().r32();
-         a.mov(carry, a.loadRegisterRead(a.xer));
-         a.and_(carry, XERegisterBits::Carry);
-         a.add(carry, 0xffffffff);
+         a.bt(a.loadRegisterRead(a.xer), XERegisterBits::CarryShift);
 
          a.adc(src0, src1);
       } else if (flags & AddSubtract) {
@@ -165,9 +181,9 @@ addGeneric(PPCEmuAssembler& a, Instruction instr)
          a.shiftTo(tmp, XERegisterBits::OverflowShift, XERegisterBits::StickyOVShift);
          a.or_(xerbits, tmp);
       } else if (recordCarry) {
-         a.mov(xerbits, 0);
-         a.setc(xerbits.r8());
-         a.shiftTo(xerbits, 0, XERegisterBits::CarryShift);
+         // SBB turns CF into all ones or zero without a partial register write
+         a.sbb(xerbits, xerbits);
+         a.and_(xerbits, XERegisterBits::Carry);
       } else if (recordOverflow) {
          a.mov(xerbits, 0);
          a.seto(xerbits.r8());
@@ -278,21 +294,26 @@ andGeneric(PPCEmuAssembler& a, Instruction instr)
       auto src0 = a.loadRegisterRead(a.gpr[instr.rS]);
       auto tmp = a.allocGpTmp().r32();
 
-      if (flags & AndImmediate) {
-         a.mov(tmp, instr.uimm);
+      if ((flags & AndComplement) && !(flags & AndImmediate) && hostHasBMI1()) {
+         // ANDN does the complement and the AND in one instruction
+         a.andn(tmp, a.loadRegisterRead(a.gpr[instr.rB]), src0);
       } else {
-         a.mov(tmp, a.loadRegisterRead(a.gpr[instr.rB]));
-      }
+         if (flags & AndImmediate) {
+            a.mov(tmp, instr.uimm);
+         } else {
+            a.mov(tmp, a.loadRegisterRead(a.gpr[instr.rB]));
+         }
 
-      if (flags & AndShifted) {
-         a.shl(tmp, 16);
-      }
+         if (flags & AndShifted) {
+            a.shl(tmp, 16);
+         }
 
-      if (flags & AndComplement) {
-         a.not_(tmp);
-      }
+         if (flags & AndComplement) {
+            a.not_(tmp);
+         }
 
-      a.and_(tmp, src0);
+         a.and_(tmp, src0);
+      }
 
       a.mov(dst, tmp);
    }
@@ -340,7 +361,10 @@ cntlzw(PPCEmuAssembler& a, Instruction instr)
 
    auto dst = a.loadRegisterWrite(a.gpr[instr.rA]);
 
-   {
+   if (hostHasLZCNT()) {
+      // LZCNT gives 32 for zero, exactly what cntlzw wants
+      a.lzcnt(dst, a.loadRegisterRead(a.gpr[instr.rS]));
+   } else {
       auto lblZero = a.newLabel();
 
       auto src0 = a.loadRegisterRead(a.gpr[instr.rS]);
@@ -729,6 +753,23 @@ template<unsigned flags>
 static bool
 orGeneric(PPCEmuAssembler& a, Instruction instr)
 {
+   // Keep track of the common lis, ori pair for building a constant
+   if ((flags & OrImmediate) && !(flags & OrAlwaysRecord)) {
+      auto value = 0u;
+
+      if (a.getKnownGpr(instr.rS, value)) {
+         if (flags & OrShifted) {
+            value |= static_cast<uint32_t>(instr.uimm) << 16;
+         } else {
+            value |= instr.uimm;
+         }
+
+         a.mov(a.loadRegisterWrite(a.gpr[instr.rA]), value);
+         a.setKnownGpr(instr.rA, value);
+         return true;
+      }
+   }
+
    auto eaxLockout = a.lockRegister(asmjit::x86::rax);
 
    auto dst = a.loadRegisterWrite(a.gpr[instr.rA]);
@@ -812,20 +853,30 @@ rlwGeneric(PPCEmuAssembler& a, Instruction instr)
    {
       auto tmp = a.allocGpTmp().r32();
 
-      a.mov(tmp, a.loadRegisterRead(a.gpr[instr.rS]));
-
-      if (flags & RlwImmediate) {
-         a.rol(tmp, instr.sh);
+      if ((flags & RlwImmediate) && hostHasBMI2()) {
+         // RORX rotates into a different register, saving the copy
+         a.rorx(tmp, a.loadRegisterRead(a.gpr[instr.rS]), (32 - instr.sh) & 31);
       } else {
-         a.mov(asmjit::x86::ecx, a.loadRegisterRead(a.gpr[instr.rB]));
-         a.and_(asmjit::x86::ecx, 0x1f);
-         a.rol(tmp, asmjit::x86::cl);
+         a.mov(tmp, a.loadRegisterRead(a.gpr[instr.rS]));
+
+         if (flags & RlwImmediate) {
+            if (instr.sh) {
+               a.rol(tmp, instr.sh);
+            }
+         } else {
+            a.mov(asmjit::x86::ecx, a.loadRegisterRead(a.gpr[instr.rB]));
+            a.and_(asmjit::x86::ecx, 0x1f);
+            a.rol(tmp, asmjit::x86::cl);
+         }
       }
 
       auto m = make_ppc_bitmask(instr.mb, instr.me);
 
       if (flags & RlwAnd) {
-         a.and_(tmp, m);
+         // A full mask is a plain rotate, rotlwi and rotlw
+         if (m != 0xFFFFFFFF) {
+            a.and_(tmp, m);
+         }
       } else if (flags & RlwInsert) {
          a.and_(tmp, m);
 
@@ -28,6 +28,26 @@ RSP    . Emu Stack Pointer.
 R8-R15 . Scratch
 */
 
+// Guest registers accessed by each instruction of a block.  GPRs use bits
+//  0-31 and FPRs bits 32-63 of the masks.
+struct BlockLiveness
+{
+   struct Instruction
+   {
+      //! Registers read by the instruction
+      uint64_t reads = 0;
+
+      //! GPRs completely overwritten by the instruction
+      uint64_t writes = 0;
+
+      //! The instruction may read or write any guest register
+      bool barrier = false;
+   };
+
+   uint32_t start = 0;
+   std::vector<Instruction> instrs;
+};
+
 class PPCEmuAssembler : public asmjit::X86Assembler
 {
 private:
@@ -185,6 +205,10 @@ public:
    uint32_t genCia;
    std::vector<std::pair<uint32_t, asmjit::Label>> relocLabels;
 
+   // Register usage of the block being generated, when set it is used to
+   //  pick which cached register to evict and to skip storing dead values.
+   const BlockLiveness *liveness = nullptr;
+
    asmjit::X86GpReg sysArgReg[4];
    asmjit::X86GpReg finaleNiaArgReg;
    asmjit::X86GpReg finaleJmpSrcArgReg;
@@ -215,6 +239,38 @@ public:
 
    uint32_t mLruCounter = 0;
 
+   // Guest GPRs whose value is known at compile time.  Blocks are straight
+   //  line code, so a value only has to be forgotten when the register is
+   //  written or when we call out to code which may write any register.
+   uint32_t mKnownGprMask = 0;
+   std::array<uint32_t, 32> mKnownGprValues;
+
+   bool getKnownGpr(uint32_t id, uint32_t &value)
+   {
+      if (!(mKnownGprMask & (1u << id))) {
+         return false;
+      }
+
+      value = mKnownGprValues[id];
+      return true;
+   }
+
+   void setKnownGpr(uint32_t id, uint32_t value)
+   {
+      mKnownGprMask |= 1u << id;
+      mKnownGprValues[id] = value;
+   }
+
+   void forgetKnownGpr(uint32_t id)
+   {
+      mKnownGprMask &= ~(1u << id);
+   }
+
+   void forgetKnownGprs()
+   {
+      mKnownGprMask = 0;
+   }
+
    static bool
    isSameRegister(const asmjit::X86Reg &a, const asmjit::X86Reg &b)
    {
@@ -436,12 +492,102 @@ public:
       return RegLockout();
    }
 
+   // Returns the liveness bit of a guest register, or -1 if it is not tracked
+   int getLivenessBit(uint32_t content)
+   {
+      if (content >= gpr[0].offset && content <= gpr[31].offset) {
+         return (content - gpr[0].offset) / gpr[0].size;
+      }
+
+      if (content >= fprps[0].offset && content <= fprps[31].offset) {
+         return 32 + (content - fprps[0].offset) / fprps[0].size;
+      }
+
+      return -1;
+   }
+
+   // Number of instructions until a guest register is next accessed, before
+   //  anything forces it to be written back anyway.
+   uint32_t getNextUse(uint32_t content)
+   {
+      if (!liveness) {
+         return 0;
+      }
+
+      auto bit = getLivenessBit(content);
+
+      if (bit < 0) {
+         return 1;
+      }
+
+      auto mask = 1ull << bit;
+      auto index = (genCia - liveness->start) / 4;
+
+      for (auto i = index; i < liveness->instrs.size(); ++i) {
+         auto &info = liveness->instrs[i];
+
+         if (info.barrier) {
+            break;
+         }
+
+         if ((info.reads | info.writes) & mask) {
+            return i - index;
+         }
+      }
+
+      return 0xFFFFFFFF;
+   }
+
+   // Whether a cached GPR will be overwritten before anything can read it,
+   //  in which case it does not need to be written back when evicted.
+   bool isDeadValue(uint32_t content)
+   {
+      if (!liveness) {
+         return false;
+      }
+
+      auto bit = getLivenessBit(content);
+
+      if (bit < 0 || bit >= 32) {
+         return false;
+      }
+
+      auto mask = 1ull << bit;
+      auto index = (genCia - liveness->start) / 4;
+
+      if (index >= liveness->instrs.size()) {
+         return false;
+      }
+
+      auto &current = liveness->instrs[index];
+
+      if (current.barrier || ((current.reads | current.writes) & mask)) {
+         return false;
+      }
+
+      for (auto i = index + 1; i < liveness->instrs.size(); ++i) {
+         auto &info = liveness->instrs[i];
+
+         if (info.barrier || (info.reads & mask)) {
+            return false;
+         }
+
+         if (info.writes & mask) {
+            return true;
+         }
+      }
+
+      return false;
+   }
+
    HostRegister * allocReg(RegType regType) {
-      uint32_t lruReg = 0xFFFFFFFF;
-      uint32_t lruValue = 0xFFFFFFFF;
+      uint32_t evictReg = 0xFFFFFFFF;
+      uint32_t evictNextUse = 0;
+      uint32_t evictLru = 0xFFFFFFFF;
 
-      // Pick a register from completely empty ones, track the
-      //  least-recently used register at the same time.
+      // Pick a register from completely empty ones, track the register
+      //  whose value is needed furthest in the future at the same time,
+      //  falling back to the least-recently used one.
       for (auto i = 0; i < mRegs.size(); ++i) {
          auto &reg = mRegs[i];
          if (reg.regType != regType) {
@@ -453,16 +599,26 @@ public:
                return &reg;
             }
 
-            if (reg.lruValue < lruValue) {
-               lruReg = i;
-               lruValue = reg.lruValue;
+            auto nextUse = getNextUse(reg.content);
+
+            if (evictReg == 0xFFFFFFFF
+             || nextUse > evictNextUse
+             || (nextUse == evictNextUse && reg.lruValue < evictLru)) {
+               evictReg = i;
+               evictNextUse = nextUse;
+               evictLru = reg.lruValue;
             }
          }
       }
 
-      // If we have an LRU register, lets evict it and use that one.
-      if (lruReg != 0xFFFFFFFF) {
-         auto &reg = mRegs[lruReg];
+      // If we found a register to evict, lets use that one.
+      if (evictReg != 0xFFFFFFFF) {
+         auto &reg = mRegs[evictReg];
+
+         if (isDeadValue(reg.content)) {
+            reg.written = false;
+         }
+
          evictOne(&reg);
          reg.useCount++;
          return &reg;
@@ -540,6 +696,10 @@ public:
    {
       decaf_check(which.size == 4 || which.size == 8);
 
+      if (writeOnUse && which.offset >= gpr[0].offset && which.offset <= gpr[31].offset) {
+         forgetKnownGpr((which.offset - gpr[0].offset) / 4);
+      }
+
       auto reg = findReg(which);
       if (reg && reg->regType != RegType::Gp) {
          evictOne(reg);
@@ -694,6 +854,32 @@ public:
       reg->written = false;
    }
 
+   // Writes a cached guest register back to memory but keeps it cached
+   void flushRegister(const PpcRef &which)
+   {
+      auto reg = findReg(which);
+
+      if (reg) {
+         saveOne(reg);
+         reg->written = false;
+      }
+   }
+
+   // Drops a cached guest register without writing it back, for when its
+   //  value in memory is about to be replaced directly.
+   void discardRegister(const PpcRef &which)
+   {
+      auto reg = findReg(which);
+
+      if (reg) {
+         decaf_check(reg->useCount == 0);
+         reg->content = 0xFFFFFFFF;
+         reg->size = 0;
+         reg->loaded = false;
+         reg->written = false;
+      }
+   }
+
    void evictAll()
    {
       for (auto i = 0; i < mRegs.size(); ++i) {
@@ -703,6 +889,68 @@ public:
       }
    }
 
+   // Whether a host register survives a call into host code
+   bool isCalleeSavedRegister(const HostRegister *reg)
+   {
+      if (reg->regType != RegType::Gp) {
+         // xmm0-xmm4 are volatile on every platform we support
+         return false;
+      }
+
+      switch (mGpRegVals[reg->regId].getRegIndex()) {
+      case asmjit::kX86RegIndexR12:
+      case asmjit::kX86RegIndexR13:
+      case asmjit::kX86RegIndexR14:
+      case asmjit::kX86RegIndexR15:
+         return true;
+#ifdef PLATFORM_WINDOWS
+      case asmjit::kX86RegIndexSi:
+      case asmjit::kX86RegIndexDi:
+         return true;
+#endif
+      default:
+         return false;
+      }
+   }
+
+   // Prepares the register cache for a call to a host function which only
+   //  reads the GPRs in gprReads and only writes the GPRs in gprWrites.
+   //  Anything else cached in a callee-saved host register stays cached.
+   void evictForCall(uint32_t gprReads, uint32_t gprWrites)
+   {
+      for (auto i = 0; i < mRegs.size(); ++i) {
+         auto &reg = mRegs[i];
+
+         if (reg.content == 0xFFFFFFFF) {
+            continue;
+         }
+
+         if (!isCalleeSavedRegister(&reg)) {
+            evictOne(&reg);
+            continue;
+         }
+
+         if (reg.content < gpr[0].offset || reg.content > gpr[31].offset) {
+            continue;
+         }
+
+         auto bit = 1u << ((reg.content - gpr[0].offset) / 4);
+
+         if (gprWrites & bit) {
+            evictOne(&reg);
+         } else if (gprReads & bit) {
+            saveOne(&reg);
+            reg.written = false;
+         }
+      }
+
+      for (auto i = 0u; i < 32; ++i) {
+         if (gprWrites & (1u << i)) {
+            forgetKnownGpr(i);
+         }
+      }
+   }
+
 };
 
 template<typename T, typename Z>
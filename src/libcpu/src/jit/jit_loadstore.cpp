@@ -1,4 +1,5 @@
 #include "jit_insreg.h"
+#include "jit_hostfeatures.h"
 #include "common/bitutils.h"
 #include "common/decaf_assert.h"
 #include <algorithm>
@@ -12,6 +13,110 @@ namespace cpu
 namespace jit
 {
 
+// PSHUFB mask which byte swaps each of the four words in a register
+alignas(16) static const uint8_t
+sByteSwapWordsMask[16] = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 };
+
+// A known address is only used as a displacement if every byte an
+//  instruction can touch from it stays within the signed 32-bit range.
+static const uint32_t
+MaxKnownDisplacement = 0x7FFF0000;
+
+struct EffectiveAddress
+{
+   bool known = false;
+   bool inRegister = false;
+   uint32_t value = 0;
+   PPCEmuAssembler::GpRegister reg;
+};
+
+/*
+ * The effective address is calculated in 32 bits so it wraps exactly as it
+ * does on the guest, and is then folded into a single [membase + ea] memory
+ * operand by guestMemory.  When the address is known at compile time, from
+ * rA == 0 or from a constant built by lis/addi, no register is needed at all
+ * unless the caller asks for one.
+ */
+static EffectiveAddress
+getEffectiveAddress(PPCEmuAssembler& a,
+                    Instruction instr,
+                    bool zeroRA,
+                    bool indexed,
+                    bool needRegister)
+{
+   auto ea = EffectiveAddress { };
+   auto d = sign_extend<16, int32_t>(instr.d);
+
+   if (!indexed) {
+      if (zeroRA && instr.rA == 0) {
+         ea.known = true;
+         ea.value = static_cast<uint32_t>(d);
+      } else if (a.getKnownGpr(instr.rA, ea.value)) {
+         ea.known = true;
+         ea.value += static_cast<uint32_t>(d);
+      }
+   }
+
+   if (ea.known) {
+      if (needRegister || ea.value > MaxKnownDisplacement) {
+         ea.reg = a.allocGpTmp().r32();
+         ea.inRegister = true;
+         a.mov(ea.reg, ea.value);
+      }
+
+      return ea;
+   }
+
+   ea.reg = a.allocGpTmp().r32();
+   ea.inRegister = true;
+
+   if (zeroRA && instr.rA == 0) {
+      a.mov(ea.reg, a.loadRegisterRead(a.gpr[instr.rB]));
+   } else {
+      auto base = a.loadRegisterRead(a.gpr[instr.rA]);
+
+      if (indexed) {
+         auto index = a.loadRegisterRead(a.gpr[instr.rB]);
+         a.lea(ea.reg, asmjit::X86Mem(base.r64(), index.r64(), 0, 0));
+      } else if (d != 0) {
+         a.lea(ea.reg, asmjit::X86Mem(base.r64(), d));
+      } else {
+         a.mov(ea.reg, base);
+      }
+   }
+
+   return ea;
+}
+
+static asmjit::X86Mem
+guestMemory(PPCEmuAssembler& a,
+            const EffectiveAddress& ea,
+            int32_t offset,
+            uint32_t size)
+{
+   if (!ea.inRegister) {
+      return asmjit::X86Mem(a.membaseReg, static_cast<int32_t>(ea.value) + offset, size);
+   }
+
+   return asmjit::X86Mem(a.membaseReg, ea.reg.r64(), 0, offset, size);
+}
+
+// Writes back the effective address for the update forms
+static void
+updateBaseRegister(PPCEmuAssembler& a,
+                   Instruction instr,
+                   const EffectiveAddress& ea)
+{
+   auto addrDst = a.loadRegisterWrite(a.gpr[instr.rA]);
+
+   if (ea.known) {
+      a.mov(addrDst, ea.value);
+      a.setKnownGpr(instr.rA, ea.value);
+   } else {
+      a.mov(addrDst, ea.reg);
+   }
+}
+
 // Load
 enum LoadFlags
 {
@@ -29,40 +134,39 @@ loadGeneric(PPCEmuAssembler& a, Instruction instr)
 {
    static_assert(sizeof(Type) == 1 || sizeof(Type) == 2 || sizeof(Type) == 4 || sizeof(Type) == 8, "Unexpected type size");
 
-   auto src = a.allocGpTmp().r32();
+   // lwarx has to keep the value exactly as it is in memory for stwcx.
+   const bool useMovbe = sizeof(Type) > 1
+                      && !(flags & (LoadByteReverse | LoadReserve))
+                      && hostHasMOVBE();
 
-   if ((flags & LoadZeroRA) && instr.rA == 0) {
-      a.mov(src, 0);
-   } else {
-      a.mov(src, a.loadRegisterRead(a.gpr[instr.rA]));
-   }
-
-   if (flags & LoadIndexed) {
-      a.add(src, a.loadRegisterRead(a.gpr[instr.rB]));
-   } else {
-      auto x = sign_extend<16, int32_t>(instr.d);
-      if (x != 0) {
-         a.add(src, x);
-      }
-   }
+   auto ea = getEffectiveAddress(a, instr,
+                                 !!(flags & LoadZeroRA),
+                                 !!(flags & LoadIndexed),
+                                 !!(flags & LoadReserve));
 
    auto data = a.allocGpTmp().r64();
-
-   {
-      auto hostSrc = a.allocGpTmp().r64();
-      a.mov(hostSrc, src);
-      a.add(hostSrc, a.membaseReg);
-
-      if (sizeof(Type) == 1) {
-         a.mov(data, 0);
-         a.mov(data.r8(), asmjit::X86Mem(hostSrc, 0));
-      } else if (sizeof(Type) == 2) {
-         a.mov(data, 0);
-         a.mov(data.r16(), asmjit::X86Mem(hostSrc, 0));
-      } else if (sizeof(Type) == 4) {
-         a.mov(data.r32(), asmjit::X86Mem(hostSrc, 0));
-      } else if (sizeof(Type) == 8) {
-         a.mov(data, asmjit::X86Mem(hostSrc, 0));
+   auto mem = guestMemory(a, ea, 0, sizeof(Type));
+
+   if (sizeof(Type) == 1) {
+      a.movzx(data.r32(), mem);
+   } else if (sizeof(Type) == 2) {
+      if (useMovbe) {
+         a.movbe(data.r16(), mem);
+         a.movzx(data.r32(), data.r16());
+      } else {
+         a.movzx(data.r32(), mem);
+      }
+   } else if (sizeof(Type) == 4) {
+      if (useMovbe) {
+         a.movbe(data.r32(), mem);
+      } else {
+         a.mov(data.r32(), mem);
+      }
+   } else if (sizeof(Type) == 8) {
+      if (useMovbe) {
+         a.movbe(data, mem);
+      } else {
+         a.mov(data, mem);
       }
    }
 
@@ -70,18 +174,16 @@ loadGeneric(PPCEmuAssembler& a, Instruction instr)
       static_assert(!(flags & LoadReserve) || sizeof(Type) == 4, "Reserved reads are only valid on 32-bit values");
 
       auto ppcreserve = a.loadRegisterWrite(a.reserve);
-      a.mov(ppcreserve, src);
+      a.mov(ppcreserve, ea.reg);
       a.shl(ppcreserve, 32);
       a.or_(ppcreserve, data);
    }
 
-   if (!(flags & LoadByteReverse)) {
+   if (!(flags & LoadByteReverse) && !useMovbe) {
       if (sizeof(Type) == 1) {
          // No need to byte-swap 1 byte
       } else if (sizeof(Type) == 2) {
-         a.shl(data, 8);
-         a.bswap(data.r32());
-         a.shr(data, 8);
+         a.rol(data.r16(), 8);
       } else if (sizeof(Type) == 4) {
          a.bswap(data.r32());
       } else if (sizeof(Type) == 8) {
@@ -114,8 +216,7 @@ loadGeneric(PPCEmuAssembler& a, Instruction instr)
    }
 
    if (flags & LoadUpdate) {
-      auto addrDst = a.loadRegisterWrite(a.gpr[instr.rA]);
-      a.mov(addrDst, src);
+      updateBaseRegister(a, instr, ea);
    }
 
    return true;
@@ -288,25 +389,40 @@ lfdx(PPCEmuAssembler& a, Instruction instr)
 static bool
 lmw(PPCEmuAssembler& a, Instruction instr)
 {
-   auto o = sign_extend<16, int32_t>(instr.d);
-
-   auto src = a.allocGpTmp().r64();
+   auto ea = getEffectiveAddress(a, instr, true, false, false);
+   auto r = static_cast<uint32_t>(instr.rD);
+   auto d = 0;
+
+   if (hostHasSSSE3() && r <= 28) {
+      // Whole groups of four words are swapped and written straight into
+      //  the register file, so any cached copies are now stale.
+      auto tmp = a.allocXmmTmp();
+      auto mask = a.allocXmmTmp();
+      auto maskAddr = a.allocGpTmp();
+      a.mov(maskAddr, reinterpret_cast<uint64_t>(sByteSwapWordsMask));
+      a.movdqa(mask, asmjit::X86Mem(maskAddr, 0, 16));
+
+      for (; r <= 28; r += 4, d += 16) {
+         for (auto i = r; i < r + 4; ++i) {
+            a.discardRegister(a.gpr[i]);
+            a.forgetKnownGpr(i);
+         }
 
-   if (instr.rA) {
-      a.mov(src, a.loadRegisterRead(a.gpr[instr.rA]));
-      if (o != 0) {
-         a.add(src, o);
+         a.movdqu(tmp, guestMemory(a, ea, d, 16));
+         a.pshufb(tmp, mask);
+         a.movdqu(asmjit::X86Mem(a.stateReg, a.gpr[r].offset, 16), tmp);
       }
-   } else {
-      a.mov(src, o);
    }
 
-   a.add(src, a.membaseReg);
-
-   for (int r = instr.rD, d = 0; r <= 31; ++r, d += 4) {
+   for (; r <= 31; ++r, d += 4) {
       auto dst = a.loadRegisterWrite(a.gpr[r]);
-      a.mov(dst, asmjit::X86Mem(src, d));
-      a.bswap(dst);
+
+      if (hostHasMOVBE()) {
+         a.movbe(dst, guestMemory(a, ea, d, 4));
+      } else {
+         a.mov(dst, guestMemory(a, ea, d, 4));
+         a.bswap(dst);
+      }
    }
 
    return true;
@@ -354,29 +470,17 @@ storeGeneric(PPCEmuAssembler& a, Instruction instr)
 {
    static_assert(sizeof(Type) == 1 || sizeof(Type) == 2 || sizeof(Type) == 4 || sizeof(Type) == 8, "Unexpected type size");
 
-   auto eaxLockout = a.lockRegister(asmjit::x86::rax);
+   // stwcx compares against the value exactly as it is in memory.
+   const bool useMovbe = sizeof(Type) > 1
+                      && !(flags & (StoreByteReverse | StoreConditional))
+                      && hostHasMOVBE();
 
-   auto dst = a.allocGpTmp().r32();
-   auto x = sign_extend<16, int32_t>(instr.d);
-
-   if ((flags & StoreZeroRA) && instr.rA == 0) {
-      if (flags & StoreIndexed) {
-         a.mov(dst, a.loadRegisterRead(a.gpr[instr.rB]));
-      } else {
-         a.mov(dst, x);
-      }
-   } else {
-      a.mov(dst, a.loadRegisterRead(a.gpr[instr.rA]));
-
-      if (flags & StoreIndexed) {
-         a.add(dst, a.loadRegisterRead(a.gpr[instr.rB]));
-      } else {
+   auto eaxLockout = a.lockRegister(asmjit::x86::rax);
 
-         if (x != 0) {
-            a.add(dst, x);
-         }
-      }
-   }
+   auto ea = getEffectiveAddress(a, instr,
+                                 !!(flags & StoreZeroRA),
+                                 !!(flags & StoreIndexed),
+                                 !!(flags & StoreConditional));
 
    auto data = a.allocGpTmp().r64();
 
@@ -396,14 +500,12 @@ storeGeneric(PPCEmuAssembler& a, Instruction instr)
       a.mov(data.r32(), a.loadRegisterRead(a.gpr[instr.rS]));
    }
 
-   if (!(flags & StoreByteReverse)) {
+   if (!(flags & StoreByteReverse) && !useMovbe) {
       if (sizeof(Type) == 1) {
          // Inverted reverse logic means we have
          //    to check for this but do nothing.
       } else if (sizeof(Type) == 2) {
-         a.shl(data, 8);
-         a.bswap(data.r32());
-         a.shr(data, 8);
+         a.rol(data.r16(), 8);
       } else if (sizeof(Type) == 4) {
          a.bswap(data.r32());
       } else if (sizeof(Type) == 8) {
@@ -414,9 +516,7 @@ storeGeneric(PPCEmuAssembler& a, Instruction instr)
    auto failedWriteLbl = a.newLabel();
 
    {
-      auto hostDst = a.allocGpTmp().r64();
-      a.mov(hostDst, dst);
-      a.add(hostDst, a.membaseReg);
+      auto mem = guestMemory(a, ea, 0, sizeof(Type));
 
       if (flags & StoreConditional) {
          static_assert(!(flags & StoreConditional) || sizeof(Type) == 4, "Reserved writes are only valid on 32-bit values");
@@ -444,30 +544,37 @@ storeGeneric(PPCEmuAssembler& a, Instruction instr)
          a.mov(asmjit::x86::eax, ppcreserve.r32());
          a.shr(ppcreserve, 32);
 
-         a.cmp(dst, ppcreserve);
+         a.cmp(ea.reg, ppcreserve);
          a.mov(ppcreserve, 0xffffffffffffffff);
          a.jne(failedWriteLbl);
 
-         a.lock().cmpxchg(asmjit::X86Mem(hostDst, 0), data.r32());
+         a.lock().cmpxchg(mem, data.r32());
          a.jne(failedWriteLbl);
 
          a.or_(ppccr, ConditionRegisterFlag::Equal << crshift);
+      } else if (useMovbe) {
+         if (sizeof(Type) == 2) {
+            a.movbe(mem, data.r16());
+         } else if (sizeof(Type) == 4) {
+            a.movbe(mem, data.r32());
+         } else if (sizeof(Type) == 8) {
+            a.movbe(mem, data);
+         }
       } else {
          if (sizeof(Type) == 1) {
-            a.mov(asmjit::X86Mem(hostDst, 0), data.r8());
+            a.mov(mem, data.r8());
          } else if (sizeof(Type) == 2) {
-            a.mov(asmjit::X86Mem(hostDst, 0), data.r16());
+            a.mov(mem, data.r16());
          } else if (sizeof(Type) == 4) {
-            a.mov(asmjit::X86Mem(hostDst, 0), data.r32());
+            a.mov(mem, data.r32());
          } else if (sizeof(Type) == 8) {
-            a.mov(asmjit::X86Mem(hostDst, 0), data);
+            a.mov(mem, data);
          }
       }
    }
 
    if (flags & StoreUpdate) {
-      auto addrDst = a.loadRegisterWrite(a.gpr[instr.rA]);
-      a.mov(addrDst, dst);
+      updateBaseRegister(a, instr, ea);
    }
 
    a.bind(failedWriteLbl);
@@ -624,26 +731,41 @@ stfiwx(PPCEmuAssembler& a, Instruction instr)
 static bool
 stmw(PPCEmuAssembler& a, Instruction instr)
 {
-   auto o = sign_extend<16, int32_t>(instr.d);
-
-   auto dst = a.allocGpTmp().r64();
+   auto ea = getEffectiveAddress(a, instr, true, false, false);
+   auto r = static_cast<uint32_t>(instr.rS);
+   auto d = 0;
+
+   if (hostHasSSSE3() && r <= 28) {
+      // Whole groups of four words are read straight from the register
+      //  file, so any modified cached copies have to be written back first.
+      auto tmp = a.allocXmmTmp();
+      auto mask = a.allocXmmTmp();
+      auto maskAddr = a.allocGpTmp();
+      a.mov(maskAddr, reinterpret_cast<uint64_t>(sByteSwapWordsMask));
+      a.movdqa(mask, asmjit::X86Mem(maskAddr, 0, 16));
+
+      for (; r <= 28; r += 4, d += 16) {
+         for (auto i = r; i < r + 4; ++i) {
+            a.flushRegister(a.gpr[i]);
+         }
 
-   if (instr.rA) {
-      a.mov(dst, a.loadRegisterRead(a.gpr[instr.rA]));
-      if (o != 0) {
-         a.add(dst, o);
+         a.movdqu(tmp, asmjit::X86Mem(a.stateReg, a.gpr[r].offset, 16));
+         a.pshufb(tmp, mask);
+         a.movdqu(guestMemory(a, ea, d, 16), tmp);
       }
-   } else {
-      a.mov(dst, o);
    }
 
-   a.add(dst, a.membaseReg);
+   for (; r <= 31; ++r, d += 4) {
+      auto src = a.loadRegisterRead(a.gpr[r]);
 
-   auto src = a.allocGpTmp().r32();
-   for (int r = instr.rS, d = 0; r <= 31; ++r, d += 4) {
-      a.mov(src, a.loadRegisterRead(a.gpr[r]));
-      a.bswap(src);
-      a.mov(asmjit::X86Mem(dst, d), src);
+      if (hostHasMOVBE()) {
+         a.movbe(guestMemory(a, ea, d, 4), src);
+      } else {
+         auto tmp = a.allocGpTmp().r32();
+         a.mov(tmp, src);
+         a.bswap(tmp);
+         a.mov(guestMemory(a, ea, d, 4), tmp);
+      }
    }
 
    return true;
@@ -1,5 +1,6 @@
 #include "jit_insreg.h"
 #include "jit_float.h"
+#include "jit_hostfeatures.h"
 #include "common/bitutils.h"
 
 namespace cpu
@@ -8,6 +9,744 @@ namespace cpu
 namespace jit
 {
 
+// cmppd predicates
+static const int
+CmpLessThan = 1;
+
+static const int
+CmpLessEqual = 2;
+
+static const int
+CmpUnordered = 3;
+
+static const int
+CmpNotEqual = 4;
+
+static const int
+CmpNotLessEqual = 6;
+
+static const int
+CmpOrdered = 7;
+
+// A pair of 64 bit lane values which instructions read straight from memory
+struct alignas(16) PairedConstant
+{
+   uint64_t ps0;
+   uint64_t ps1;
+};
+
+static const PairedConstant
+PairedSignBits = { UINT64_C(0x8000000000000000), UINT64_C(0x8000000000000000) };
+
+static const PairedConstant
+PairedAbsMask = { UINT64_C(0x7FFFFFFFFFFFFFFF), UINT64_C(0x7FFFFFFFFFFFFFFF) };
+
+static const PairedConstant
+PairedSingleMask = { UINT64_C(0xFFFFFFFFE0000000), UINT64_C(0xFFFFFFFFE0000000) };
+
+static const PairedConstant
+PairedLanePs0 = { UINT64_C(0xFFFFFFFFFFFFFFFF), 0 };
+
+static const PairedConstant
+PairedLaneBoth = { UINT64_C(0xFFFFFFFFFFFFFFFF), UINT64_C(0xFFFFFFFFFFFFFFFF) };
+
+static const PairedConstant
+PairedDefaultNaN = { UINT64_C(0x7FF8000000000000), UINT64_C(0x7FF8000000000000) };
+
+static const PairedConstant
+PairedFloatOne = { UINT64_C(0x3F8000003F800000), UINT64_C(0x3F8000003F800000) };
+
+static const PairedConstant
+PairedFloatOneHigh = { 0, UINT64_C(0x3F8000003F800000) };
+
+// Smallest normal double, multipliers below this need normalising
+static const PairedConstant
+PairedDoubleMin = { UINT64_C(0x0010000000000000), UINT64_C(0x0010000000000000) };
+
+// Smallest multiplier which rounds up to infinity
+static const PairedConstant
+PairedMultiplierMax = { UINT64_C(0x7FEFFFFFF8000000), UINT64_C(0x7FEFFFFFF8000000) };
+
+// Mask which keeps the bits of a double with the exponent 874 + index that
+//  survive truncation to a single precision denormal
+static const uint64_t
+SingleDenormalMasks[23] = {
+   UINT64_C(0xFFF0000000000000), UINT64_C(0xFFF8000000000000),
+   UINT64_C(0xFFFC000000000000), UINT64_C(0xFFFE000000000000),
+   UINT64_C(0xFFFF000000000000), UINT64_C(0xFFFF800000000000),
+   UINT64_C(0xFFFFC00000000000), UINT64_C(0xFFFFE00000000000),
+   UINT64_C(0xFFFFF00000000000), UINT64_C(0xFFFFF80000000000),
+   UINT64_C(0xFFFFFC0000000000), UINT64_C(0xFFFFFE0000000000),
+   UINT64_C(0xFFFFFF0000000000), UINT64_C(0xFFFFFF8000000000),
+   UINT64_C(0xFFFFFFC000000000), UINT64_C(0xFFFFFFE000000000),
+   UINT64_C(0xFFFFFFF000000000), UINT64_C(0xFFFFFFF800000000),
+   UINT64_C(0xFFFFFFFC00000000), UINT64_C(0xFFFFFFFE00000000),
+   UINT64_C(0xFFFFFFFF00000000), UINT64_C(0xFFFFFFFF80000000),
+   UINT64_C(0xFFFFFFFFC0000000),
+};
+
+static asmjit::X86Mem
+loadPairedConstant(PPCEmuAssembler& a,
+                   const PPCEmuAssembler::GpRegister& tmp,
+                   const PairedConstant& value)
+{
+   a.mov(tmp, reinterpret_cast<uint64_t>(&value));
+   return asmjit::X86Mem(tmp, 0, 16);
+}
+
+// Round both lanes from double to single precision and back
+static void
+roundToSinglePd(PPCEmuAssembler& a,
+                const PPCEmuAssembler::XmmRegister& reg)
+{
+   a.cvtpd2ps(reg, reg);
+   a.cvtps2pd(reg, reg);
+}
+
+// Helpers to move a single lane between an xmm and a gp register
+static void
+extractLane(PPCEmuAssembler& a,
+            const PPCEmuAssembler::GpRegister& dst,
+            const PPCEmuAssembler::XmmRegister& src,
+            const PPCEmuAssembler::XmmRegister& tmp,
+            int lane)
+{
+   if (lane == 0) {
+      a.movq(dst, src);
+   } else {
+      a.movapd(tmp, src);
+      a.unpckhpd(tmp, tmp);
+      a.movq(dst, tmp);
+   }
+}
+
+static void
+insertLane(PPCEmuAssembler& a,
+           const PPCEmuAssembler::XmmRegister& dst,
+           const PPCEmuAssembler::GpRegister& src,
+           const PPCEmuAssembler::XmmRegister& tmp,
+           int lane)
+{
+   a.movq(tmp, src);
+
+   if (lane == 0) {
+      a.movsd(dst, tmp);
+   } else {
+      a.unpcklpd(dst, tmp);
+   }
+}
+
+// Masking the mantissa of ps1 only truncates it correctly while its exponent
+//  is within the single precision range.  Outside of it, truncate_double
+//  turns the value into an infinity or a single precision denormal.
+static void
+truncateRangePs1(PPCEmuAssembler& a,
+                 const PPCEmuAssembler::XmmRegister& reg)
+{
+   // Everything is allocated before the first branch so that no spill is
+   //  only emitted on one of the paths.
+   auto tmp = a.allocXmmTmp();
+   auto bits = a.allocGpTmp();
+   auto exponent = a.allocGpTmp();
+   auto constant = a.allocGpTmp();
+
+   auto smallLbl = a.newLabel();
+   auto zeroLbl = a.newLabel();
+   auto insertLbl = a.newLabel();
+   auto doneLbl = a.newLabel();
+
+   extractLane(a, bits, reg, tmp, 1);
+   a.mov(exponent, bits);
+   a.shr(exponent, 52);
+   a.and_(exponent, 0x7FF);
+
+   a.cmp(exponent, 896);
+   a.jbe(smallLbl);
+   a.cmp(exponent, 1151);
+   a.jb(doneLbl);
+   a.cmp(exponent, 0x7FF);
+   a.je(doneLbl);
+
+   // Too large for a single, becomes an infinity
+   a.shr(bits, 63);
+   a.shl(bits, 63);
+   a.mov(constant, UINT64_C(0x7FF0000000000000));
+   a.or_(bits, constant);
+   a.jmp(insertLbl);
+
+   // Too small for a normal single, only the bits a denormal can hold are
+   //  kept and anything below the smallest denormal becomes zero
+   a.bind(smallLbl);
+   a.sub(exponent, 874);
+   a.jb(zeroLbl);
+   a.mov(constant, reinterpret_cast<uint64_t>(&SingleDenormalMasks[0]));
+   a.and_(bits, asmjit::X86Mem(constant, exponent, 3, 0, 8));
+   a.jmp(insertLbl);
+
+   a.bind(zeroLbl);
+   a.shr(bits, 63);
+   a.shl(bits, 63);
+
+   a.bind(insertLbl);
+   insertLane(a, reg, bits, tmp, 1);
+
+   a.bind(doneLbl);
+}
+
+// Rounds the non-NaN values in the lanes selected by roundLanes to single
+//  precision and truncates everything else, NaNs keep their signalling bit.
+//  This is how the hardware converts values it moves between registers.
+static void
+roundOrTruncateToSinglePd(PPCEmuAssembler& a,
+                          const PPCEmuAssembler::XmmRegister& reg,
+                          const PairedConstant& roundLanes)
+{
+   auto rounded = a.allocXmmTmp(reg);
+   auto mask = a.allocXmmTmp(reg);
+   auto constant = a.allocGpTmp();
+
+   roundToSinglePd(a, rounded);
+   a.cmppd(mask, mask, CmpOrdered);
+   a.pand(mask, loadPairedConstant(a, constant, roundLanes));
+   a.pand(reg, loadPairedConstant(a, constant, PairedSingleMask));
+
+   a.pand(rounded, mask);
+   a.pandn(mask, reg);
+   a.por(mask, rounded);
+   a.movapd(reg, mask);
+
+   // A NaN truncates correctly by masking, so only a ps1 which is never
+   //  rounded needs its exponent range checked
+   if (!roundLanes.ps1) {
+      truncateRangePs1(a, reg);
+   }
+}
+
+// roundForMultiply for one lane, in general purpose registers.  This
+//  handles every case the vector code in roundMultiplierPd does not: a
+//  denormal multiplier is normalised first, moving its exponent over to the
+//  other operand, and a multiplier which rounds up to infinity gives a power
+//  of two back to the other operand.  Both are only written back once the
+//  rounding is known to happen, exactly as in the interpreter.
+static void
+roundMultiplierLane(PPCEmuAssembler& a,
+                    const PPCEmuAssembler::XmmRegister& reg,
+                    const PPCEmuAssembler::XmmRegister& other,
+                    const PPCEmuAssembler::XmmRegister& tmp,
+                    const PPCEmuAssembler::GpRegister& cBits,
+                    const PPCEmuAssembler::GpRegister& aBits,
+                    const PPCEmuAssembler::GpRegister& exponent,
+                    const PPCEmuAssembler::GpRegister& constant,
+                    int lane)
+{
+   auto normaliseLbl = a.newLabel();
+   auto roundLbl = a.newLabel();
+   auto denormalOtherLbl = a.newLabel();
+   auto commitLbl = a.newLabel();
+   auto doneLbl = a.newLabel();
+
+   extractLane(a, cBits, reg, tmp, lane);
+   extractLane(a, aBits, other, tmp, lane);
+
+   // NaN and infinite multipliers have nothing to round, neither do ones
+   //  without any bits below the 24 we keep
+   a.mov(exponent, cBits);
+   a.shl(exponent, 1);
+   a.shr(exponent, 53);
+   a.cmp(exponent, 0x7FF);
+   a.je(doneLbl);
+   a.test(cBits, 0x0FFFFFFF);
+   a.jz(doneLbl);
+
+   // A zero, infinite or NaN other operand decides the result on its own
+   a.mov(exponent, aBits);
+   a.add(exponent, exponent);
+   a.jz(doneLbl);
+   a.shr(exponent, 53);
+   a.cmp(exponent, 0x7FF);
+   a.je(doneLbl);
+
+   // Normalise a denormal multiplier, giving up if that makes the other
+   //  operand denormal as the product is zero anyway
+   a.mov(exponent, cBits);
+   a.shl(exponent, 1);
+   a.shr(exponent, 53);
+   a.jnz(roundLbl);
+   a.mov(constant, UINT64_C(1) << 52);
+
+   a.bind(normaliseLbl);
+   a.shl(cBits, 1);
+   a.mov(exponent, aBits);
+   a.shl(exponent, 1);
+   a.shr(exponent, 53);
+   a.jz(doneLbl);
+   a.sub(aBits, constant);
+   a.mov(exponent, cBits);
+   a.shl(exponent, 1);
+   a.shr(exponent, 53);
+   a.jz(normaliseLbl);
+
+   a.bind(roundLbl);
+   a.mov(constant, UINT64_C(0xFFFFFFFFF8000000));
+   a.and_(cBits, constant);
+   a.mov(exponent, cBits);
+   a.and_(exponent, 0x8000000);
+   a.add(cBits, exponent);
+
+   // If that rounded up to infinity, move a power of two to the other
+   //  operand unless its product would overflow anyway
+   a.mov(exponent, cBits);
+   a.add(exponent, exponent);
+   a.mov(constant, UINT64_C(0xFFE0000000000000));
+   a.cmp(exponent, constant);
+   a.jne(commitLbl);
+
+   a.mov(constant, UINT64_C(1) << 52);
+   a.sub(cBits, constant);
+   a.mov(exponent, aBits);
+   a.shl(exponent, 1);
+   a.shr(exponent, 53);
+   a.jz(denormalOtherLbl);
+   a.cmp(exponent, 0x7FE);
+   a.jae(commitLbl);
+   a.add(aBits, constant);
+   a.jmp(commitLbl);
+
+   a.bind(denormalOtherLbl);
+   a.shl(aBits, 1);
+
+   a.bind(commitLbl);
+   insertLane(a, reg, cBits, tmp, lane);
+   insertLane(a, other, aBits, tmp, lane);
+
+   a.bind(doneLbl);
+}
+
+// Round the multiplier to 24 bits in the lanes which were taken from ps0, as
+//  roundForMultiply does in the interpreter, other is the operand it is
+//  multiplied with.  NaNs are left alone so their payload survives.
+//  Denormal multipliers and ones which round up to infinity also have to
+//  adjust the other operand, those can only be left in ps0 by a double
+//  precision instruction so they take a slower path.
+static void
+roundMultiplierPd(PPCEmuAssembler& a,
+                  const PPCEmuAssembler::XmmRegister& reg,
+                  const PPCEmuAssembler::XmmRegister& other,
+                  bool roundPs0,
+                  bool roundPs1)
+{
+   static const PairedConstant roundBits[4] = {
+      { 0, 0 },
+      { UINT64_C(0x8000000), 0 },
+      { 0, UINT64_C(0x8000000) },
+      { UINT64_C(0x8000000), UINT64_C(0x8000000) },
+   };
+
+   static const PairedConstant keepBits[4] = {
+      { UINT64_C(0xFFFFFFFFFFFFFFFF), UINT64_C(0xFFFFFFFFFFFFFFFF) },
+      { UINT64_C(0xFFFFFFFFF8000000), UINT64_C(0xFFFFFFFFFFFFFFFF) },
+      { UINT64_C(0xFFFFFFFFFFFFFFFF), UINT64_C(0xFFFFFFFFF8000000) },
+      { UINT64_C(0xFFFFFFFFF8000000), UINT64_C(0xFFFFFFFFF8000000) },
+   };
+
+   auto lanes = (roundPs0 ? 1 : 0) | (roundPs1 ? 2 : 0);
+
+   if (!lanes) {
+      return;
+   }
+
+   // Everything is allocated before the first branch so that no spill is
+   //  only emitted on one of the paths.
+   auto roundBit = a.allocXmmTmp(reg);
+   auto special = a.allocXmmTmp();
+   auto tmp = a.allocXmmTmp();
+   auto constant = a.allocGpTmp();
+   auto cBits = a.allocGpTmp();
+   auto aBits = a.allocGpTmp();
+   auto exponent = a.allocGpTmp();
+
+   auto slowLbl = a.newLabel();
+   auto doneLbl = a.newLabel();
+
+   // Look for non-zero multipliers below the normal range or ones which
+   //  round up to infinity, comparisons against NaN are always false
+   a.pand(roundBit, loadPairedConstant(a, constant, PairedAbsMask));
+   a.movapd(special, roundBit);
+   a.cmppd(special, loadPairedConstant(a, constant, PairedDoubleMin), CmpLessThan);
+   a.xorpd(tmp, tmp);
+   a.cmppd(tmp, roundBit, CmpNotEqual);
+   a.andpd(special, tmp);
+   a.movapd(tmp, loadPairedConstant(a, constant, PairedMultiplierMax));
+   a.cmppd(tmp, roundBit, CmpLessEqual);
+   a.orpd(special, tmp);
+   a.movmskpd(exponent, special);
+   a.test(exponent, lanes);
+   a.jnz(slowLbl);
+
+   a.movapd(roundBit, reg);
+   a.cmppd(roundBit, roundBit, CmpOrdered);
+   a.pand(roundBit, loadPairedConstant(a, constant, roundBits[lanes]));
+   a.pand(roundBit, reg);
+   a.pand(reg, loadPairedConstant(a, constant, keepBits[lanes]));
+   a.paddq(reg, roundBit);
+   a.jmp(doneLbl);
+
+   a.bind(slowLbl);
+
+   for (auto lane = 0; lane < 2; ++lane) {
+      if (lanes & (1 << lane)) {
+         roundMultiplierLane(a, reg, other, tmp, cBits, aBits, exponent, constant, lane);
+      }
+   }
+
+   a.bind(doneLbl);
+}
+
+// x86 produces a negative default NaN for invalid operations where Espresso
+//  produces a positive one.  inputNaNs must hold the lanes which had a NaN
+//  operand, as those propagate their NaN untouched; it is clobbered.
+static void
+fixDefaultNaNPd(PPCEmuAssembler& a,
+                const PPCEmuAssembler::XmmRegister& result,
+                const PPCEmuAssembler::XmmRegister& inputNaNs)
+{
+   auto tmp = a.allocXmmTmp(result);
+   auto constant = a.allocGpTmp();
+   a.cmppd(tmp, tmp, CmpUnordered);
+   a.pandn(inputNaNs, tmp);
+   a.pand(inputNaNs, loadPairedConstant(a, constant, PairedSignBits));
+   a.pandn(inputNaNs, result);
+   a.movapd(result, inputNaNs);
+}
+
+// Register move / sign bit manipulation
+enum MoveMode
+{
+   MoveDirect,
+   MoveNegate,
+   MoveAbsolute,
+   MoveNegAbsolute,
+};
+
+template<MoveMode mode>
+static bool
+moveGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   auto result = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frB]));
+
+   // ps0 is rounded unless it is a NaN, ps1 is always truncated
+   roundOrTruncateToSinglePd(a, result, PairedLanePs0);
+
+   if (mode != MoveDirect) {
+      auto constant = a.allocGpTmp();
+
+      switch (mode) {
+      case MoveNegate:
+         a.pxor(result, loadPairedConstant(a, constant, PairedSignBits));
+         break;
+      case MoveAbsolute:
+         a.pand(result, loadPairedConstant(a, constant, PairedAbsMask));
+         break;
+      case MoveNegAbsolute:
+         a.por(result, loadPairedConstant(a, constant, PairedSignBits));
+         break;
+      }
+   }
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
+static bool
+ps_mr(PPCEmuAssembler& a, Instruction instr)
+{
+   return moveGeneric<MoveDirect>(a, instr);
+}
+
+static bool
+ps_neg(PPCEmuAssembler& a, Instruction instr)
+{
+   return moveGeneric<MoveNegate>(a, instr);
+}
+
+static bool
+ps_abs(PPCEmuAssembler& a, Instruction instr)
+{
+   return moveGeneric<MoveAbsolute>(a, instr);
+}
+
+static bool
+ps_nabs(PPCEmuAssembler& a, Instruction instr)
+{
+   return moveGeneric<MoveNegAbsolute>(a, instr);
+}
+
+// Paired-single arithmetic
+enum PSArithOperator {
+   PSAdd,
+   PSSub,
+   PSMul,
+   PSDiv,
+};
+
+// Each result is computed in double precision then rounded to single, which
+//  matches the interpreter and the double rounding of the hardware.
+//  FPSCR is not updated, as with the other JIT floating point instructions.
+template<PSArithOperator op, int slotB0, int slotB1>
+static bool
+psArithGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   auto result = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+   auto inputNaNs = a.allocXmmTmp(result);
+
+   {
+      auto srcB = a.allocXmmTmp(a.loadRegisterRead(a.fprps[op == PSMul ? instr.frC : instr.frB]));
+
+      if (slotB0 == slotB1) {
+         a.shufpd(srcB, srcB, slotB0 ? 3 : 0);
+      }
+
+      if (op == PSMul) {
+         roundMultiplierPd(a, srcB, result, slotB0 == 0, slotB1 == 0);
+      }
+
+      a.cmppd(inputNaNs, srcB, CmpUnordered);
+
+      switch (op) {
+      case PSAdd:
+         a.addpd(result, srcB);
+         break;
+      case PSSub:
+         a.subpd(result, srcB);
+         break;
+      case PSMul:
+         a.mulpd(result, srcB);
+         break;
+      case PSDiv:
+         a.divpd(result, srcB);
+         break;
+      }
+   }
+
+   fixDefaultNaNPd(a, result, inputNaNs);
+   roundToSinglePd(a, result);
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
+static bool
+ps_add(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSAdd, 0, 1>(a, instr);
+}
+
+static bool
+ps_sub(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSSub, 0, 1>(a, instr);
+}
+
+static bool
+ps_mul(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSMul, 0, 1>(a, instr);
+}
+
+static bool
+ps_muls0(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSMul, 0, 0>(a, instr);
+}
+
+static bool
+ps_muls1(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSMul, 1, 1>(a, instr);
+}
+
+static bool
+ps_div(PPCEmuAssembler& a, Instruction instr)
+{
+   return psArithGeneric<PSDiv, 0, 1>(a, instr);
+}
+
+template<int slot>
+static bool
+psSumGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // Only ps0 of sum is used, it holds frA.ps0 + frB.ps1
+   auto sum = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+
+   {
+      auto inputNaNs = a.allocXmmTmp(sum);
+
+      {
+         auto srcB = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frB]));
+         a.unpckhpd(srcB, srcB);
+         a.cmppd(inputNaNs, srcB, CmpUnordered);
+         a.addsd(sum, srcB);
+      }
+
+      fixDefaultNaNPd(a, sum, inputNaNs);
+      roundToSingleSd(a, sum, sum);
+   }
+
+   auto result = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frC]));
+
+   if (slot == 0) {
+      // frC.ps1 is copied across untouched
+      a.movsd(result, sum);
+   } else {
+      roundOrTruncateToSinglePd(a, result, PairedLaneBoth);
+      a.unpcklpd(result, sum);
+   }
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
+static bool
+ps_sum0(PPCEmuAssembler& a, Instruction instr)
+{
+   return psSumGeneric<0>(a, instr);
+}
+
+static bool
+ps_sum1(PPCEmuAssembler& a, Instruction instr)
+{
+   return psSumGeneric<1>(a, instr);
+}
+
+// Fused multiply-add instructions
+enum FMAFlags
+{
+   FMASubtract   = 1 << 0, // Subtract instead of add
+   FMANegate     = 1 << 1, // Negate result
+};
+
+template<unsigned flags, int slotC0, int slotC1>
+static bool
+fmaGeneric(PPCEmuAssembler& a, Instruction instr)
+{
+   // Without FMA3 we cannot match the single rounding of the hardware
+   if (instr.rc || !hostHasFMA3()) {
+      return jit_fallback(a, instr);
+   }
+
+   auto result = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+   auto inputNaNs = a.allocXmmTmp(result);
+   a.cmppd(inputNaNs, a.loadRegisterRead(a.fprps[instr.frB]), CmpUnordered);
+
+   {
+      auto srcC = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frC]));
+
+      if (slotC0 == slotC1) {
+         a.shufpd(srcC, srcC, slotC0 ? 3 : 0);
+      }
+
+      {
+         auto tmp = a.allocXmmTmp(srcC);
+         a.cmppd(tmp, tmp, CmpUnordered);
+         a.por(inputNaNs, tmp);
+      }
+
+      roundMultiplierPd(a, srcC, result, slotC0 == 0, slotC1 == 0);
+
+      auto srcB = a.loadRegisterRead(a.fprps[instr.frB]);
+
+      if (flags & FMASubtract) {
+         a.vfmsub132pd(result, srcB, srcC);
+      } else {
+         a.vfmadd132pd(result, srcB, srcC);
+      }
+   }
+
+   {
+      // x86 propagates a NaN from the multiplicands before the addend, the
+      //  hardware picks frA, then frB, then frC.  So when frB is a NaN and
+      //  frA is not, frB must win over any NaN in frC.
+      auto useB = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+      auto srcB = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frB]));
+      auto nanB = a.allocXmmTmp(srcB);
+      a.cmppd(useB, useB, CmpUnordered);
+      a.cmppd(nanB, nanB, CmpUnordered);
+      a.pandn(useB, nanB);
+
+      a.pand(srcB, useB);
+      a.pandn(useB, result);
+      a.por(useB, srcB);
+      a.movapd(result, useB);
+   }
+
+   fixDefaultNaNPd(a, result, inputNaNs);
+   roundToSinglePd(a, result);
+
+   if (flags & FMANegate) {
+      // The result is negated after rounding, and never when it is a NaN
+      auto mask = a.allocXmmTmp(result);
+      auto constant = a.allocGpTmp();
+      a.cmppd(mask, mask, CmpOrdered);
+      a.pand(mask, loadPairedConstant(a, constant, PairedSignBits));
+      a.pxor(result, mask);
+   }
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
+static bool
+ps_madd(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<0, 0, 1>(a, instr);
+}
+
+static bool
+ps_madds0(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<0, 0, 0>(a, instr);
+}
+
+static bool
+ps_madds1(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<0, 1, 1>(a, instr);
+}
+
+static bool
+ps_msub(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMASubtract, 0, 1>(a, instr);
+}
+
+static bool
+ps_nmadd(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMANegate, 0, 1>(a, instr);
+}
+
+static bool
+ps_nmsub(PPCEmuAssembler& a, Instruction instr)
+{
+   return fmaGeneric<FMANegate | FMASubtract, 0, 1>(a, instr);
+}
+
 // Merge registers
 enum MergeFlags
 {
@@ -23,26 +762,19 @@ mergeGeneric(PPCEmuAssembler& a, Instruction instr)
       return jit_fallback(a, instr);
    }
 
-   auto tmpSrcA = a.allocXmmTmp();
-   auto tmpSrcB = a.allocXmmTmp();
-   {
-      auto srcA = a.loadRegisterRead(a.fprps[instr.frA]);
-      auto srcB = a.loadRegisterRead(a.fprps[instr.frB]);
-      if (flags & MergeValue0) {
-         a.movapd(tmpSrcA, srcA);
-         a.shufpd(tmpSrcA, tmpSrcA, 1);
-         roundToSingleSd(a, tmpSrcA, tmpSrcA);
-      } else {
-         roundToSingleSd(a, tmpSrcA, srcA);
-      }
-      if (flags & MergeValue1) {
-         a.movapd(tmpSrcB, srcB);
-         a.shufpd(tmpSrcB, tmpSrcB, 1);
-         truncateToSingleSd(a, tmpSrcB, tmpSrcB);
-      } else {
-         truncateToSingleSd(a, tmpSrcB, srcB);
-      }
+   auto tmpSrcA = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frA]));
+   if (flags & MergeValue0) {
+      a.shufpd(tmpSrcA, tmpSrcA, 1);
    }
+   roundOrTruncateToSinglePd(a, tmpSrcA, PairedLaneBoth);
+
+   // When inserting a double-precision value into slot 1, the mantissa
+   //  is truncated rather than rounded.
+   auto tmpSrcB = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frB]));
+   if (flags & MergeValue1) {
+      a.shufpd(tmpSrcB, tmpSrcB, 1);
+   }
+   truncateToSingleSd(a, tmpSrcB, tmpSrcB);
 
    auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
    a.movapd(dst, tmpSrcA);
@@ -75,29 +807,96 @@ ps_merge10(PPCEmuAssembler& a, Instruction instr)
    return mergeGeneric<MergeValue0>(a, instr);
 }
 
+// Reciprocal Square Root, the interpreter computes this exactly in single
+//  precision so we can do the same.
+static bool
+ps_rsqrte(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   auto result = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frB]));
+
+   {
+      auto one = a.allocXmmTmp();
+      auto constant = a.allocGpTmp();
+
+      // Fill the unused upper lanes with 1.0f so they raise no exceptions
+      a.cvtpd2ps(result, result);
+      a.por(result, loadPairedConstant(a, constant, PairedFloatOneHigh));
+      a.sqrtps(result, result);
+      a.movaps(one, loadPairedConstant(a, constant, PairedFloatOne));
+      a.divps(one, result);
+      a.cvtps2pd(result, one);
+   }
+
+   {
+      // Any negative non-zero input gives the default NaN, including tiny
+      //  doubles which became -0.0f above.
+      auto negative = a.allocXmmTmp(a.loadRegisterRead(a.fprps[instr.frB]));
+      auto defaultNaN = a.allocXmmTmp();
+      auto constant = a.allocGpTmp();
+      a.xorpd(defaultNaN, defaultNaN);
+      a.cmppd(negative, defaultNaN, CmpLessThan);
+      a.movapd(defaultNaN, loadPairedConstant(a, constant, PairedDefaultNaN));
+      a.pand(defaultNaN, negative);
+      a.pandn(negative, result);
+      a.por(negative, defaultNaN);
+      a.movapd(result, negative);
+   }
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
+// Select
+static bool
+ps_sel(PPCEmuAssembler& a, Instruction instr)
+{
+   if (instr.rc) {
+      return jit_fallback(a, instr);
+   }
+
+   // mask is set for the lanes where frA < 0 or NaN, which take frB
+   auto mask = a.allocXmmTmp();
+   a.xorpd(mask, mask);
+   a.cmppd(mask, a.loadRegisterRead(a.fprps[instr.frA]), CmpNotLessEqual);
+
+   auto result = a.allocXmmTmp(mask);
+   a.pand(mask, a.loadRegisterRead(a.fprps[instr.frB]));
+   a.pandn(result, a.loadRegisterRead(a.fprps[instr.frC]));
+   a.por(result, mask);
+
+   auto dst = a.loadRegisterWrite(a.fprps[instr.frD]);
+   a.movapd(dst, result);
+   return true;
+}
+
 void registerPairedInstructions()
 {
-   RegisterInstructionFallback(ps_add);
-   RegisterInstructionFallback(ps_div);
-   RegisterInstructionFallback(ps_mul);
-   RegisterInstructionFallback(ps_sub);
-   RegisterInstructionFallback(ps_abs);
-   RegisterInstructionFallback(ps_nabs);
-   RegisterInstructionFallback(ps_neg);
-   RegisterInstructionFallback(ps_sel);
+   RegisterInstruction(ps_add);
+   RegisterInstruction(ps_div);
+   RegisterInstruction(ps_mul);
+   RegisterInstruction(ps_sub);
+   RegisterInstruction(ps_abs);
+   RegisterInstruction(ps_nabs);
+   RegisterInstruction(ps_neg);
+   RegisterInstruction(ps_sel);
    RegisterInstructionFallback(ps_res);
-   RegisterInstructionFallback(ps_rsqrte);
-   RegisterInstructionFallback(ps_msub);
-   RegisterInstructionFallback(ps_madd);
-   RegisterInstructionFallback(ps_nmsub);
-   RegisterInstructionFallback(ps_nmadd);
-   RegisterInstructionFallback(ps_mr);
-   RegisterInstructionFallback(ps_sum0);
-   RegisterInstructionFallback(ps_sum1);
-   RegisterInstructionFallback(ps_muls0);
-   RegisterInstructionFallback(ps_muls1);
-   RegisterInstructionFallback(ps_madds0);
-   RegisterInstructionFallback(ps_madds1);
+   RegisterInstruction(ps_rsqrte);
+   RegisterInstruction(ps_msub);
+   RegisterInstruction(ps_madd);
+   RegisterInstruction(ps_nmsub);
+   RegisterInstruction(ps_nmadd);
+   RegisterInstruction(ps_mr);
+   RegisterInstruction(ps_sum0);
+   RegisterInstruction(ps_sum1);
+   RegisterInstruction(ps_muls0);
+   RegisterInstruction(ps_muls1);
+   RegisterInstruction(ps_madds0);
+   RegisterInstruction(ps_madds1);
    RegisterInstruction(ps_merge00);
    RegisterInstruction(ps_merge01);
    RegisterInstruction(ps_merge10);
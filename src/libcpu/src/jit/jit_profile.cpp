@@ -0,0 +1,264 @@
+#include "common/log.h"
+#include "common/platform.h"
+#include "cpu.h"
+#include "jit_profile.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#ifdef PLATFORM_POSIX
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#endif
+
+namespace cpu
+{
+
+namespace jit
+{
+
+// Interval between samples of host CPU time while profiling
+static const long
+SampleIntervalUs = 1000;
+
+// Number of samples buffered between reports, older samples are overwritten
+static const size_t
+SampleBufferSize = 1 << 20;
+
+static std::atomic<bool>
+sProfilingEnabled { false };
+
+// A deque never moves its elements, the generated code increments the
+//  entries counter of a profile in place.
+static std::mutex
+sBlockProfilesMutex;
+
+static std::deque<BlockProfile>
+sBlockProfiles;
+
+// Profiles of blocks thrown away by a cache clear, kept so their samples
+//  and entries still show up in the report.  Protected by sBlockProfilesMutex
+static std::vector<BlockProfile>
+sRetiredBlockProfiles;
+
+// Written from the SIGPROF handler, so only lock-free stores are allowed
+static std::array<uintptr_t, SampleBufferSize>
+sSamples;
+
+static std::atomic<uint64_t>
+sSampleCount { 0 };
+
+// Protected by sBlockProfilesMutex
+static uint64_t
+sSamplesProcessed = 0;
+
+static uint64_t
+sSamplesTotal = 0;
+
+#ifdef PLATFORM_POSIX
+
+static void
+profileSignalHandler(int, siginfo_t *, void *context)
+{
+   auto uc = reinterpret_cast<ucontext_t *>(context);
+
+#ifdef PLATFORM_APPLE
+   auto rip = static_cast<uintptr_t>(uc->uc_mcontext->__ss.__rip);
+#else
+   auto rip = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+#endif
+
+   auto index = sSampleCount.fetch_add(1, std::memory_order_relaxed);
+   sSamples[index & (SampleBufferSize - 1)] = rip;
+}
+
+static void
+startSampling()
+{
+   struct sigaction action = { };
+   action.sa_sigaction = profileSignalHandler;
+   action.sa_flags = SA_SIGINFO | SA_RESTART;
+   sigemptyset(&action.sa_mask);
+   sigaction(SIGPROF, &action, nullptr);
+
+   struct itimerval timer = { };
+   timer.it_interval.tv_usec = SampleIntervalUs;
+   timer.it_value.tv_usec = SampleIntervalUs;
+   setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+static void
+stopSampling()
+{
+   struct itimerval timer = { };
+   setitimer(ITIMER_PROF, &timer, nullptr);
+
+   // The default action for SIGPROF terminates the process, so ignore any
+   //  signal which is still pending rather than restoring it.
+   signal(SIGPROF, SIG_IGN);
+}
+
+#else
+
+static void
+startSampling()
+{
+   gLog->warn("JIT profile sampling is not supported on this platform, only block entries will be counted");
+}
+
+static void
+stopSampling()
+{
+}
+
+#endif
+
+bool
+isProfilingEnabled()
+{
+   return sProfilingEnabled.load(std::memory_order_relaxed);
+}
+
+BlockProfile *
+allocateBlockProfile(uint32_t start,
+                     uint32_t end)
+{
+   std::unique_lock<std::mutex> lock { sBlockProfilesMutex };
+   sBlockProfiles.emplace_back();
+
+   auto profile = &sBlockProfiles.back();
+   profile->start = start;
+   profile->end = end;
+   return profile;
+}
+
+void
+setBlockProfileCode(BlockProfile *profile,
+                    const void *hostStart,
+                    size_t hostSize)
+{
+   std::unique_lock<std::mutex> lock { sBlockProfilesMutex };
+   profile->hostStart = hostStart;
+   profile->hostSize = hostSize;
+}
+
+/**
+ * Attribute every sample taken since the last call to the block whose host
+ * code it landed in.
+ *
+ * Must be called with sBlockProfilesMutex held.
+ */
+static void
+processSamples()
+{
+   auto count = sSampleCount.load(std::memory_order_acquire);
+   auto first = std::max(sSamplesProcessed, count > SampleBufferSize ? count - SampleBufferSize : 0);
+
+   if (first == count) {
+      return;
+   }
+
+   std::vector<BlockProfile *> blocks;
+   blocks.reserve(sBlockProfiles.size());
+
+   for (auto &profile : sBlockProfiles) {
+      if (profile.hostStart) {
+         blocks.push_back(&profile);
+      }
+   }
+
+   std::sort(blocks.begin(), blocks.end(),
+             [](BlockProfile *lhs, BlockProfile *rhs) {
+                return lhs->hostStart < rhs->hostStart;
+             });
+
+   for (auto i = first; i < count; ++i) {
+      auto rip = sSamples[i & (SampleBufferSize - 1)];
+      auto itr = std::upper_bound(blocks.begin(), blocks.end(), rip,
+                                  [](uintptr_t rip, BlockProfile *profile) {
+                                     return rip < reinterpret_cast<uintptr_t>(profile->hostStart);
+                                  });
+
+      if (itr != blocks.begin()) {
+         auto profile = *(itr - 1);
+         auto hostStart = reinterpret_cast<uintptr_t>(profile->hostStart);
+
+         if (rip < hostStart + profile->hostSize) {
+            profile->samples++;
+         }
+      }
+   }
+
+   sSamplesTotal += count - first;
+   sSamplesProcessed = count;
+}
+
+void
+clearBlockProfiles()
+{
+   std::unique_lock<std::mutex> lock { sBlockProfilesMutex };
+   processSamples();
+
+   for (auto &profile : sBlockProfiles) {
+      if (profile.hostStart) {
+         sRetiredBlockProfiles.push_back(profile);
+      }
+   }
+
+   sBlockProfiles.clear();
+}
+
+} // namespace jit
+
+void
+setJitProfilingEnabled(bool enabled)
+{
+   if (jit::sProfilingEnabled.exchange(enabled) == enabled) {
+      return;
+   }
+
+   if (enabled) {
+      jit::startSampling();
+   } else {
+      jit::stopSampling();
+   }
+}
+
+JitProfile
+getJitProfile()
+{
+   std::unique_lock<std::mutex> lock { jit::sBlockProfilesMutex };
+   JitProfile result;
+   jit::processSamples();
+
+   auto addBlock =
+      [&](const jit::BlockProfile &profile) {
+         JitBlockProfile block;
+         block.address = profile.start;
+         block.instructions = (profile.end - profile.start) / 4;
+         block.hostStart = profile.hostStart;
+         block.hostSize = profile.hostSize;
+         block.entries = profile.entries;
+         block.samples = profile.samples;
+         result.blocks.push_back(block);
+      };
+
+   for (auto &profile : jit::sRetiredBlockProfiles) {
+      addBlock(profile);
+   }
+
+   for (auto &profile : jit::sBlockProfiles) {
+      if (profile.hostStart) {
+         addBlock(profile);
+      }
+   }
+
+   result.samples = jit::sSamplesTotal;
+   return result;
+}
+
+} // namespace cpu
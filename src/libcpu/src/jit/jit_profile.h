@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+struct BlockProfile
+{
+   //! Guest address range covered by the block
+   uint32_t start;
+   uint32_t end;
+
+   //! Host code generated for the block, null until the block is made
+   const void *hostStart = nullptr;
+   size_t hostSize = 0;
+
+   //! Incremented by the generated code every time the block is entered
+   uint64_t entries = 0;
+
+   //! Number of profiler samples which landed in the block's host code
+   uint64_t samples = 0;
+};
+
+bool
+isProfilingEnabled();
+
+BlockProfile *
+allocateBlockProfile(uint32_t start,
+                     uint32_t end);
+
+void
+setBlockProfileCode(BlockProfile *profile,
+                    const void *hostStart,
+                    size_t hostSize);
+
+void
+clearBlockProfiles();
+
+} // namespace jit
+
+} // namespace cpu
@@ -3,6 +3,7 @@
 #include "common/log.h"
 #include "cpu_internal.h"
 #include "espresso/espresso_spr.h"
+#include "jit_float.h"
 #include "jit_insreg.h"
 
 using espresso::SPR;
@@ -210,6 +211,34 @@ mtspr(PPCEmuAssembler& a, Instruction instr)
    return true;
 }
 
+static uint64_t
+mftb_stub()
+{
+   return cpu::this_core::state()->tb();
+}
+
+// Move from Time Base
+static bool
+mftb(PPCEmuAssembler& a, Instruction instr)
+{
+   auto tbr = decodeSPR(instr);
+   decaf_assert(tbr == SPR::UTBL || tbr == SPR::UTBU,
+                fmt::format("Invalid mftb TBR {}", static_cast<uint32_t>(tbr)));
+
+   // Reading the time base goes through the host clock, so we have to
+   //  call out, but there is no need to go through the interpreter.
+   a.evictAll();
+   a.call(asmjit::Ptr(&mftb_stub));
+
+   if (tbr == SPR::UTBU) {
+      a.shr(asmjit::x86::rax, 32);
+   }
+
+   auto dst = a.loadRegisterWrite(a.gpr[instr.rD]);
+   a.mov(dst, asmjit::x86::eax);
+   return true;
+}
+
 static Core *
 kc_stub(cpu::KernelCallFunction func, void *userData)
 {
@@ -227,8 +256,37 @@ kc(PPCEmuAssembler& a, Instruction instr)
    auto kc = cpu::getKernelCall(id);
    decaf_assert(kc, fmt::format("Encountered invalid Kernel Call ID {}", id));
 
+   // Exceptions the guest has raised so far belong in the FPSCR of the
+   //  current thread, which the call may switch away from.  Anything the
+   //  host raises during the call is cleared once it returns.
+   {
+      auto fpscr = a.loadRegisterReadWrite(a.fpscr);
+      syncFPSCRExceptions(a, fpscr);
+   }
+
+   // A call which can never reschedule keeps the same core and nia, so
+   //  we can call it directly and carry on without checking for an exit.
+   if (kc->flags & KCFLAG_NO_RESCHEDULE) {
+      if (kc->flags & KCFLAG_ARGUMENTS_ONLY) {
+         // Only spill what the call reads or writes, r1 is always read
+         //  for the backchain of the HLE call.
+         a.evictForCall(kc->gpr_reads | (1 << 1), kc->gpr_writes);
+      } else {
+         a.evictAll();
+         a.forgetKnownGprs();
+      }
+
+      a.mov(a.niaMem, a.genCia + 4);
+      a.mov(a.sysArgReg[0], a.stateReg);
+      a.mov(a.sysArgReg[1], asmjit::Ptr(kc->user_data));
+      a.call(asmjit::Ptr(kc->func));
+      clearHostFPExceptions(a);
+      return true;
+   }
+
    // Evict all stored register as a KC might read or modify them.
    a.evictAll();
+   a.forgetKnownGprs();
 
    // Save NIA back to memory in case KC reads/writes it
    a.mov(a.niaMem, a.genCia + 4);
@@ -238,6 +296,7 @@ kc(PPCEmuAssembler& a, Instruction instr)
    a.mov(a.sysArgReg[1], asmjit::Ptr(kc->user_data));
    a.call(asmjit::Ptr(&kc_stub));
    a.mov(a.stateReg, asmjit::x86::rax);
+   clearHostFPExceptions(a);
 
    // Check if the KC adjusted nia.  If it has, we need to return
    //  to the dispatcher.  Note that we assume the cache was already
@@ -272,7 +331,7 @@ registerSystemInstructions()
    RegisterInstruction(sync);
    RegisterInstruction(mfspr);
    RegisterInstruction(mtspr);
-   RegisterInstructionFallback(mftb);
+   RegisterInstruction(mftb);
    RegisterInstructionFallback(mfmsr);
    RegisterInstructionFallback(mtmsr);
    RegisterInstructionFallback(mfsr);
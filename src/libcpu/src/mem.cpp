@@ -39,6 +39,9 @@ gMemoryMap =
 static size_t
 gMemoryBase = 0;
 
+static bool
+gHugePagesEnabled = false;
+
 static bool
 tryMapMemory(size_t base);
 
@@ -77,12 +80,26 @@ tryMapMemory(size_t base)
             platform::freeMemory(base, 0x100000000ull);
             return false;
          }
+
+         if (gHugePagesEnabled && !platform::enableHugePages(map.address, size)) {
+            gLog->warn("Could not use huge pages for {}", map.name);
+         }
       }
    }
 
    return true;
 }
 
+/**
+ * Back the auto commit mappings with huge pages to reduce TLB misses, this
+ * must be set before initialise.
+ */
+void
+setHugePagesEnabled(bool enabled)
+{
+   gHugePagesEnabled = enabled;
+}
+
 /**
  * Initialise memory, mapping all valid address space
  */
@@ -216,4 +233,31 @@ uncommit(ppcaddr_t address,
    return true;
 }
 
+/**
+ * Returns how much host memory is resident for each mapping in gMemoryMap.
+ */
+std::vector<MappingUsage>
+getMappingUsage()
+{
+   auto usage = std::vector<MappingUsage> { };
+
+   for (auto &map : gMemoryMap) {
+      auto resident = size_t { 0 };
+
+      if (map.address) {
+         resident = platform::getResidentMemorySize(map.address, map.end - map.start);
+      }
+
+      usage.push_back({
+         map.name,
+         static_cast<ppcaddr_t>(map.start),
+         static_cast<ppcaddr_t>(map.end),
+         map.address != 0,
+         resident
+      });
+   }
+
+   return usage;
+}
+
 } // namespace mem
@@ -8,6 +8,7 @@
 #include "common/log.h"
 #include "common/debuglog.h"
 #include "common/decaf_assert.h"
+#include <cstring>
 
 using espresso::Instruction;
 using espresso::InstructionID;
@@ -15,15 +16,72 @@ using espresso::InstructionInfo;
 using espresso::InstructionField;
 using espresso::SPR;
 
-//#define TRACE_ENABLED
 //#define TRACE_SC_ENABLED
 //#define TRACE_VERIFICATION
 
+/*
+ * Traces are stored in a ring of variable length records rather than as an
+ * array of Trace structures, which needs a fraction of the memory:
+ *
+ *    uint8_t numReads, uint8_t numWrites, uint32_t instr, uint32_t cia
+ *    uint8_t writeFlags[(numWrites + 3) / 4], 2 bits per write
+ *    numReads x  { uint8_t type, value }
+ *    numWrites x { uint8_t type, [prevalue], [value] }
+ *
+ * Values are 8 bytes for FPRs and 4 bytes for everything else.  A write's
+ * previous value is left out when it is the same field as one of the
+ * instruction's reads, and its new value is left out when the instruction
+ * did not change it.
+ *
+ * Records are never split across the end of the ring, a record which does
+ * not fit is written to the start instead.  Positions are absolute so we
+ * can tell whether a record has since been overwritten.
+ */
+static const uint8_t
+TraceWriteFromRead = 1 << 0;
+
+static const uint8_t
+TraceWriteUnchanged = 1 << 1;
+
+static_assert(StateField::Max <= 0xFF, "StateField does not fit in a trace record");
+
+static const size_t
+TraceHeaderSize = 10;
+
+// Used to size the record offset ring from the data ring size
+static const size_t
+TraceAverageRecordSize = 16;
+
+// Large enough for a kc which writes every single field
+static const size_t
+TraceMinimumDataSize = 64 * 1024;
+
 struct Tracer
 {
-   size_t index;
-   size_t numTraces;
-   std::vector<Trace> traces;
+   //! Size of the record data ring in bytes, always a power of two
+   size_t dataSize = 0;
+
+   //! Maximum number of records we keep the offset of
+   size_t maxTraces = 0;
+
+   //! Record data, allocated on the first recorded instruction
+   std::vector<uint8_t> data;
+
+   //! Absolute position of each record in the data ring
+   std::vector<uint32_t> offsets;
+
+   //! Absolute position the next record will be written to
+   uint32_t writePos = 0;
+
+   //! Index in offsets the next record will use
+   size_t index = 0;
+
+   //! Number of records which are still in the data ring
+   size_t numTraces = 0;
+
+   //! The instruction currently being executed
+   Trace current;
+
    cpu::CoreRegs prevState;
 };
 
@@ -33,16 +91,16 @@ namespace cpu
 cpu::Tracer *
 allocTracer(size_t size)
 {
-   // TODO: TRACE_ENABLED should actually be handled by kernel
-#ifdef TRACE_ENABLED
+   auto dataSize = TraceMinimumDataSize;
+
+   while (dataSize < size) {
+      dataSize *= 2;
+   }
+
    auto tracer = new Tracer();
-   tracer->index = 0;
-   tracer->numTraces = 0;
-   tracer->traces.resize(size);
+   tracer->dataSize = dataSize;
+   tracer->maxTraces = dataSize / TraceAverageRecordSize;
    return tracer;
-#else
-   return nullptr;
-#endif
 }
 
 void
@@ -65,6 +123,200 @@ void setTracer(cpu::Tracer *tracer)
 
 } // namespace cpu
 
+static size_t
+getTraceFieldSize(TraceFieldType type)
+{
+   if (type >= StateField::FPR0 && type <= StateField::FPR31) {
+      return 8;
+   } else {
+      return 4;
+   }
+}
+
+static size_t
+getTraceRecordSize(const Trace &trace)
+{
+   auto size = TraceHeaderSize + (trace.writes.size() + 3) / 4;
+
+   for (auto &read : trace.reads) {
+      size += 1 + getTraceFieldSize(read.type);
+   }
+
+   for (auto &write : trace.writes) {
+      size += 1 + 2 * getTraceFieldSize(write.type);
+   }
+
+   return size;
+}
+
+static bool
+isSameTraceValue(const TraceFieldValue &a, const TraceFieldValue &b)
+{
+   return a.value.data[0] == b.value.data[0]
+       && a.value.data[1] == b.value.data[1];
+}
+
+static const Trace::_R *
+findTraceRead(const Trace &trace, TraceFieldType type)
+{
+   for (auto &read : trace.reads) {
+      if (read.type == type) {
+         return &read;
+      }
+   }
+
+   return nullptr;
+}
+
+static uint8_t *
+writeTraceBytes(uint8_t *out, const void *src, size_t size)
+{
+   std::memcpy(out, src, size);
+   return out + size;
+}
+
+static const uint8_t *
+readTraceBytes(const uint8_t *in, void *dst, size_t size)
+{
+   std::memcpy(dst, in, size);
+   return in + size;
+}
+
+static void
+encodeTrace(Tracer *tracer, const Trace &trace)
+{
+   if (tracer->data.empty()) {
+      tracer->data.resize(tracer->dataSize);
+      tracer->offsets.resize(tracer->maxTraces);
+   }
+
+   // Never split a record across the end of the ring
+   auto maxSize = getTraceRecordSize(trace);
+   auto pos = tracer->writePos;
+   auto offset = pos & (tracer->dataSize - 1);
+
+   if (offset + maxSize > tracer->dataSize) {
+      pos += static_cast<uint32_t>(tracer->dataSize - offset);
+      offset = 0;
+   }
+
+   auto start = tracer->data.data() + offset;
+   auto out = start;
+   auto numReads = static_cast<uint8_t>(trace.reads.size());
+   auto numWrites = static_cast<uint8_t>(trace.writes.size());
+   out = writeTraceBytes(out, &numReads, 1);
+   out = writeTraceBytes(out, &numWrites, 1);
+   out = writeTraceBytes(out, &trace.instr.value, 4);
+   out = writeTraceBytes(out, &trace.cia, 4);
+
+   auto writeFlags = out;
+   auto numWriteFlagBytes = (trace.writes.size() + 3) / 4;
+   std::memset(writeFlags, 0, numWriteFlagBytes);
+   out += numWriteFlagBytes;
+
+   for (auto &read : trace.reads) {
+      auto type = static_cast<uint8_t>(read.type);
+      out = writeTraceBytes(out, &type, 1);
+      out = writeTraceBytes(out, &read.value, getTraceFieldSize(read.type));
+   }
+
+   for (auto i = 0u; i < trace.writes.size(); ++i) {
+      auto &write = trace.writes[i];
+      auto fieldSize = getTraceFieldSize(write.type);
+      auto read = findTraceRead(trace, write.type);
+      auto type = static_cast<uint8_t>(write.type);
+      auto flags = uint8_t { 0 };
+
+      if (read && isSameTraceValue(read->value, write.prevalue)) {
+         flags |= TraceWriteFromRead;
+      }
+
+      if (isSameTraceValue(write.value, write.prevalue)) {
+         flags |= TraceWriteUnchanged;
+      }
+
+      writeFlags[i / 4] |= flags << ((i % 4) * 2);
+      out = writeTraceBytes(out, &type, 1);
+
+      if (!(flags & TraceWriteFromRead)) {
+         out = writeTraceBytes(out, &write.prevalue, fieldSize);
+      }
+
+      if (!(flags & TraceWriteUnchanged)) {
+         out = writeTraceBytes(out, &write.value, fieldSize);
+      }
+   }
+
+   tracer->writePos = pos + static_cast<uint32_t>(out - start);
+   tracer->offsets[tracer->index] = pos;
+   tracer->index = (tracer->index + 1) % tracer->maxTraces;
+
+   if (tracer->numTraces < tracer->maxTraces) {
+      tracer->numTraces++;
+   }
+
+   // Forget about any records which this one has overwritten
+   while (tracer->numTraces > 0) {
+      auto oldest = (tracer->index + tracer->maxTraces - tracer->numTraces) % tracer->maxTraces;
+
+      if (tracer->writePos - tracer->offsets[oldest] <= tracer->dataSize) {
+         break;
+      }
+
+      tracer->numTraces--;
+   }
+}
+
+static void
+decodeTrace(const Tracer *tracer, uint32_t pos, Trace &trace)
+{
+   auto in = tracer->data.data() + (pos & (tracer->dataSize - 1));
+   auto numReads = uint8_t { 0 };
+   auto numWrites = uint8_t { 0 };
+   in = readTraceBytes(in, &numReads, 1);
+   in = readTraceBytes(in, &numWrites, 1);
+   in = readTraceBytes(in, &trace.instr.value, 4);
+   in = readTraceBytes(in, &trace.cia, 4);
+
+   auto writeFlags = in;
+   in += (numWrites + 3) / 4;
+
+   trace.reads.resize(numReads);
+   trace.writes.resize(numWrites);
+
+   for (auto &read : trace.reads) {
+      auto type = uint8_t { 0 };
+      in = readTraceBytes(in, &type, 1);
+      read.type = type;
+      read.value.value = { 0, 0 };
+      in = readTraceBytes(in, &read.value, getTraceFieldSize(read.type));
+   }
+
+   for (auto i = 0u; i < trace.writes.size(); ++i) {
+      auto &write = trace.writes[i];
+      auto flags = (writeFlags[i / 4] >> ((i % 4) * 2)) & 3;
+      auto type = uint8_t { 0 };
+      in = readTraceBytes(in, &type, 1);
+      write.type = type;
+      write.prevalue.value = { 0, 0 };
+
+      auto fieldSize = getTraceFieldSize(write.type);
+
+      if (flags & TraceWriteFromRead) {
+         write.prevalue = findTraceRead(trace, write.type)->value;
+      } else {
+         in = readTraceBytes(in, &write.prevalue, fieldSize);
+      }
+
+      if (flags & TraceWriteUnchanged) {
+         write.value = write.prevalue;
+      } else {
+         write.value.value = { 0, 0 };
+         in = readTraceBytes(in, &write.value, fieldSize);
+      }
+   }
+}
+
 std::string
 getStateFieldName(TraceFieldType type)
 {
@@ -143,20 +395,16 @@ printInstruction(fmt::MemoryWriter &out, const Trace& trace, int index)
    }
 }
 
-const Trace&
+Trace
 getTrace(Tracer *tracer, int index)
 {
-   auto tracerSize = tracer->numTraces;
    decaf_check(index >= 0);
-   decaf_check(index < tracerSize);
-   auto realIndex = (int)tracer->index - 1 - index;
-   while (realIndex < 0) {
-      realIndex += (int)tracerSize;
-   }
-   while (realIndex >= tracerSize) {
-      realIndex -= (int)tracerSize;
-   }
-   return tracer->traces[realIndex];
+   decaf_check(static_cast<size_t>(index) < tracer->numTraces);
+
+   auto slot = (tracer->index + tracer->maxTraces - 1 - index) % tracer->maxTraces;
+   auto trace = Trace { };
+   decodeTrace(tracer, tracer->offsets[slot], trace);
+   return trace;
 }
 
 size_t
@@ -165,19 +413,6 @@ getTracerNumTraces(Tracer *tracer)
    return tracer->numTraces;
 }
 
-void
-traceInit(cpu::Core *state, size_t size)
-{
-#ifdef TRACE_ENABLED
-   state->tracer = new Tracer();
-   state->tracer->index = 0;
-   state->tracer->numTraces = 0;
-   state->tracer->traces.resize(size);
-#else
-   state->tracer = nullptr;
-#endif
-}
-
 static uint32_t
 getFieldStateField(Instruction instr, InstructionField field)
 {
@@ -354,14 +589,7 @@ traceInstructionStart(Instruction instr, InstructionInfo *data, cpu::Core *state
    }
 
    auto tracer = state->tracer;
-   auto &trace = tracer->traces[tracer->index];
-   auto tracerSize = tracer->traces.size();
-
-   if (tracer->numTraces < tracerSize) {
-      tracer->numTraces++;
-   }
-
-   tracer->index = (tracer->index + 1) % tracerSize;
+   auto &trace = tracer->current;
 
    // Setup Trace
    trace.instr = instr;
@@ -431,6 +659,12 @@ traceInstructionEnd(Trace *trace, Instruction instr, InstructionInfo *data, cpu:
 
    auto tracer = state->tracer;
 
+   // Tracing may have been disabled while the thread was blocked inside a kc,
+   //  in which case the trace no longer belongs to the core's tracer.
+   if (!tracer || trace != &tracer->current) {
+      return;
+   }
+
    // Special hack for KC for now
    if (data->id == InstructionID::kc) {
       trace->writes.clear();
@@ -453,6 +687,8 @@ traceInstructionEnd(Trace *trace, Instruction instr, InstructionInfo *data, cpu:
       saveStateField(state, i.type, i.value);
    }
 
+   encodeTrace(tracer, *trace);
+
 #ifdef TRACE_VERIFICATION
    if (tracer->numTraces > 0) {
       auto errors = std::vector<std::string> {};
@@ -499,7 +735,7 @@ tracePrint(cpu::Core *state, int start, int count)
    out.write("Trace - Print {} to {}\n", start, end);
 
    for (auto i = start; i < end; ++i) {
-      auto &trace = getTrace(tracer, i);
+      auto trace = getTrace(tracer, i);
       printInstruction(out, trace, i);
    }
 
@@ -520,7 +756,7 @@ traceReg(cpu::Core *state, int start, int regIdx)
    decaf_check(start < tracerSize);
 
    for (auto i = start; i < tracerSize; ++i) {
-      auto &trace = getTrace(tracer, i);
+      auto trace = getTrace(tracer, i);
 
       bool wasMatchedWrite = false;
       for (auto &j : trace.writes) {
@@ -573,7 +809,7 @@ traceRegNext(int regIdx)
    }
 
    auto tracer = gRegTraceState->tracer;
-   auto &trace = getTrace(tracer, foundIndex);
+   auto trace = getTrace(tracer, foundIndex);
 
    if (trace.reads.size() == 1) {
       if (trace.reads.front().type >= StateField::GPR0 && trace.reads.front().type <= StateField::GPR31) {
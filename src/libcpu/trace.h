@@ -137,17 +137,13 @@ struct Trace
    std::vector<_W> writes;
 };
 
-const Trace &
+Trace
 getTrace(Tracer *tracer,
          int index);
 
 size_t
 getTracerNumTraces(Tracer *tracer);
 
-void
-traceInit(cpu::Core *state,
-          size_t size);
-
 Trace *
 traceInstructionStart(espresso::Instruction instr,
                       espresso::InstructionInfo *data,
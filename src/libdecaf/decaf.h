@@ -36,6 +36,15 @@ waitForExit();
 void
 shutdown();
 
+bool
+writeSchedulerTrace(const std::string &path);
+
+bool
+writeJitProfile(const std::string &path);
+
+bool
+writeJitPerfMap();
+
 // Stuff for the debugger
 void
 injectMouseButtonInput(input::MouseButton button,
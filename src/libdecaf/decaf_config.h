@@ -18,6 +18,9 @@ extern bool enabled;
 //! Whether to break on entry point of game when debugger is enabled
 extern bool break_on_entry;
 
+//! Validate every active thread on each guest thread switch, this is slow
+extern bool scheduler_checks;
+
 } // namespace debugger
 
 namespace gpu
@@ -52,6 +55,9 @@ extern bool enabled;
 //! Use JIT in verification mode where it compares execution to interpreter
 extern bool verify;
 
+//! Count entries to every JIT block and sample where host time is spent
+extern bool profile;
+
 } // namespace jit
 
 namespace log
@@ -66,9 +72,16 @@ extern bool kernel_trace_res;
 //! Enable logging of every branch which targets a known symbol
 extern bool branch_trace;
 
+//! Record the most recent instructions executed by each thread, this only
+//!  works when running under the interpreter
+extern bool instruction_trace;
+
 //! Wildcard filters for kernel trace function name matching
 extern std::vector<std::string> kernel_trace_filters;
 
+//! Record guest thread switches, wakeups and blocking for a scheduler trace
+extern bool scheduler_trace;
+
 } // namespace log
 
 namespace sound
@@ -94,6 +107,13 @@ extern std::string content_path;
 //! Time scale factor for emulated clock
 extern double time_scale;
 
+//! Back guest memory with huge pages where the host supports them
+extern bool huge_pages;
+
+//! Replace recognised guest libc functions, found by symbol name, with
+//!  host implementations
+extern bool redirect_libc;
+
 } // namespace system
 
 } // namespace config
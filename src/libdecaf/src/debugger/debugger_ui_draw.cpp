@@ -251,6 +251,14 @@ draw()
             decaf::config::log::kernel_trace = !decaf::config::log::kernel_trace;
          }
 
+         if (ImGui::MenuItem("Instruction Trace Enabled", nullptr, decaf::config::log::instruction_trace, !decaf::config::jit::enabled)) {
+            decaf::config::log::instruction_trace = !decaf::config::log::instruction_trace;
+         }
+
+         if (ImGui::MenuItem("Scheduler Checks Enabled", nullptr, decaf::config::debugger::scheduler_checks, true)) {
+            decaf::config::debugger::scheduler_checks = !decaf::config::debugger::scheduler_checks;
+         }
+
          auto pm4Enable = false;
          auto pm4Status = false;
 
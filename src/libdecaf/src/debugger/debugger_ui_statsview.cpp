@@ -1,10 +1,14 @@
 #include "debugger_ui_internal.h"
+#include "gpu/gpu_memorytracker.h"
 #include "libcpu/cpu.h"
 #include "libcpu/espresso/espresso_instructionid.h"
 #include "libcpu/espresso/espresso_instructionset.h"
+#include "libcpu/mem.h"
+#include "modules/coreinit/coreinit_scheduler.h"
 #include <algorithm>
 #include <chrono>
 #include <cinttypes>
+#include <cmath>
 #include <imgui.h>
 #include <vector>
 
@@ -64,6 +68,97 @@ draw()
    ImGui::Text("IPS"); ImGui::NextColumn();
    ImGui::Separator();
 
+   ImGui::Text("GPU Bytes Hashed / Frame");
+   ImGui::NextColumn();
+   ImGui::Text("%" PRIu64, gpu::getBytesHashedLastFrame());
+   ImGui::NextColumn();
+   ImGui::NextColumn();
+
+   if (ImGui::TreeNode("Scheduler Lock Contention"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      static const char *lockOwnerNames[] = { "Core 0", "Core 1", "Core 2", "Host" };
+
+      for (auto i = 0u; i < 4; ++i) {
+         auto &lockStats = coreinit::internal::getSchedulerLockStats(i);
+         auto acquisitions = lockStats.acquisitions.load(std::memory_order_relaxed);
+         auto contended = lockStats.contended.load(std::memory_order_relaxed);
+
+         ImGui::Text("%s", lockOwnerNames[i]);
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64 " / %" PRIu64, contended, acquisitions);
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64 " spins", lockStats.spins.load(std::memory_order_relaxed));
+         ImGui::NextColumn();
+      }
+
+      ImGui::TreePop();
+   }
+
+   if (ImGui::TreeNode("Alarm Latency us"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      auto alarmStats = cpu::getAlarmLatencyStats();
+      auto count = static_cast<double>(std::max<uint64_t>(alarmStats.count, 1));
+      auto mean = alarmStats.total.count() / count;
+      auto jitter = std::sqrt(std::max(0.0, alarmStats.totalSquared / count - mean * mean));
+
+      ImGui::Text("Alarms Fired");
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, alarmStats.count);
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      ImGui::Text("Average");
+      ImGui::NextColumn();
+      ImGui::Text("%.1f", mean / 1000.0);
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      ImGui::Text("Max");
+      ImGui::NextColumn();
+      ImGui::Text("%.1f", alarmStats.max.count() / 1000.0);
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      ImGui::Text("Jitter");
+      ImGui::NextColumn();
+      ImGui::Text("%.1f", jitter / 1000.0);
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      ImGui::TreePop();
+   }
+
+   if (ImGui::TreeNode("Guest Memory Resident KB"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      for (auto &usage : mem::getMappingUsage()) {
+         ImGui::Text("%s", usage.name.c_str());
+         ImGui::NextColumn();
+
+         if (usage.committed) {
+            ImGui::Text("%zu", usage.resident / 1024);
+         } else {
+            ImGui::Text("uncommitted");
+         }
+
+         ImGui::NextColumn();
+         ImGui::NextColumn();
+      }
+
+      ImGui::TreePop();
+   }
+
    if (ImGui::TreeNode("JIT Fallback"))
    {
       ImGui::NextColumn();
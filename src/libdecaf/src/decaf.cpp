@@ -14,6 +14,7 @@
 #include "libcpu/cpu.h"
 #include "libcpu/mem.h"
 #include "modules/coreinit/coreinit_fs.h"
+#include "modules/coreinit/coreinit_internal_schedulertrace.h"
 #include "modules/coreinit/coreinit_scheduler.h"
 #include "modules/swkbd/swkbd_core.h"
 #include <condition_variable>
@@ -108,7 +109,14 @@ initialise(const std::string &gamePath)
       cpu::setJitMode(cpu::jit_mode::disabled);
    }
 
+   cpu::setJitProfilingEnabled(decaf::config::jit::enabled && decaf::config::jit::profile);
+
+   if (decaf::config::log::scheduler_trace) {
+      coreinit::internal::allocateSchedulerTrace();
+   }
+
    // Setup core
+   mem::setHugePagesEnabled(decaf::config::system::huge_pages);
    mem::initialise();
    cpu::initialise();
    kernel::initialise();
@@ -203,6 +211,9 @@ waitForExit()
    // Wait for CPU to finish
    cpu::join();
 
+   // Stop the profiler interrupting every thread until the process exits
+   cpu::setJitProfilingEnabled(false);
+
    // Make sure we clean up
    decaf::shutdown();
 
@@ -226,6 +237,9 @@ shutdown()
    // Wait for CPU to finish
    cpu::join();
 
+   // Stop the profiler interrupting every thread until the process exits
+   cpu::setJitProfilingEnabled(false);
+
    // Stop the FS
    coreinit::internal::shutdownFsThread();
 
@@ -248,6 +262,12 @@ shutdown()
    setSoundDriver(nullptr);
 }
 
+bool
+writeSchedulerTrace(const std::string &path)
+{
+   return coreinit::internal::writeSchedulerTrace(path);
+}
+
 void
 injectMouseButtonInput(input::MouseButton button,
                        input::MouseAction action)
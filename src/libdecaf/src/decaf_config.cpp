@@ -12,6 +12,7 @@ namespace debugger
 
 bool enabled = true;
 bool break_on_entry = false;
+bool scheduler_checks = false;
 
 } // namespace debugger
 
@@ -36,6 +37,7 @@ namespace jit
 
 bool enabled = true;
 bool verify = false;
+bool profile = false;
 
 } // namespace jit
 
@@ -45,6 +47,8 @@ namespace log
 bool kernel_trace = false;
 bool kernel_trace_res = false;
 bool branch_trace = false;
+bool instruction_trace = false;
+bool scheduler_trace = false;
 
 std::vector<std::string> kernel_trace_filters =
 {
@@ -75,6 +79,8 @@ int region = static_cast<int>(coreinit::SCIRegion::USA);
 std::string mlc_path = "mlc";
 std::string content_path = {};
 double time_scale = 1.0;
+bool huge_pages = false;
+bool redirect_libc = false;
 
 } // namespace system
 
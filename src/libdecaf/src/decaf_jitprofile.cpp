@@ -0,0 +1,96 @@
+#include "common/platform.h"
+#include "decaf.h"
+#include "kernel/kernel_loader.h"
+#include "libcpu/cpu.h"
+#include <spdlog/fmt/fmt.h>
+#include <algorithm>
+#include <fstream>
+
+#ifdef PLATFORM_POSIX
+#include <unistd.h>
+#endif
+
+namespace decaf
+{
+
+/**
+ * Write a report of the JIT blocks which were executed, sorted by the number
+ * of profiler samples taken in each block and then by how often they were
+ * entered.
+ */
+bool
+writeJitProfile(const std::string &path)
+{
+   std::ofstream out { path, std::ofstream::out | std::ofstream::trunc };
+   auto profile = cpu::getJitProfile();
+   auto totalEntries = uint64_t { 0 };
+
+   if (!out.is_open()) {
+      return false;
+   }
+
+   std::sort(profile.blocks.begin(), profile.blocks.end(),
+             [](const cpu::JitBlockProfile &lhs, const cpu::JitBlockProfile &rhs) {
+                if (lhs.samples != rhs.samples) {
+                   return lhs.samples > rhs.samples;
+                }
+
+                return lhs.entries > rhs.entries;
+             });
+
+   for (auto &block : profile.blocks) {
+      totalEntries += block.entries;
+   }
+
+   out << fmt::format("{} blocks, {} entries, {} samples\n\n", profile.blocks.size(), totalEntries, profile.samples);
+   out << fmt::format("{:>10} {:>7} {:>14} {:>10} {:>6}  {}\n", "samples", "%", "entries", "address", "insts", "symbol");
+
+   for (auto &block : profile.blocks) {
+      if (!block.samples && !block.entries) {
+         continue;
+      }
+
+      auto share = profile.samples ? (100.0 * block.samples) / profile.samples : 0.0;
+      out << fmt::format("{:>10} {:>6.2f}% {:>14} 0x{:08X} {:>6}  {}\n",
+                         block.samples,
+                         share,
+                         block.entries,
+                         block.address,
+                         block.instructions,
+                         kernel::loader::findNearestSymbolNameForAddress(block.address));
+   }
+
+   return true;
+}
+
+/**
+ * Write /tmp/perf-<pid>.map so Linux perf can symbolise samples taken in
+ * JIT code with the guest function each block was generated from.
+ */
+bool
+writeJitPerfMap()
+{
+#ifdef PLATFORM_POSIX
+   auto path = fmt::format("/tmp/perf-{}.map", getpid());
+   std::ofstream out { path, std::ofstream::out | std::ofstream::trunc };
+   auto profile = cpu::getJitProfile();
+
+   if (!out.is_open()) {
+      return false;
+   }
+
+   for (auto &block : profile.blocks) {
+      out << fmt::format("{:x} {:x} ppc:{:08X} {}\n",
+                         reinterpret_cast<uintptr_t>(block.hostStart),
+                         block.hostSize,
+                         block.address,
+                         kernel::loader::findNearestSymbolNameForAddress(block.address));
+   }
+
+   return true;
+#else
+   return false;
+#endif
+}
+
+} // namespace decaf
@@ -16,6 +16,12 @@ namespace glsl2
 
 static const auto IndentSize = 2u;
 
+// Rough number of bytes of GLSL we generate per byte of shader binary, used
+//  to size the output buffer up front so translation does not spend its time
+//  repeatedly growing it.
+static const auto CodeBytesPerBinaryByte = 16u;
+static const auto CodeBytesPerBinaryByteWithDisassembly = 32u;
+
 static std::map<latte::SQ_CF_INST, TranslateFuncCF>
 sInstructionMapCF;
 
@@ -48,10 +54,12 @@ translateTEX(State &state, const ControlFlowInst &cf)
    auto clauseTex = reinterpret_cast<const TextureFetchInst *>(state.binary.data() + 8 * addr);
    auto clauseVtx = reinterpret_cast<const VertexFetchInst *>(state.binary.data() + 8 * addr);
 
-   insertLineStart(state);
-   state.out.write("// {:02} ", state.cfPC);
-   latte::disassembler::disassembleCF(state.out, cf);
-   insertLineEnd(state);
+   if (state.shader->includeDisassembly) {
+      insertLineStart(state);
+      state.out.write("// {:02} ", state.cfPC);
+      latte::disassembler::disassembleCF(state.out, cf);
+      insertLineEnd(state);
+   }
 
    condStart(state, cf.word1.COND());
 
@@ -62,16 +70,18 @@ translateTEX(State &state, const ControlFlowInst &cf)
       auto name = getInstructionName(id);
 
       // Print disassembly
-      insertLineStart(state);
-      state.out.write("// {:02} ", state.groupPC);
+      if (state.shader->includeDisassembly) {
+         insertLineStart(state);
+         state.out.write("// {:02} ", state.groupPC);
 
-      if (id == SQ_TEX_INST_VTX_FETCH || id == SQ_TEX_INST_VTX_SEMANTIC) {
-         latte::disassembler::disassembleVtxInstruction(state.out, cf, vtx);
-      } else {
-         latte::disassembler::disassembleTexInstruction(state.out, cf, tex);
-      }
+         if (id == SQ_TEX_INST_VTX_FETCH || id == SQ_TEX_INST_VTX_SEMANTIC) {
+            latte::disassembler::disassembleVtxInstruction(state.out, cf, vtx);
+         } else {
+            latte::disassembler::disassembleTexInstruction(state.out, cf, tex);
+         }
 
-      insertLineEnd(state);
+         insertLineEnd(state);
+      }
 
       // Translate instruction
       if (id == SQ_TEX_INST_VTX_FETCH || id == SQ_TEX_INST_VTX_SEMANTIC) {
@@ -125,10 +135,12 @@ translateNormal(State &state, const ControlFlowInst &cf)
    } else {
       auto itr = sInstructionMapCF.find(id);
 
-      insertLineStart(state);
-      state.out.write("// {:02} ", state.cfPC);
-      latte::disassembler::disassembleCF(state.out, cf);
-      insertLineEnd(state);
+      if (state.shader->includeDisassembly) {
+         insertLineStart(state);
+         state.out.write("// {:02} ", state.cfPC);
+         latte::disassembler::disassembleCF(state.out, cf);
+         insertLineEnd(state);
+      }
 
       if (itr != sInstructionMapCF.end()) {
          itr->second(state, cf);
@@ -212,15 +224,17 @@ translateALUReduction(State &state, const ControlFlowInst &cf, AluGroup &group)
    }
 
    // Print disassembly
-   insertLineStart(state);
-   state.out.write("// {:02} Reduction", state.groupPC);
-   insertLineEnd(state);
-
-   for (auto i = 0u; i < reduction.size(); ++i) {
+   if (state.shader->includeDisassembly) {
       insertLineStart(state);
-      state.out.write("// ");
-      latte::disassembler::disassembleAluInstruction(state.out, cf, reduction[i], state.groupPC, static_cast<SQ_CHAN>(i), state.literals);
+      state.out.write("// {:02} Reduction", state.groupPC);
       insertLineEnd(state);
+
+      for (auto i = 0u; i < reduction.size(); ++i) {
+         insertLineStart(state);
+         state.out.write("// ");
+         latte::disassembler::disassembleAluInstruction(state.out, cf, reduction[i], state.groupPC, static_cast<SQ_CHAN>(i), state.literals);
+         insertLineEnd(state);
+      }
    }
 
    // Translate the instruction!
@@ -256,10 +270,12 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
    auto clause = reinterpret_cast<const AluInst *>(state.binary.data() + 8 * addr);
    auto didPushBefore = false;
 
-   insertLineStart(state);
-   state.out.write("// {:02} ", state.cfPC);
-   latte::disassembler::disassembleCfALUInstruction(state.out, cf);
-   insertLineEnd(state);
+   if (state.shader->includeDisassembly) {
+      insertLineStart(state);
+      state.out.write("// {:02} ", state.cfPC);
+      latte::disassembler::disassembleCfALUInstruction(state.out, cf);
+      insertLineEnd(state);
+   }
 
    switch (id) {
    case SQ_CF_INST_ALU_PUSH_BEFORE:
@@ -324,19 +340,23 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
             updatePreviousScalar = true;
          }
 
-         insertLineStart(state);
-         state.out.write("// {:02} ", state.groupPC);
-         latte::disassembler::disassembleAluInstruction(state.out, cf, inst, state.groupPC, state.unit, state.literals);
-         insertLineEnd(state);
+         if (state.shader->includeDisassembly) {
+            insertLineStart(state);
+            state.out.write("// {:02} ", state.groupPC);
+            latte::disassembler::disassembleAluInstruction(state.out, cf, inst, state.groupPC, state.unit, state.literals);
+            insertLineEnd(state);
+         }
 
          if (func) {
             func(state, cf, inst);
          }
       }
 
-      insertLineStart(state);
-      state.out.write("// {:02} --", state.groupPC);
-      insertLineEnd(state);
+      if (state.shader->includeDisassembly) {
+         insertLineStart(state);
+         state.out.write("// {:02} --", state.groupPC);
+         insertLineEnd(state);
+      }
 
       for (auto &write : state.postGroupWrites) {
          insertLineStart(state);
@@ -510,10 +530,12 @@ translateExport(State &state, const ControlFlowInst &cf)
    auto id = cf.exp.word1.CF_INST();
    auto itr = sInstructionMapEXP.find(id);
 
-   insertLineStart(state);
-   state.out.write("// {:02} ", state.cfPC);
-   latte::disassembler::disassembleExpInstruction(state.out, cf);
-   insertLineEnd(state);
+   if (state.shader->includeDisassembly) {
+      insertLineStart(state);
+      state.out.write("// {:02} ", state.cfPC);
+      latte::disassembler::disassembleExpInstruction(state.out, cf);
+      insertLineEnd(state);
+   }
 
    if (itr != sInstructionMapEXP.end()) {
       itr->second(state, cf);
@@ -727,6 +749,12 @@ translate(Shader &shader, const gsl::span<const uint8_t> &binary)
    state.shader->samplerUsage.fill(SamplerUsage::Invalid);
    initialise();
 
+   if (shader.includeDisassembly) {
+      state.out.buffer().reserve(binary.size() * CodeBytesPerBinaryByteWithDisassembly);
+   } else {
+      state.out.buffer().reserve(binary.size() * CodeBytesPerBinaryByte);
+   }
+
    try {
       for (auto i = 0; i < binary.size(); i += sizeof(ControlFlowInst)) {
          auto cf = *reinterpret_cast<const ControlFlowInst *>(binary.data() + i);
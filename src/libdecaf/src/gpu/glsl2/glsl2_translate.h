@@ -61,6 +61,7 @@ struct Shader
    std::array<latte::SQ_TEX_DIM, 16> samplerDim;
    bool uniformRegistersEnabled = false;
    bool uniformBlocksEnabled = false;
+   bool includeDisassembly = false;
 
    // Output (maybe)
    std::string fileHeader;
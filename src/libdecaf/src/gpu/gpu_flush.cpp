@@ -1,5 +1,7 @@
 #include "decaf_graphics.h"
 #include "gpu_flush.h"
+#include "gpu_memorytracker.h"
+#include "libcpu/mem.h"
 #include "pm4_capture.h"
 
 namespace gpu
@@ -10,6 +12,7 @@ notifyCpuFlush(void *ptr,
                uint32_t size)
 {
    pm4::captureCpuFlush(ptr, size);
+   markMemoryWritten(mem::untranslate(ptr), size);
    decaf::getGraphicsDriver()->notifyCpuFlush(ptr, size);
 }
 
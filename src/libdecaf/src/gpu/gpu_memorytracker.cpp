@@ -0,0 +1,141 @@
+#include "common/crc32c.h"
+#include "gpu_memorytracker.h"
+#include "libcpu/mem.h"
+#include <algorithm>
+#include <atomic>
+
+namespace gpu
+{
+
+static const auto PageShift = 12u;
+static const auto PageSize = 1u << PageShift;
+static const auto PageCount = 1u << (32 - PageShift);
+
+// Generation of the most recent write to each page of guest memory.  This
+//  lives in zero-initialised storage, so only pages which have ever been
+//  written take up host memory.
+static std::atomic<uint64_t>
+sPageGenerations[PageCount];
+
+// Source of write generations, 64 bits so it never wraps around to a value
+//  which a TrackedMemory may have already recorded.
+static std::atomic<uint64_t>
+sWriteGeneration { 0 };
+
+static std::atomic<uint64_t>
+sBytesHashed { 0 };
+
+static std::atomic<uint64_t>
+sBytesHashedLastFrame { 0 };
+
+
+/**
+ * Record that a range of guest memory has been written, either by the CPU
+ * or by the host on behalf of the GPU or DMA engine.
+ *
+ * Must be called after the memory has been written.  May be called from any
+ * thread.
+ */
+void
+markMemoryWritten(uint32_t address,
+                  uint32_t size)
+{
+   if (!size) {
+      return;
+   }
+
+   // Each call takes a generation which has never been stored to any page
+   //  before, so a checker can never mistake this write for one it has
+   //  already seen.  The release stores make the written memory visible to
+   //  a checker which observes the new generation.
+   auto generation = sWriteGeneration.fetch_add(1, std::memory_order_relaxed) + 1;
+   auto firstPage = address >> PageShift;
+   auto lastPage = static_cast<uint32_t>((static_cast<uint64_t>(address) + size - 1) >> PageShift);
+
+   for (auto page = firstPage; page <= std::min(lastPage, PageCount - 1); ++page) {
+      sPageGenerations[page].store(generation, std::memory_order_release);
+   }
+}
+
+
+/**
+ * Check whether a range of guest memory has changed since the last time it
+ * was checked with the same TrackedMemory.
+ *
+ * A TrackedMemory which has never been checked, or which was last checked
+ * against a different range, always reports a change.
+ */
+bool
+checkMemoryChanged(TrackedMemory &tracked,
+                   uint32_t address,
+                   uint32_t size)
+{
+   auto firstPage = address >> PageShift;
+   auto lastPage = static_cast<uint32_t>((static_cast<uint64_t>(address) + std::max(size, 1u) - 1) >> PageShift);
+   auto pageCount = lastPage - firstPage + 1;
+   auto fullCheck = tracked.pageHashes.size() != pageCount
+                 || tracked.address != address
+                 || tracked.size != size;
+   auto changed = fullCheck;
+   auto bytesHashed = uint64_t { 0 };
+
+   if (fullCheck) {
+      tracked.address = address;
+      tracked.size = size;
+      tracked.pageGenerations.assign(pageCount, 0);
+      tracked.pageHashes.assign(pageCount, 0);
+   }
+
+   for (auto i = 0u; i < pageCount; ++i) {
+      auto page = firstPage + i;
+
+      // The generation is read before the page is hashed, so a write which
+      //  races with the hash leaves a newer generation behind and the page
+      //  is hashed again on the next check.
+      auto generation = sPageGenerations[page].load(std::memory_order_acquire);
+
+      if (!fullCheck && generation == tracked.pageGenerations[i]) {
+         continue;
+      }
+
+      auto start = std::max(address, page << PageShift);
+      auto end = std::min(static_cast<uint64_t>(address) + size,
+                          static_cast<uint64_t>(page) * PageSize + PageSize);
+      auto hash = crc32c_x2_64(mem::translate(start), static_cast<size_t>(end - start));
+
+      if (hash != tracked.pageHashes[i]) {
+         tracked.pageHashes[i] = hash;
+         changed = true;
+      }
+
+      tracked.pageGenerations[i] = generation;
+      bytesHashed += end - start;
+   }
+
+   sBytesHashed += bytesHashed;
+   return changed;
+}
+
+
+/**
+ * Called by the graphics driver at the end of each frame to roll over the
+ * bytes hashed counter.
+ */
+void
+endMemoryTrackingFrame()
+{
+   sBytesHashedLastFrame.store(sBytesHashed.exchange(0));
+}
+
+
+/**
+ * Number of bytes of guest memory hashed for change detection during the
+ * previous frame.
+ */
+uint64_t
+getBytesHashedLastFrame()
+{
+   return sBytesHashedLastFrame.load();
+}
+
+} // namespace gpu
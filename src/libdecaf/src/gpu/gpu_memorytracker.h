@@ -0,0 +1,47 @@
+#pragma once
+#include "common/types.h"
+#include <vector>
+
+namespace gpu
+{
+
+/*
+ * Tracks whether a range of guest memory has changed since it was last
+ * checked.
+ *
+ * Every write to guest memory, whether it is a CPU flush or a write made by
+ * the host on behalf of the GPU or DMA engine, stamps the pages it covers
+ * with a new write generation.  Checking a range only hashes the pages whose
+ * generation differs from the one recorded at the last check.
+ */
+struct TrackedMemory
+{
+   //! Start of the memory range covered by pageHashes
+   uint32_t address = 0;
+
+   //! Size of the memory range covered by pageHashes
+   uint32_t size = 0;
+
+   //! Write generation of each page of the range at the time of the last check
+   std::vector<uint64_t> pageGenerations;
+
+   //! Hash of each page of the range at the time of the last check
+   std::vector<uint64_t> pageHashes;
+};
+
+void
+markMemoryWritten(uint32_t address,
+                  uint32_t size);
+
+bool
+checkMemoryChanged(TrackedMemory &tracked,
+                   uint32_t address,
+                   uint32_t size);
+
+void
+endMemoryTrackingFrame();
+
+uint64_t
+getBytesHashedLastFrame();
+
+} // namespace gpu
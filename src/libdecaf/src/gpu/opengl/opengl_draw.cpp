@@ -1,5 +1,6 @@
 #ifndef DECAF_NOGL
 
+#include "common/byte_swap_copy.h"
 #include "common/decaf_assert.h"
 #include "decaf_config.h"
 #include "opengl_driver.h"
@@ -14,6 +15,8 @@ namespace opengl
 
 bool GLDriver::checkReadyDraw()
 {
+   applyDirtyRegisters();
+
    if (!checkActiveShader()) {
       gLog->warn("Skipping draw with invalid shader.");
       return false;
@@ -282,9 +285,7 @@ GLDriver::drawPrimitivesIndexed(const void *buffer,
          decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", vgt_dma_index_type.INDEX_TYPE()));
       }
 
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
+      byte_swap_copy_16(indices.data(), src, count);
 
       drawPrimitives(count,
                      indices.data(),
@@ -297,9 +298,7 @@ GLDriver::drawPrimitivesIndexed(const void *buffer,
          decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", vgt_dma_index_type.INDEX_TYPE()));
       }
 
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
+      byte_swap_copy_32(indices.data(), src, count);
 
       drawPrimitives(count,
                      indices.data(),
@@ -347,6 +346,9 @@ GLDriver::decafClearColor(const pm4::DecafClearColor &data)
       data.alpha
    };
 
+   // Clears are affected by state such as rasterizer discard
+   applyDirtyRegisters();
+
    // Find our colorbuffer to clear
    auto buffer = getColorBuffer(data.cb_color_base, data.cb_color_size, data.cb_color_info, true);
 
@@ -381,6 +383,9 @@ GLDriver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
                    || dbFormat == latte::DB_FORMAT::DEPTH_8_24_FLOAT
                    || dbFormat == latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT);
 
+   // Clears are affected by state such as rasterizer discard
+   applyDirtyRegisters();
+
    // Find our depthbuffer to clear
    auto buffer = getDepthBuffer(data.db_depth_base, data.db_depth_size, data.db_depth_info, true);
 
@@ -401,9 +406,7 @@ GLDriver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
    }
 
    // Clear depth buffer
-   auto db_depth_control = getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
-
-   if (!db_depth_control.Z_WRITE_ENABLE()) {
+   if (!mGLStateCache.depthWrite) {
       gl::glDepthMask(gl::GL_TRUE);
    }
 
@@ -418,7 +421,7 @@ GLDriver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
 
    gl::glEnable(gl::GL_SCISSOR_TEST);
 
-   if (!db_depth_control.Z_WRITE_ENABLE()) {
+   if (!mGLStateCache.depthWrite) {
       gl::glDepthMask(gl::GL_FALSE);
    }
 }
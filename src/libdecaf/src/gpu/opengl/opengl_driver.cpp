@@ -26,19 +26,19 @@ namespace opengl
 GLDriver::GLDriver()
 {
    mRegisters.fill(0);
+   mDirtyContextRegisters.fill(0);
 }
 
 void
 GLDriver::initGL()
 {
-   // Apply all registers
-   for (auto i = 0u; i < mRegisters.size(); ++i) {
-      applyRegister(static_cast<latte::Register>(i * 4));
-   }
+   // Apply all registers on the first draw
+   mDirtyContextRegisters.fill(~0ull);
 
    mActiveShader = nullptr;
    mDrawBuffers.fill(gl::GL_NONE);
    mGLStateCache.blendEnable.fill(false);
+   mGLStateCache.blendControl.fill(0xFFFFFFFFu);
    mLastUniformUpdate.fill(0);
 
    // We always use the scissor test
@@ -76,6 +76,39 @@ GLDriver::initGL()
    gl::GLint value;
    gl::glGetIntegerv(gl::GL_MAX_UNIFORM_BLOCK_SIZE, &value);
    MaxUniformBlockSize = value;
+
+   // Create our texture upload staging buffer
+   auto uploadFlags = gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT;
+   gl::glCreateBuffers(1, &mUploadBuffer);
+   gl::glNamedBufferStorage(mUploadBuffer, UploadRingSize, nullptr, uploadFlags);
+   mUploadBufferMap = static_cast<uint8_t *>(gl::glMapNamedBufferRange(mUploadBuffer, 0, UploadRingSize, uploadFlags));
+
+   if (decaf::config::gpu::debug) {
+      gl::glObjectLabel(gl::GL_BUFFER, mUploadBuffer, -1, "texture upload ring");
+   }
+}
+
+void
+GLDriver::shutdownGL()
+{
+   // Release the texture upload staging buffer
+   while (!mUploadRingFences.empty()) {
+      gl::glDeleteSync(mUploadRingFences.front().fence);
+      mUploadRingFences.pop();
+   }
+
+   if (mUploadBuffer) {
+      gl::glUnmapNamedBuffer(mUploadBuffer);
+      gl::glDeleteBuffers(1, &mUploadBuffer);
+      mUploadBuffer = 0;
+      mUploadBufferMap = nullptr;
+   }
+
+   // Release the framebuffers created in initGL
+   gl::glDeleteFramebuffers(2, mBlitFrameBuffers);
+   gl::glDeleteFramebuffers(1, &mFrameBuffer);
+   gl::glDeleteFramebuffers(1, &mColorClearFrameBuffer);
+   gl::glDeleteFramebuffers(1, &mDepthClearFrameBuffer);
 }
 
 void
@@ -161,6 +194,8 @@ GLDriver::decafSwapBuffers(const pm4::DecafSwapBuffers &data)
 {
    static const auto weight = 0.9;
 
+   endMemoryTrackingFrame();
+
    injectFence([=]() {
       // TODO: We should have a render chain of 2 buffers so that we don't render stuff
       //  until the game actually asked us to.
@@ -349,7 +384,7 @@ GLDriver::surfaceSync(const pm4::SurfaceSync &data)
 
    if (surfaces) {
       for (auto &i : mSurfaces) {
-         SurfaceBuffer *surface = &i.second;
+         SurfaceBuffer *surface = i.second.get();
 
          if (surface->cpuMemStart < memEnd && surface->cpuMemEnd > memStart) {
             surface->needUpload |= surface->dirtyMemory;
@@ -453,8 +488,10 @@ GLDriver::memWrite(const pm4::MemWrite &data)
 
       if (data.addrHi.DATA32()) {
          *reinterpret_cast<uint32_t *>(addr) = static_cast<uint32_t>(value);
+         markMemoryWritten(data.addrLo.ADDR_LO() << 2, 4);
       } else {
          *reinterpret_cast<uint64_t *>(addr) = value;
+         markMemoryWritten(data.addrLo.ADDR_LO() << 2, 8);
       }
    });
 }
@@ -483,6 +520,7 @@ GLDriver::eventWrite(const pm4::EventWrite &data)
       }
 
       *reinterpret_cast<uint64_t *>(ptr) = value;
+      markMemoryWritten(addr, 8);
    };
 
    switch (type) {
@@ -556,10 +594,12 @@ GLDriver::eventWriteEOP(const pm4::EventWriteEOP &data)
          break;
       case pm4::EWP_DATA_32:
          *reinterpret_cast<uint32_t *>(ptr) = static_cast<uint32_t>(value);
+         markMemoryWritten(addr, 4);
          break;
       case pm4::EWP_DATA_64:
       case pm4::EWP_DATA_CLOCK:
          *reinterpret_cast<uint64_t *>(ptr) = value;
+         markMemoryWritten(addr, 8);
          break;
       }
    });
@@ -583,9 +623,34 @@ GLDriver::injectFence(std::function<void()> func)
    mSyncWaits.emplace(wait);
 }
 
+/**
+ * Release the upload ring space of every staged upload the GPU has finished
+ * with.  Unlike checkSyncObjects() this never runs any other callbacks, so it
+ * is safe to call while GL state is being set up for a draw.
+ */
+void
+GLDriver::reclaimUploadRing()
+{
+   while (!mUploadRingFences.empty()) {
+      auto &wait = mUploadRingFences.front();
+      gl::GLenum value;
+      gl::glGetSynciv(wait.fence, gl::GL_SYNC_STATUS, 4, nullptr, reinterpret_cast<gl::GLint*>(&value));
+
+      if (value == gl::GL_UNSIGNALED) {
+         break;
+      }
+
+      mUploadRing.release(wait.allocation);
+      gl::glDeleteSync(wait.fence);
+      mUploadRingFences.pop();
+   }
+}
+
 void
 GLDriver::checkSyncObjects()
 {
+   reclaimUploadRing();
+
    while (true) {
       if (!mSyncWaits.size()) {
          break;
@@ -695,7 +760,7 @@ GLDriver::notifyCpuFlush(void *ptr,
    }
 
    for (auto &i : mSurfaces) {
-      auto resource = &i.second;
+      auto resource = i.second.get();
 
       if (resource->cpuMemStart < memEnd && resource->cpuMemEnd > memStart) {
          resource->dirtyMemory = true;
@@ -778,6 +843,8 @@ GLDriver::run()
          checkSyncObjects();
       }
    }
+
+   shutdownGL();
 }
 
 void
@@ -2,9 +2,12 @@
 
 #ifndef DECAF_NOGL
 
+#include "common/flathashmap.h"
 #include "common/log.h"
 #include "common/platform.h"
+#include "common/ringallocator.h"
 #include "gpu/glsl2/glsl2_translate.h"
+#include "gpu/gpu_memorytracker.h"
 #include "gpu/latte_constants.h"
 #include "gpu/latte_contextstate.h"
 #include "gpu/pm4_buffer.h"
@@ -18,6 +21,7 @@
 #include <gsl.h>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -45,8 +49,8 @@ struct Resource
    //! The end of the CPU memory region this occupies
    uint32_t cpuMemEnd;
 
-   //! Hash of the memory contents, for detecting changes
-   uint64_t cpuMemHash[2] = { 0, 0 };
+   //! Tracks changes to the memory contents
+   TrackedMemory cpuMemTracking;
 
    //! True if a DCFlush has been received for the memory region
    bool dirtyMemory = true;
@@ -87,7 +91,6 @@ struct FetchShader : public Shader
    gl::GLuint object = 0;
    std::vector<Attrib> attribs;
    std::array<AttribBufferCache, latte::MaxAttributes> mAttribBufferCache;
-   std::string disassembly;
 };
 
 struct VertexShader : public Shader
@@ -102,7 +105,6 @@ struct VertexShader : public Shader
    std::array<bool, 4> usedFeedbackBuffers;
    uint32_t lastUniformUpdate = 0;
    std::string code;
-   std::string disassembly;
 };
 
 struct PixelShader : public Shader
@@ -115,11 +117,20 @@ struct PixelShader : public Shader
    std::array<bool, 16> usedUniformBlocks;
    uint32_t lastUniformUpdate = 0;
    std::string code;
-   std::string disassembly;
 };
 
 using ShaderPipelineKey = std::tuple<uint64_t, uint64_t, uint64_t>;
 
+struct ShaderPipelineKeyHash
+{
+   uint64_t operator()(const ShaderPipelineKey &key) const
+   {
+      auto hash = flatHashMix64(std::get<0>(key));
+      hash = flatHashMix64(hash ^ std::get<1>(key));
+      return flatHashMix64(hash ^ std::get<2>(key));
+   }
+};
+
 struct ShaderPipeline
 {
    gl::GLuint object = 0;
@@ -207,6 +218,12 @@ struct SyncWait
    std::function<void()> func;
 };
 
+struct UploadRingFence
+{
+   gl::GLsync fence;
+   RingAllocator::Allocation allocation;
+};
+
 struct ColorBufferCache
 {
    gl::GLuint object = 0;
@@ -257,6 +274,8 @@ struct SamplerCache
 struct GLStateCache
 {
    std::array<bool, latte::MaxRenderTargets> blendEnable;
+   std::array<uint32_t, latte::MaxRenderTargets> blendControl;
+   std::array<float, 4> blendColor = { 0.0f, 0.0f, 0.0f, 0.0f };
 
    bool cullFaceEnable = false;
    gl::GLenum cullFace = gl::GL_BACK;
@@ -325,6 +344,7 @@ public:
 
 private:
    void initGL();
+   void shutdownGL();
    void executeBuffer(pm4::Buffer *buffer);
    uint64_t getGpuClock();
 
@@ -467,6 +487,9 @@ private:
    void
    applyRegister(latte::Register reg);
 
+   void
+   applyDirtyRegisters();
+
    int
    countModifiedUniforms(latte::Register firstReg,
                          uint32_t lastUniformUpdate);
@@ -495,6 +518,9 @@ private:
    void
    checkSyncObjects();
 
+   void
+   reclaimUploadRing();
+
    void
    runCommandBuffer(uint32_t *buffer,
                     uint32_t size);
@@ -522,6 +548,10 @@ private:
    }
 
 private:
+   static const size_t UploadRingSize = 32 * 1024 * 1024;
+   static const size_t UploadRingAlignment = 256;
+   static const size_t NumContextRegisters = (latte::Register::ContextRegisterEnd - latte::Register::ContextRegisterBase) / 4;
+
    enum class RunState
    {
       None,
@@ -541,11 +571,11 @@ private:
    // Protects resource lists; used by notifyCpuFlush() to safely set dirty flags
    std::mutex mResourceMutex;
 
-   std::unordered_map<uint64_t, FetchShader *> mFetchShaders;  // Protected by mResourceMutex
-   std::unordered_map<uint64_t, VertexShader *> mVertexShaders;  // Protected by mResourceMutex
-   std::unordered_map<uint64_t, PixelShader *> mPixelShaders;  // Protected by mResourceMutex
-   std::map<ShaderPipelineKey, ShaderPipeline> mShaderPipelines;  // Not touched by notifyCpuFlush()
-   std::unordered_map<uint64_t, SurfaceBuffer> mSurfaces;  // Protected by mResourceMutex
+   FlatHashMap<uint64_t, FetchShader *> mFetchShaders;  // Protected by mResourceMutex
+   FlatHashMap<uint64_t, VertexShader *> mVertexShaders;  // Protected by mResourceMutex
+   FlatHashMap<uint64_t, PixelShader *> mPixelShaders;  // Protected by mResourceMutex
+   FlatHashMap<ShaderPipelineKey, std::unique_ptr<ShaderPipeline>, ShaderPipelineKeyHash> mShaderPipelines;  // Not touched by notifyCpuFlush()
+   FlatHashMap<uint64_t, std::unique_ptr<SurfaceBuffer>> mSurfaces;  // Protected by mResourceMutex
    std::unordered_map<uint32_t, DataBuffer> mDataBuffers;  // Protected by mResourceMutex
 
    std::array<Sampler, latte::MaxSamplers> mVertexSamplers;
@@ -563,6 +593,16 @@ private:
 
    std::queue<SyncWait> mSyncWaits;
 
+   // Persistently mapped staging buffer used to upload texture data, ranges
+   //  of it are released by a fence once the GPU has consumed them
+   gl::GLuint mUploadBuffer = 0;
+   uint8_t *mUploadBufferMap = nullptr;
+   RingAllocator mUploadRing { UploadRingSize, UploadRingAlignment };
+
+   // Kept apart from mSyncWaits so reclaiming ring space never runs the
+   //  callbacks of other fences in the middle of setting up a draw
+   std::queue<UploadRingFence> mUploadRingFences;
+
    gl::GLuint mFeedbackQuery = 0;
    bool mFeedbackActive = false;
    gl::GLenum mFeedbackPrimitive;
@@ -599,6 +639,9 @@ private:
 #endif
 
    std::array<uint32_t, 0x10000> mRegisters;
+
+   // One bit per context register which has changed since the last draw
+   std::array<uint64_t, NumContextRegisters / 64> mDirtyContextRegisters;
 };
 
 } // namespace opengl
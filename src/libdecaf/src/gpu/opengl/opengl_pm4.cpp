@@ -1,5 +1,6 @@
 #ifndef DECAF_NOGL
 
+#include "common/byte_swap_copy.h"
 #include "opengl_driver.h"
 #include "gpu/pm4_reader.h"
 
@@ -21,10 +22,7 @@ GLDriver::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
 {
    std::vector<uint32_t> swapped;
    swapped.resize(buffer_size);
-
-   for (auto i = 0u; i < buffer_size; ++i) {
-      swapped[i] = byte_swap(buffer[i]);
-   }
+   byte_swap_copy_32(swapped.data(), buffer, buffer_size);
 
    buffer = swapped.data();
 
@@ -78,10 +76,13 @@ GLDriver::handlePacketType0(pm4::type0::Header header, const gsl::span<uint32_t>
 {
    auto base = header.baseIndex();
 
+   if (base + data.size() > mRegisters.size()) {
+      gLog->error("Dropping type 0 packet which writes past the last register, base = 0x{:04X}, count = {}", base, data.size());
+      return;
+   }
+
    for (auto i = 0; i < data.size(); ++i) {
-      auto index = base + i;
-      // Set mRegisters[base + i];
-      gLog->info("Type0 set register 0x{:08X} = 0x{:08X}", index, data[i]);
+      setRegister(static_cast<latte::Register>((base + i) * 4), data[i]);
    }
 }
 
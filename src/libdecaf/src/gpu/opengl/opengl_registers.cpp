@@ -1,5 +1,6 @@
 #ifndef DECAF_NOGL
 
+#include "common/bitutils.h"
 #include "common/decaf_assert.h"
 #include "opengl_driver.h"
 #include <glbinding/gl/gl.h>
@@ -41,9 +42,29 @@ GLDriver::setRegister(latte::Register reg,
       }
    }
 
-   // Apply changes directly to OpenGL state if appropriate
-   if (isChanged) {
-      applyRegister(reg);
+   // Games tend to re-emit whole blocks of context state before every draw,
+   //  so rather than touching OpenGL state on every write we only remember
+   //  which registers changed and apply them at the next draw.
+   if (isChanged
+    && reg >= latte::Register::ContextRegisterBase
+    && reg < latte::Register::ContextRegisterEnd) {
+      auto index = (reg - latte::Register::ContextRegisterBase) / 4;
+      mDirtyContextRegisters[index / 64] |= 1ull << (index % 64);
+   }
+}
+
+void
+GLDriver::applyDirtyRegisters()
+{
+   for (auto i = 0u; i < mDirtyContextRegisters.size(); ++i) {
+      auto bits = mDirtyContextRegisters[i];
+      auto bit = 0ul;
+      mDirtyContextRegisters[i] = 0;
+
+      while (bit_scan_forward(&bit, bits)) {
+         bits = clear_bit(bits, bit);
+         applyRegister(static_cast<latte::Register>(latte::Register::ContextRegisterBase + (i * 64 + bit) * 4));
+      }
    }
 }
 
@@ -64,6 +85,12 @@ GLDriver::applyRegister(latte::Register reg)
    {
       auto target = (reg - latte::Register::CB_BLEND0_CONTROL) / 4;
       auto cb_blend_control = latte::CB_BLENDN_CONTROL::get(value);
+
+      if (mGLStateCache.blendControl[target] == cb_blend_control.value) {
+         break;
+      }
+
+      mGLStateCache.blendControl[target] = cb_blend_control.value;
       auto dstRGB = getBlendFunc(cb_blend_control.COLOR_DESTBLEND());
       auto srcRGB = getBlendFunc(cb_blend_control.COLOR_SRCBLEND());
       auto modeRGB = getBlendEquation(cb_blend_control.COLOR_COMB_FCN());
@@ -219,10 +246,17 @@ GLDriver::applyRegister(latte::Register reg)
       auto cb_blend_blue = getRegister<latte::CB_BLEND_BLUE>(latte::Register::CB_BLEND_BLUE);
       auto cb_blend_alpha = getRegister<latte::CB_BLEND_ALPHA>(latte::Register::CB_BLEND_ALPHA);
 
-      gl::glBlendColor(cb_blend_red.BLEND_RED(),
-                       cb_blend_green.BLEND_GREEN(),
-                       cb_blend_blue.BLEND_BLUE(),
-                       cb_blend_alpha.BLEND_ALPHA());
+      auto blendColor = std::array<float, 4> {
+         cb_blend_red.BLEND_RED(),
+         cb_blend_green.BLEND_GREEN(),
+         cb_blend_blue.BLEND_BLUE(),
+         cb_blend_alpha.BLEND_ALPHA()
+      };
+
+      if (mGLStateCache.blendColor != blendColor) {
+         mGLStateCache.blendColor = blendColor;
+         gl::glBlendColor(blendColor[0], blendColor[1], blendColor[2], blendColor[3]);
+      }
    } break;
 
    case latte::Register::PA_CL_VPORT_XSCALE_0:
@@ -2,7 +2,6 @@
 
 #include "common/decaf_assert.h"
 #include "common/log.h"
-#include "common/murmur3.h"
 #include "common/platform_dir.h"
 #include "common/strutils.h"
 #include "decaf_config.h"
@@ -37,6 +36,21 @@ static const auto BUFFER_PADDING = 16;
 static const auto NVIDIA_GLSL_WORKAROUND = true;
 
 
+// Disassembly is only needed for debugging, so we only generate it when
+//  somebody could actually look at it.
+static bool
+isShaderDisassemblyEnabled()
+{
+   return decaf::config::gpu::debug || decaf::config::gx2::dump_shaders;
+}
+
+static std::string
+getShaderDisassembly(const Shader &shader, bool isSubroutine = false)
+{
+   auto size = shader.cpuMemEnd - shader.cpuMemStart;
+   return latte::disassemble(gsl::as_span(mem::translate<uint8_t>(shader.cpuMemStart), size), isSubroutine);
+}
+
 static void
 dumpRawShader(const std::string &type, ppcaddr_t data, uint32_t size, bool isSubroutine = false)
 {
@@ -127,7 +141,7 @@ deleteShaderObject(PixelShader *shader)
 template <typename ShaderPtrType> static bool
 invalidateShaderIfChanged_locked(ShaderPtrType &shader,
                                  uint64_t shaderKey,
-                                 std::unordered_map<uint64_t, ShaderPtrType> &shaders)
+                                 FlatHashMap<uint64_t, ShaderPtrType> &shaders)
 {
    if (!shader || !shader->needRebuild) {
       return false;
@@ -135,12 +149,7 @@ invalidateShaderIfChanged_locked(ShaderPtrType &shader,
 
    // Check whether the shader has actually changed; we want to avoid
    //  recompiling shaders if possible, since that's very slow.
-   //  Note that we don't save this, which means we have to compute it
-   //  twice if we end up recreating the shader, but that cost is tiny
-   //  compared to the time it takes to actually create the shader.
-   uint64_t newHash[2] = { 0, 0 };
-   MurmurHash3_x64_128(mem::translate(shader->cpuMemStart), shader->cpuMemEnd - shader->cpuMemStart, 0, newHash);
-   if (newHash[0] == shader->cpuMemHash[0] && newHash[1] == shader->cpuMemHash[1]) {
+   if (!checkMemoryChanged(shader->cpuMemTracking, shader->cpuMemStart, shader->cpuMemEnd - shader->cpuMemStart)) {
       shader->needRebuild = false;
       return false;
    }
@@ -254,7 +263,13 @@ bool GLDriver::checkActiveShader()
    }
 
    auto shaderKey = ShaderPipelineKey { fsShaderKey, vsShaderKey, psShaderKey };
-   auto &pipeline = mShaderPipelines[shaderKey];
+   auto &pipelinePtr = mShaderPipelines[shaderKey];
+
+   if (!pipelinePtr) {
+      pipelinePtr.reset(new ShaderPipeline {});
+   }
+
+   auto &pipeline = *pipelinePtr;
 
    // If the pipeline already exists, check whether any of its component
    //  shaders need to be rebuilt
@@ -294,13 +309,12 @@ bool GLDriver::checkActiveShader()
          fetchShader = new FetchShader {};
          fetchShader->cpuMemStart = fsPgmAddress;
          fetchShader->cpuMemEnd = fsPgmAddress + fsPgmSize;
-         MurmurHash3_x64_128(mem::translate(fetchShader->cpuMemStart),
-                             fetchShader->cpuMemEnd - fetchShader->cpuMemStart,
-                             0, fetchShader->cpuMemHash);
+         checkMemoryChanged(fetchShader->cpuMemTracking,
+                            fetchShader->cpuMemStart,
+                            fetchShader->cpuMemEnd - fetchShader->cpuMemStart);
          fetchShader->dirtyMemory = false;
 
          dumpRawShader("fetch", fsPgmAddress, fsPgmSize, true);
-         fetchShader->disassembly = latte::disassemble(gsl::as_span(mem::translate<uint8_t>(fsPgmAddress), fsPgmSize), true);
 
          if (!parseFetchShader(*fetchShader, make_virtual_ptr<void>(fsPgmAddress), fsPgmSize)) {
             gLog->error("Failed to parse fetch shader");
@@ -372,9 +386,9 @@ bool GLDriver::checkActiveShader()
 
          vertexShader->cpuMemStart = vsPgmAddress;
          vertexShader->cpuMemEnd = vsPgmAddress + vsPgmSize;
-         MurmurHash3_x64_128(mem::translate(vertexShader->cpuMemStart),
-                             vertexShader->cpuMemEnd - vertexShader->cpuMemStart,
-                             0, vertexShader->cpuMemHash);
+         checkMemoryChanged(vertexShader->cpuMemTracking,
+                            vertexShader->cpuMemStart,
+                            vertexShader->cpuMemEnd - vertexShader->cpuMemStart);
          vertexShader->dirtyMemory = false;
 
          dumpRawShader("vertex", vsPgmAddress, vsPgmSize);
@@ -401,8 +415,8 @@ bool GLDriver::checkActiveShader()
          if (!isLinked) {
             auto log = getProgramLog(vertexShader->object);
             gLog->error("OpenGL failed to compile vertex shader:\n{}", log);
-            gLog->error("Fetch Disassembly:\n{}\n", fetchShader->disassembly);
-            gLog->error("Shader Disassembly:\n{}\n", vertexShader->disassembly);
+            gLog->error("Fetch Disassembly:\n{}\n", getShaderDisassembly(*fetchShader, true));
+            gLog->error("Shader Disassembly:\n{}\n", getShaderDisassembly(*vertexShader));
             gLog->error("Shader Code:\n{}\n", vertexShader->code);
             return false;
          }
@@ -440,9 +454,9 @@ bool GLDriver::checkActiveShader()
 
             pixelShader->cpuMemStart = psPgmAddress;
             pixelShader->cpuMemEnd = psPgmAddress + psPgmSize;
-            MurmurHash3_x64_128(mem::translate(pixelShader->cpuMemStart),
-                                pixelShader->cpuMemEnd - pixelShader->cpuMemStart,
-                                0, pixelShader->cpuMemHash);
+            checkMemoryChanged(pixelShader->cpuMemTracking,
+                               pixelShader->cpuMemStart,
+                               pixelShader->cpuMemEnd - pixelShader->cpuMemStart);
             pixelShader->dirtyMemory = false;
 
             dumpRawShader("pixel", psPgmAddress, psPgmSize);
@@ -470,7 +484,7 @@ bool GLDriver::checkActiveShader()
             if (!isLinked) {
                auto log = getProgramLog(pixelShader->object);
                gLog->error("OpenGL failed to compile pixel shader:\n{}", log);
-               gLog->error("Shader Disassembly:\n{}\n", pixelShader->disassembly);
+               gLog->error("Shader Disassembly:\n{}\n", getShaderDisassembly(*pixelShader));
                gLog->error("Shader Code:\n{}\n", pixelShader->code);
                return false;
             }
@@ -768,6 +782,8 @@ GLDriver::downloadDataBuffer(DataBuffer *buffer,
       gl::glGetNamedBufferSubData(buffer->object, offset, size,
                                   mem::translate<char>(buffer->cpuMemStart) + offset);
    }
+
+   markMemoryWritten(buffer->cpuMemStart + offset, size);
 }
 
 void
@@ -776,13 +792,7 @@ GLDriver::uploadDataBuffer(DataBuffer *buffer,
                            uint32_t size)
 {
    // Avoid uploading the data if it hasn't changed.
-   uint64_t newHash[2] = { 0, 0 };
-   MurmurHash3_x64_128(mem::translate(buffer->cpuMemStart), buffer->allocatedSize, 0, newHash);
-
-   if (newHash[0] != buffer->cpuMemHash[0] || newHash[1] != buffer->cpuMemHash[1]) {
-      buffer->cpuMemHash[0] = newHash[0];
-      buffer->cpuMemHash[1] = newHash[1];
-
+   if (checkMemoryChanged(buffer->cpuMemTracking, buffer->cpuMemStart, buffer->allocatedSize)) {
       // We currently can't detect where the change occurred, so upload
       //  the entire buffer.  If we don't do this, the following sequence
       //  will result in incorrect GPU-side data:
@@ -983,10 +993,10 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
       shader.uniformBlocksEnabled = true;
    }
 
-   vertex.disassembly = latte::disassemble(gsl::as_span(buffer, size));
+   shader.includeDisassembly = isShaderDisassemblyEnabled();
 
    if (!glsl2::translate(shader, gsl::as_span(buffer, size))) {
-      gLog->error("Failed to decode vertex shader\n{}", vertex.disassembly);
+      gLog->error("Failed to decode vertex shader\n{}", latte::disassemble(gsl::as_span(buffer, size)));
       return false;
    }
 
@@ -1151,7 +1161,7 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
          auto val = name;
 
          if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
-            val = "bswap32(" + val + ")";
+            val = fmt::format("bswap32({})", val);
          } else if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
             decaf_abort("Unexpected 8IN16 swap for 10_10_10_2");
          } else if (attrib->endianSwap == latte::SQ_ENDIAN::NONE) {
@@ -1161,24 +1171,24 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
          }
 
          if (attrib->format == latte::SQ_DATA_FORMAT::FMT_10_10_10_2) {
-            chanVal[0] = std::string("((") + val + std::string(" >> 22) & 0x3ff)");
-            chanVal[1] = std::string("((") + val + std::string(" >> 12) & 0x3ff)");
-            chanVal[2] = std::string("((") + val + std::string(" >> 2) & 0x3ff)");
-            chanVal[3] = std::string("((") + val + std::string(" >> 0) & 0x3)");
+            chanVal[0] = fmt::format("(({} >> 22) & 0x3ff)", val);
+            chanVal[1] = fmt::format("(({} >> 12) & 0x3ff)", val);
+            chanVal[2] = fmt::format("(({} >> 2) & 0x3ff)", val);
+            chanVal[3] = fmt::format("(({} >> 0) & 0x3)", val);
          } else if (attrib->format == latte::SQ_DATA_FORMAT::FMT_2_10_10_10) {
-            chanVal[3] = std::string("((") + val + std::string(" >> 30) & 0x3)");
-            chanVal[2] = std::string("((") + val + std::string(" >> 20) & 0x3ff)");
-            chanVal[1] = std::string("((") + val + std::string(" >> 10) & 0x3ff)");
-            chanVal[0] = std::string("((") + val + std::string(" >> 0) & 0x3ff)");
+            chanVal[3] = fmt::format("(({} >> 30) & 0x3)", val);
+            chanVal[2] = fmt::format("(({} >> 20) & 0x3ff)", val);
+            chanVal[1] = fmt::format("(({} >> 10) & 0x3ff)", val);
+            chanVal[0] = fmt::format("(({} >> 0) & 0x3ff)", val);
          } else {
             decaf_abort("Unexpected format");
          }
 
          if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
-            chanVal[0] = "int(signext10(" + chanVal[0] + "))";
-            chanVal[1] = "int(signext10(" + chanVal[1] + "))";
-            chanVal[2] = "int(signext10(" + chanVal[2] + "))";
-            chanVal[3] = "int(" + chanVal[3] + ")";
+            chanVal[0] = fmt::format("int(signext10({}))", chanVal[0]);
+            chanVal[1] = fmt::format("int(signext10({}))", chanVal[1]);
+            chanVal[2] = fmt::format("int(signext10({}))", chanVal[2]);
+            chanVal[3] = fmt::format("int({})", chanVal[3]);
          } else {
             // Good to go!
          }
@@ -1200,26 +1210,26 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
                // Nothing to do except select the appropriate component.
 
                if (channels > 1) {
-                  val = val + "." + ChannelSelNorm[ch];
+                  val = fmt::format("{}.{}", val, ChannelSelNorm[ch]);
                }
             } else {
                if (compBits == 32) {
                   if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
                      if (channels > 1) {
-                        val = val + "." + ChannelSelNorm[ch];
+                        val = fmt::format("{}.{}", val, ChannelSelNorm[ch]);
                      }
 
-                     val = "bswap32(" + val + ")";
+                     val = fmt::format("bswap32({})", val);
                   } else {
                      decaf_abort("Unexpected endian swap mode for 32-bit components");
                   }
                } else if (compBits == 16) {
                   if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
                      if (channels > 1) {
-                        val = val + "." + ChannelSelNorm[ch];
+                        val = fmt::format("{}.{}", val, ChannelSelNorm[ch]);
                      }
 
-                     val = "bswap16(" + val + ")";
+                     val = fmt::format("bswap16({})", val);
                   } else {
                      decaf_abort("Unexpected endian swap mode for 16-bit components");
                   }
@@ -1229,10 +1239,10 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
 
                   if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
                      decaf_check(channels == 2 || channels == 4);
-                     val = val + "." + ChannelSel8In16[ch];
+                     val = fmt::format("{}.{}", val, ChannelSel8In16[ch]);
                   } else if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
                      decaf_check(channels == 4);
-                     val = val + "." + ChannelSel8In32[ch];
+                     val = fmt::format("{}.{}", val, ChannelSel8In32[ch]);
                   } else {
                      decaf_abort("Unexpected endian swap mode for 8-bit components");
                   }
@@ -1243,20 +1253,20 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
 
             if (isFloat) {
                if (compBits == 32) {
-                  val = "uintBitsToFloat(" + val + ")";
+                  val = fmt::format("uintBitsToFloat({})", val);
                } else if (compBits == 16) {
-                  val = "unpackHalf2x16(" + val + ").x";
+                  val = fmt::format("unpackHalf2x16({}).x", val);
                } else {
                   decaf_abort("Unexpected float component bit count");
                }
             } else {
                if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
                   if (compBits == 8) {
-                     val = "int(signext8(" + val + "))";
+                     val = fmt::format("int(signext8({}))", val);
                   } else if (compBits == 16) {
-                     val = "int(signext16(" + val + "))";
+                     val = fmt::format("int(signext16({}))", val);
                   } else if (compBits == 32) {
-                     val = "int(" + val + ")";
+                     val = fmt::format("int({})", val);
                   } else {
                      decaf_abort("Unexpected signed component bit count");
                   }
@@ -1280,12 +1290,12 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
             }
          } else if (attrib->numFormat == latte::SQ_NUM_FORMAT::INT) {
             if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
-               chanVal[ch] = "intBitsToFloat(int(" + chanVal[ch] + "))";
+               chanVal[ch] = fmt::format("intBitsToFloat(int({}))", chanVal[ch]);
             } else {
-               chanVal[ch] = "uintBitsToFloat(uint(" + chanVal[ch] + "))";
+               chanVal[ch] = fmt::format("uintBitsToFloat(uint({}))", chanVal[ch]);
             }
          } else if (attrib->numFormat == latte::SQ_NUM_FORMAT::SCALED) {
-            chanVal[ch] = "float(" + chanVal[ch] + ")";
+            chanVal[ch] = fmt::format("float({})", chanVal[ch]);
          } else {
             decaf_abort("Unexpected attribute number format");
          }
@@ -1375,8 +1385,12 @@ bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uin
    }
 
    out << "}\n";
-   out << "/* VERTEX SHADER DISASSEMBLY\n" << vertex.disassembly << "\n*/\n";
-   out << "/* FETCH SHADER DISASSEMBLY\n" << fetch.disassembly << "\n*/\n";
+
+   if (shader.includeDisassembly) {
+      out << "/* VERTEX SHADER DISASSEMBLY\n" << latte::disassemble(gsl::as_span(buffer, size)) << "\n*/\n";
+      out << "/* FETCH SHADER DISASSEMBLY\n" << getShaderDisassembly(fetch, true) << "\n*/\n";
+   }
+
    vertex.code = out.str();
    return true;
 }
@@ -1409,10 +1423,10 @@ bool GLDriver::compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint
       shader.uniformBlocksEnabled = true;
    }
 
-   pixel.disassembly = latte::disassemble(gsl::as_span(buffer, size));
+   shader.includeDisassembly = isShaderDisassemblyEnabled();
 
    if (!glsl2::translate(shader, gsl::as_span(buffer, size))) {
-      gLog->error("Failed to decode pixel shader\n{}", pixel.disassembly);
+      gLog->error("Failed to decode pixel shader\n{}", latte::disassemble(gsl::as_span(buffer, size)));
       return false;
    }
 
@@ -1637,7 +1651,9 @@ bool GLDriver::compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint
 
    out << "}\n";
 
-   out << "/* PIXEL SHADER DISASSEMBLY\n" << pixel.disassembly << "\n*/\n";
+   if (shader.includeDisassembly) {
+      out << "/* PIXEL SHADER DISASSEMBLY\n" << latte::disassemble(gsl::as_span(buffer, size)) << "\n*/\n";
+   }
 
    pixel.code = out.str();
    return true;
@@ -159,6 +159,7 @@ GLDriver::streamOutBufferUpdate(const pm4::StreamOutBufferUpdate &data)
 
          auto offsetPtr = mem::translate<uint32_t>(addr);
          *offsetPtr = byte_swap(mFeedbackBufferState[bufferIndex].currentOffset >> 2);
+         markMemoryWritten(addr, 4);
       }
    }
 
@@ -1,7 +1,6 @@
 #ifndef DECAF_NOGL
 
 #include "common/decaf_assert.h"
-#include "common/murmur3.h"
 #include "decaf_config.h"
 #include "gpu/gpu_tiling.h"
 #include "gpu/gpu_utilities.h"
@@ -558,24 +557,37 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
    auto srcImageSize = srcPitch * srcHeight * uploadDepth * bpp / 8;
    auto dstImageSize = srcWidth * srcHeight * uploadDepth * bpp / 8;
 
-   // Calculate a new memory CRC
-   uint64_t newHash[2] = { 0 };
-   MurmurHash3_x64_128(imagePtr, srcImageSize, 0, newHash);
-
    // If the CPU memory has changed, we should re-upload this.  This hashing is
    //  also means that if the application temporarily uses one of its buffers as
    //  a color buffer, we are able to accurately handle this.  Providing they are
    //  not updating the memory at the same time.
-   if (newHash[0] != buffer->cpuMemHash[0] || newHash[1] != buffer->cpuMemHash[1]) {
-      buffer->cpuMemHash[0] = newHash[0];
-      buffer->cpuMemHash[1] = newHash[1];
+   if (checkMemoryChanged(buffer->cpuMemTracking, baseAddress, srcImageSize)) {
+      // Untile straight into the upload ring if there is space, otherwise
+      //  fall back to uploading from client memory
+      std::vector<uint8_t> untiledImage;
+      RingAllocator::Allocation staging;
+      uint8_t *untiledPtr = nullptr;
+      const void *uploadData = nullptr;
+      auto useStaging = mUploadBufferMap && mUploadRing.allocate(dstImageSize, staging);
+
+      if (!useStaging && mUploadBufferMap) {
+         // Reclaim any space the GPU has finished with and try again
+         reclaimUploadRing();
+         useStaging = mUploadRing.allocate(dstImageSize, staging);
+      }
 
-      std::vector<uint8_t> untiledImage, untiledMipmap;
-      untiledImage.resize(dstImageSize);
+      if (useStaging) {
+         untiledPtr = mUploadBufferMap + staging.offset;
+         uploadData = reinterpret_cast<const void *>(staging.offset);
+      } else {
+         untiledImage.resize(dstImageSize);
+         untiledPtr = untiledImage.data();
+         uploadData = untiledPtr;
+      }
 
       // Untile
       gpu::convertFromTiled(
-         untiledImage.data(),
+         untiledPtr,
          uploadPitch,
          imagePtr,
          tileMode,
@@ -594,7 +606,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
       auto target = getGlTarget(dim);
       auto textureDataType = gl::GL_INVALID_ENUM;
       auto textureFormat = getGlFormat(format);
-      auto size = untiledImage.size();
+      auto size = dstImageSize;
 
       if (compressed) {
          textureDataType = getGlCompressedDataType(format, formatComp, degamma);
@@ -606,6 +618,10 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
          decaf_abort(fmt::format("Texture with unsupported format {}", format));
       }
 
+      if (useStaging) {
+         gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, mUploadBuffer);
+      }
+
       switch (dim) {
       case latte::SQ_TEX_DIM::DIM_1D:
          if (compressed) {
@@ -615,7 +631,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width,
                textureDataType,
                gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
+               uploadData);
          } else {
             gl::glTextureSubImage1D(buffer->active->object,
                0, /* level */
@@ -623,7 +639,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width,
                textureFormat,
                textureDataType,
-               untiledImage.data());
+               uploadData);
          }
          break;
       case latte::SQ_TEX_DIM::DIM_2D:
@@ -635,7 +651,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                height,
                textureDataType,
                gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
+               uploadData);
          } else {
             gl::glTextureSubImage2D(buffer->active->object,
                0, /* level */
@@ -643,7 +659,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height,
                textureFormat,
                textureDataType,
-               untiledImage.data());
+               uploadData);
          }
          break;
       case latte::SQ_TEX_DIM::DIM_3D:
@@ -654,7 +670,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height, depth,
                textureDataType,
                gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
+               uploadData);
          } else {
             gl::glTextureSubImage3D(buffer->active->object,
                0, /* level */
@@ -662,7 +678,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height, depth,
                textureFormat,
                textureDataType,
-               untiledImage.data());
+               uploadData);
          }
          break;
       case latte::SQ_TEX_DIM::DIM_CUBEMAP:
@@ -675,7 +691,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height, uploadDepth,
                textureDataType,
                gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
+               uploadData);
          } else {
             gl::glTextureSubImage3D(buffer->active->object,
                0, /* level */
@@ -683,12 +699,22 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height, uploadDepth,
                textureFormat,
                textureDataType,
-               untiledImage.data());
+               uploadData);
          }
          break;
       default:
          decaf_abort(fmt::format("Unsupported texture dim: {}", dim));
       }
+
+      if (useStaging) {
+         gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, 0);
+
+         // Give the staging memory back to the ring once the upload is done
+         UploadRingFence wait;
+         wait.fence = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::GL_NONE_BIT);
+         wait.allocation = staging;
+         mUploadRingFences.emplace(wait);
+      }
    }
 }
 
@@ -752,7 +778,13 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
    }
 
    std::unique_lock<std::mutex> lock(mResourceMutex);
-   auto &buffer = mSurfaces[surfaceKey];
+   auto &bufferPtr = mSurfaces[surfaceKey];
+
+   if (!bufferPtr) {
+      bufferPtr.reset(new SurfaceBuffer {});
+   }
+
+   auto &buffer = *bufferPtr;
    lock.unlock();
 
    if (buffer.active &&
@@ -11,6 +11,7 @@
 #include "pm4_writer.h"
 #include <array>
 #include <common/byte_swap.h>
+#include <common/byte_swap_copy.h>
 #include <common/log.h>
 #include <common/platform_dir.h>
 #include <common/murmur3.h>
@@ -266,9 +267,7 @@ private:
       std::vector<uint32_t> swapped;
       swapped.resize(numWords);
 
-      for (auto i = 0u; i < swapped.size(); ++i) {
-         swapped[i] = byte_swap(words[i]);
-      }
+      byte_swap_copy_32(swapped.data(), words, numWords);
 
       auto buffer = swapped.data();
       auto bufferSize = swapped.size();
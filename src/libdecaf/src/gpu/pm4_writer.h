@@ -4,6 +4,7 @@
 #include "pm4_packets.h"
 #include "latte_registers.h"
 #include "virtual_ptr.h"
+#include <common/byte_swap_copy.h>
 #include <common/decaf_assert.h>
 #include <common/log.h>
 #include <gsl.h>
@@ -138,9 +139,7 @@ public:
       std::memcpy(&mBuffer->buffer[mBuffer->curSize], values.data(), dataSize * sizeof(uint32_t));
 
       // We do the byte_swap here separately as Type may not be uint32_t sized
-      for (auto i = 0u; i < dataSize; ++i) {
-         mBuffer->buffer[mBuffer->curSize + i] = byte_swap(mBuffer->buffer[mBuffer->curSize + i]);
-      }
+      byte_swap_copy_32(&mBuffer->buffer[mBuffer->curSize], &mBuffer->buffer[mBuffer->curSize], dataSize);
 
       mBuffer->curSize += dataSize;
       return *this;
@@ -1,3 +1,4 @@
+#include "decaf_config.h"
 #include "kernel.h"
 #include <algorithm>
 #include <cfenv>
@@ -29,10 +30,16 @@ sIdleFiber[3];
 static coreinit::OSContext
 sIdleContext[3];
 
+// Size of the instruction trace buffer for each thread when tracing is on
+static const size_t
+TracerSize = 2 * 1024 * 1024;
+
 struct Fiber
 {
    platform::Fiber *handle = nullptr;
    coreinit::OSContext *context = nullptr;
+
+   //! Only allocated once instruction tracing is enabled
    cpu::Tracer *tracer = nullptr;
 };
 
@@ -136,7 +143,17 @@ wakeCurrentContext()
       core->cia = context->cia;
 
       // Some things to help us when debugging...
-      cpu::this_core::setTracer(context->fiber->tracer);
+      auto fiber = context->fiber;
+      auto tracing = decaf::config::log::instruction_trace
+                  && !decaf::config::jit::enabled;
+
+      if (tracing && !fiber->tracer) {
+         fiber->tracer = cpu::allocTracer(TracerSize);
+      }
+
+      // A fiber keeps its tracer once allocated, so only install it while
+      //  tracing is enabled or we would keep tracing after it is turned off.
+      cpu::this_core::setTracer(tracing ? fiber->tracer : nullptr);
    } else {
       // Restore the idle context information stored earlier
       restoreContext(&sIdleContext[core->id]);
@@ -189,7 +206,6 @@ static Fiber *
 allocateFiber(coreinit::OSContext *context)
 {
    auto fiber = new Fiber();
-   fiber->tracer = cpu::allocTracer(1024 * 10 * 10);
    fiber->handle = platform::createFiber(fiberEntryPoint, nullptr);
    fiber->context = context;
    return fiber;
@@ -35,6 +35,9 @@ gHleModules;
 static std::map<uint32_t, HleFunction*>
 gHleFuncs;
 
+static std::map<std::string, HleFunction*>
+gHleGuestRedirects;
+
 static void
 kcstub(cpu::Core *state, void *data)
 {
@@ -70,8 +73,16 @@ kcstub(cpu::Core *state, void *data)
 void
 registerHleFunc(HleFunction *func)
 {
-   func->syscallID = cpu::registerKernelCall({ kcstub, func });
+   auto entry = cpu::KernelCallEntry { kcstub, func };
+   entry.flags = func->kcFlags;
+   entry.gpr_reads = func->gprReads;
+   entry.gpr_writes = func->gprWrites;
+   func->syscallID = cpu::registerKernelCall(entry);
    gHleFuncs[func->syscallID] = func;
+
+   if (!func->guestRedirect.empty()) {
+      gHleGuestRedirects.emplace(func->guestRedirect, func);
+   }
 }
 
 uint32_t
@@ -86,6 +97,18 @@ registerUnimplementedHleFunc(const std::string &module, const std::string &name)
    return ppcFn->syscallID;
 }
 
+HleFunction *
+findHleGuestRedirect(const std::string &name)
+{
+   auto itr = gHleGuestRedirects.find(name);
+
+   if (itr == gHleGuestRedirects.end()) {
+      return nullptr;
+   } else {
+      return itr->second;
+   }
+}
+
 HleModule *
 findHleModule(const std::string &name)
 {
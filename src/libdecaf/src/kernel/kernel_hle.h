@@ -6,6 +6,7 @@ namespace kernel
 {
 
 class HleModule;
+struct HleFunction;
 
 void
 initialiseHleMmodules();
@@ -16,4 +17,7 @@ findHleModule(const std::string &name);
 uint32_t
 registerUnimplementedHleFunc(const std::string &module, const std::string &name);
 
+HleFunction *
+findHleGuestRedirect(const std::string &name);
+
 } // namespace kernel
@@ -2,6 +2,7 @@
 #include "common/type_list.h"
 #include "decaf_config.h"
 #include "kernel_hlesymbol.h"
+#include "libcpu/cpu.h"
 #include "libcpu/state.h"
 #include "ppcutils/ppcinvoke.h"
 #include <cstdint>
@@ -23,6 +24,14 @@ struct HleFunction : HleSymbol
    bool traceEnabled = true;
    uint32_t syscallID = 0;
    uint32_t vaddr = 0;
+
+   // Name of the guest functions this replaces when loading an RPL, if any
+   std::string guestRedirect;
+
+   // Passed on to the kernel call, see the KCFLAG_* flags in libcpu/cpu.h
+   uint32_t kcFlags = 0;
+   uint32_t gprReads = 0xFFFFFFFF;
+   uint32_t gprWrites = 0xFFFFFFFF;
 };
 
 namespace functions
@@ -112,8 +121,98 @@ struct HleDestructorFunctionImpl : HleFunction
    }
 };
 
+inline uint32_t
+gprBit(size_t r)
+{
+   // Arguments after r10 are passed on the stack
+   return r <= 10 ? (1u << r) : 0;
+}
+
+// Adds the GPRs used for an argument, returns false if it is passed in an FPR
+template<typename Type>
+inline bool
+addArgumentGprs(uint32_t &mask, size_t &r)
+{
+   using converter = ppctypes::ppctype_converter_t<Type>;
+
+   if (converter::ppc_type == ppctypes::PpcType::DWORD) {
+      r = ppctypes::alignRegister64(r);
+      mask |= gprBit(r++);
+      mask |= gprBit(r++);
+      return true;
+   } else if (converter::ppc_type == ppctypes::PpcType::WORD) {
+      mask |= gprBit(r++);
+      return true;
+   }
+
+   return false;
+}
+
+template<typename ReturnType>
+struct ResultGprs
+{
+   static bool get(uint32_t &mask)
+   {
+      using converter = ppctypes::ppctype_converter_t<ReturnType>;
+
+      if (converter::ppc_type == ppctypes::PpcType::DWORD) {
+         mask = gprBit(3) | gprBit(4);
+         return true;
+      } else if (converter::ppc_type == ppctypes::PpcType::WORD) {
+         mask = gprBit(3);
+         return true;
+      }
+
+      return false;
+   }
+};
+
+template<>
+struct ResultGprs<void>
+{
+   static bool get(uint32_t &mask)
+   {
+      mask = 0;
+      return true;
+   }
+};
+
 } // namespace functions
 
+/**
+ * Declare what an HLE function may do so the JIT can call it more cheaply.
+ *
+ * For KCFLAG_ARGUMENTS_ONLY the GPRs read and written are worked out from
+ * the function signature, floating point arguments or results are passed in
+ * FPRs which the JIT does not keep cached across calls, so the flag is
+ * dropped for those.
+ */
+template<typename ReturnType, typename... Args>
+inline void
+setFunctionFlags(HleFunction *func, uint32_t flags)
+{
+   if (flags & cpu::KCFLAG_ARGUMENTS_ONLY) {
+      auto reads = uint32_t { 0 };
+      auto writes = uint32_t { 0 };
+      auto r = size_t { 3 };
+      auto gprOnly = functions::ResultGprs<ReturnType>::get(writes);
+      bool args[] = { true, functions::addArgumentGprs<Args>(reads, r)... };
+
+      for (auto arg : args) {
+         gprOnly = gprOnly && arg;
+      }
+
+      if (gprOnly) {
+         func->gprReads = reads;
+         func->gprWrites = writes;
+      } else {
+         flags &= ~cpu::KCFLAG_ARGUMENTS_ONLY;
+      }
+   }
+
+   func->kcFlags = flags;
+}
+
 // Regular Function
 template<typename ReturnType, typename... Args>
 inline HleFunction *
@@ -11,6 +11,9 @@
 #define RegisterKernelFunction(fn) \
    RegisterKernelFunctionName(#fn, fn)
 
+#define RegisterKernelFunctionFlags(fn, flags) \
+   RegisterKernelFunctionName(#fn, fn, flags)
+
 #define RegisterKernelData(data) \
    RegisterKernelDataName(#data, data)
 
@@ -85,6 +88,25 @@ protected:
       registerExportedSymbol(name, kernel::makeFunction(fn));
    }
 
+   template<typename ReturnType, typename... Args>
+   static void RegisterKernelFunctionName(const std::string &name, ReturnType(*fn)(Args...), uint32_t kcFlags)
+   {
+      auto func = kernel::makeFunction(fn);
+      kernel::setFunctionFlags<ReturnType, Args...>(func, kcFlags);
+      registerExportedSymbol(name, func);
+   }
+
+   // Registers a host implementation for guest functions called name, which
+   //  the loader uses in their place when system.redirect_libc is enabled.
+   template<typename ReturnType, typename... Args>
+   static void RegisterGuestRedirectName(const std::string &name, ReturnType(*fn)(Args...), uint32_t kcFlags)
+   {
+      auto func = kernel::makeFunction(fn);
+      kernel::setFunctionFlags<ReturnType, Args...>(func, kcFlags);
+      func->guestRedirect = name;
+      registerSymbol("__redirect_" + name, func);
+   }
+
    template<typename ReturnType, typename Class, typename... Args>
    static void RegisterKernelFunctionName(const std::string &name, ReturnType(Class::*fn)(Args...))
    {
@@ -797,6 +797,63 @@ processImports(LoadedModule *loadedMod,
    return true;
 }
 
+/**
+ * Overwrite the start of guest functions which have a host replacement with
+ * a syscall thunk, this must happen after relocations have been applied so
+ * they do not write over the thunk.
+ */
+static void
+processGuestRedirects(LoadedModule *loadedMod,
+                      SectionList &sections)
+{
+   for (auto &section : sections) {
+      if (section.header.type != elf::SHT_SYMTAB) {
+         continue;
+      }
+
+      auto strTab = reinterpret_cast<const char*>(sections[section.header.link].memory);
+      auto symIn = BigEndianView{ section.memory, section.virtSize };
+
+      while (!symIn.eof()) {
+         elf::Symbol sym;
+         elf::readSymbol(symIn, sym);
+
+         auto name = strTab + sym.name;
+         auto type = sym.info & 0xf;
+
+         // We need room for the kc and blr
+         if (type != elf::STT_FUNC || sym.size < 8 || sym.shndx >= elf::SHN_LORESERVE) {
+            continue;
+         }
+
+         auto &symsec = sections[sym.shndx];
+
+         if (!symsec.virtSize || !(symsec.header.flags & elf::SHF_EXECINSTR)) {
+            continue;
+         }
+
+         auto func = kernel::findHleGuestRedirect(name);
+
+         if (!func) {
+            continue;
+         }
+
+         auto virtAddress = symsec.virtAddress + (sym.value - symsec.header.addr);
+
+         auto kc = espresso::encodeInstruction(espresso::InstructionID::kc);
+         kc.kcn = func->syscallID;
+         mem::write(virtAddress + 0, kc.value);
+
+         auto bclr = espresso::encodeInstruction(espresso::InstructionID::bclr);
+         bclr.bo = 20;
+         bclr.bi = 0;
+         mem::write(virtAddress + 4, bclr.value);
+
+         gLog->debug("Redirected {}:{} at 0x{:08X} to host implementation", loadedMod->name, name, virtAddress);
+      }
+   }
+}
+
 bool
 processSymbols(LoadedModule *loadedMod,
                SectionList &sections)
@@ -1094,6 +1151,10 @@ loadRPL(const std::string &moduleName,
       return nullptr;
    }
 
+   if (decaf::config::system::redirect_libc) {
+      processGuestRedirects(loadedMod, sections);
+   }
+
    // Process dot syscall
    for (auto &section : sections) {
       auto sectionName = shStrTab + section.header.name;
@@ -10,7 +10,9 @@
 #include "coreinit_internal_idlock.h"
 #include "ppcutils/wfunc_call.h"
 #include "libcpu/cpu.h"
+#include "common/bitutils.h"
 #include "common/decaf_assert.h"
+#include <algorithm>
 #include <array>
 
 namespace coreinit
@@ -33,11 +35,56 @@ OSAlarm::Tag;
 const uint32_t
 OSAlarmQueue::Tag;
 
+/*
+ * Set alarms are kept in a hierarchical timer wheel per core, so setting,
+ * cancelling and finding the next alarm to fire do not depend on how many
+ * alarms are set.
+ *
+ * Level 0 has a slot for every 2^16 timer ticks (~1ms) and each level above
+ * it covers 64 times the range of the one below.  An alarm is put in the
+ * lowest level whose range reaches its fire time, and is moved down to a
+ * lower level when the wheel reaches the start of its slot.  Alarms beyond
+ * the range of the top level wait in its last slot until they are in range.
+ *
+ * Every slot is an OSAlarmQueue, so alarm->alarmQueue always points to the
+ * queue an alarm is in and cancelling an alarm is just removing it from there.
+ */
+static const uint32_t
+AlarmWheelLevels = 4;
+
+static const uint32_t
+AlarmWheelSlotBits = 6;
+
+static const uint32_t
+AlarmWheelSlots = 1 << AlarmWheelSlotBits;
+
+static const uint32_t
+AlarmWheelResolutionBits = 16;
+
+static const uint32_t
+AlarmWheelQueuesPerCore = AlarmWheelLevels * AlarmWheelSlots;
+
+struct AlarmWheel
+{
+   //! Start of the level 0 slot which the wheel has advanced to.
+   OSTime current;
+
+   //! Number of alarms in the wheel.
+   uint32_t numAlarms;
+
+   //! A bit for each slot which may contain alarms, these are only cleared
+   //!  once the slot is seen to be empty, so a set bit may be stale.
+   std::array<uint64_t, AlarmWheelLevels> occupied;
+};
+
 static internal::IdLock
 sAlarmLock;
 
-static std::array<OSAlarmQueue *, CoreCount>
-sAlarmQueue;
+static std::array<AlarmWheel, CoreCount>
+sAlarmWheel;
+
+static std::array<OSAlarmQueue *, CoreCount * AlarmWheelQueuesPerCore>
+sAlarmWheelQueue;
 
 static std::array<OSAlarmQueue *, CoreCount>
 sAlarmCallbackQueue;
@@ -48,6 +95,212 @@ sAlarmCallbackThread;
 static std::array<OSThreadQueue *, CoreCount>
 sAlarmCallbackThreadQueue;
 
+static uint32_t
+getAlarmWheelShift(uint32_t level)
+{
+   return AlarmWheelResolutionBits + level * AlarmWheelSlotBits;
+}
+
+static uint32_t
+getAlarmWheelSlot(OSTime time,
+                  uint32_t level)
+{
+   return static_cast<uint32_t>(time >> getAlarmWheelShift(level)) & (AlarmWheelSlots - 1);
+}
+
+static OSAlarmQueue *
+getAlarmWheelQueue(uint32_t core,
+                   uint32_t level,
+                   uint32_t slot)
+{
+   return sAlarmWheelQueue[core * AlarmWheelQueuesPerCore + level * AlarmWheelSlots + slot];
+}
+
+
+/**
+ * Find which core's alarm wheel a queue belongs to.
+ */
+static bool
+findAlarmWheel(OSAlarmQueue *queue,
+               uint32_t &core)
+{
+   // The wheel queues are allocated contiguously, in the same order as sAlarmWheelQueue
+   for (auto i = 0u; i < CoreCount; ++i) {
+      auto first = sAlarmWheelQueue[i * AlarmWheelQueuesPerCore];
+      auto last = sAlarmWheelQueue[i * AlarmWheelQueuesPerCore + AlarmWheelQueuesPerCore - 1];
+
+      if (queue >= first && queue <= last) {
+         core = i;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+
+/**
+ * Find the first slot which may contain alarms, starting from minOffset slots
+ * after the wheel's current slot.
+ *
+ * \return Offset of the slot from the current slot, or AlarmWheelSlots if none.
+ */
+static uint32_t
+findOccupiedAlarmWheelSlot(AlarmWheel &wheel,
+                           uint32_t level,
+                           uint32_t minOffset)
+{
+   auto current = getAlarmWheelSlot(wheel.current, level);
+   auto bits = wheel.occupied[level];
+   unsigned long offset;
+
+   if (minOffset >= AlarmWheelSlots) {
+      return AlarmWheelSlots;
+   }
+
+   if (current) {
+      bits = (bits >> current) | (bits << (64 - current));
+   }
+
+   bits &= ~make_bitmask<uint64_t>(minOffset);
+
+   if (!bit_scan_forward(&offset, bits)) {
+      return AlarmWheelSlots;
+   }
+
+   return static_cast<uint32_t>(offset);
+}
+
+
+/**
+ * Insert a set alarm into a core's alarm wheel.
+ */
+static void
+insertAlarmNoALock(uint32_t core,
+                   OSAlarm *alarm)
+{
+   auto &wheel = sAlarmWheel[core];
+
+   if (wheel.numAlarms == 0) {
+      // An empty wheel can be moved straight to the current time
+      wheel.current = (OSGetTime() >> AlarmWheelResolutionBits) << AlarmWheelResolutionBits;
+   }
+
+   auto expires = std::max<OSTime>(alarm->nextFire, wheel.current);
+   auto level = 0u;
+   auto slot = 0u;
+
+   for (level = 0; level < AlarmWheelLevels; ++level) {
+      auto shift = getAlarmWheelShift(level);
+
+      if ((expires >> shift) - (wheel.current >> shift) < AlarmWheelSlots) {
+         slot = getAlarmWheelSlot(expires, level);
+         break;
+      }
+   }
+
+   if (level == AlarmWheelLevels) {
+      // Too far away for the top level, park it in the last slot we can reach
+      level = AlarmWheelLevels - 1;
+      slot = (getAlarmWheelSlot(wheel.current, level) + AlarmWheelSlots - 1) & (AlarmWheelSlots - 1);
+   }
+
+   auto queue = getAlarmWheelQueue(core, level, slot);
+   internal::AlarmQueue::append(queue, alarm);
+   alarm->alarmQueue = queue;
+
+   wheel.occupied[level] |= 1ull << slot;
+   wheel.numAlarms++;
+}
+
+
+/**
+ * Remove an alarm from whichever queue it is in.
+ */
+static void
+removeAlarmNoALock(OSAlarm *alarm)
+{
+   OSAlarmQueue *queue = alarm->alarmQueue;
+   auto core = 0u;
+
+   if (!queue) {
+      return;
+   }
+
+   internal::AlarmQueue::erase(queue, alarm);
+   alarm->alarmQueue = nullptr;
+
+   if (findAlarmWheel(queue, core)) {
+      sAlarmWheel[core].numAlarms--;
+   }
+}
+
+
+/**
+ * Move all the alarms in a slot down to the lower levels of the wheel.
+ */
+static void
+cascadeAlarmsNoALock(uint32_t core,
+                     uint32_t level,
+                     uint32_t slot)
+{
+   auto queue = getAlarmWheelQueue(core, level, slot);
+   sAlarmWheel[core].occupied[level] &= ~(1ull << slot);
+
+   for (OSAlarm *alarm = queue->head; alarm; alarm = queue->head) {
+      removeAlarmNoALock(alarm);
+      insertAlarmNoALock(core, alarm);
+   }
+}
+
+
+/**
+ * Find the time at which the next alarm in a core's wheel should fire.
+ */
+static bool
+getNextAlarmTimeNoALock(uint32_t core,
+                        OSTime &nextFire)
+{
+   auto &wheel = sAlarmWheel[core];
+   auto found = false;
+
+   if (!wheel.numAlarms) {
+      return false;
+   }
+
+   for (auto level = 0u; level < AlarmWheelLevels; ++level) {
+      auto offset = findOccupiedAlarmWheelSlot(wheel, level, 0);
+
+      // Find the first slot in this level which is actually not empty
+      while (offset < AlarmWheelSlots) {
+         auto slot = (getAlarmWheelSlot(wheel.current, level) + offset) & (AlarmWheelSlots - 1);
+         auto queue = getAlarmWheelQueue(core, level, slot);
+
+         if (queue->head) {
+            for (OSAlarm *alarm = queue->head; alarm; alarm = alarm->link.next) {
+               if (!found || alarm->nextFire < nextFire) {
+                  nextFire = alarm->nextFire;
+                  found = true;
+               }
+            }
+
+            // Alarms parked in the top level are not ordered by slot, so
+            //  all of its slots have to be checked.
+            if (level < AlarmWheelLevels - 1) {
+               break;
+            }
+         } else {
+            wheel.occupied[level] &= ~(1ull << slot);
+         }
+
+         offset = findOccupiedAlarmWheelSlot(wheel, level, offset + 1);
+      }
+   }
+
+   return found;
+}
+
+
 /**
  * Internal alarm cancel.
  *
@@ -68,11 +321,7 @@ cancelAlarmNoAlarmLock(OSAlarm *alarm)
    alarm->nextFire = 0;
    alarm->period = 0;
 
-   if (alarm->alarmQueue) {
-      internal::AlarmQueue::erase(alarm->alarmQueue, alarm);
-      alarm->alarmQueue = nullptr;
-   }
-
+   removeAlarmNoALock(alarm);
    return TRUE;
 }
 
@@ -115,9 +364,7 @@ OSCancelAlarms(uint32_t group)
    internal::lockScheduler();
    internal::acquireIdLock(sAlarmLock);
 
-   for (auto i = 0u; i < 3; ++i) {
-      auto queue = sAlarmQueue[i];
-
+   for (auto queue : sAlarmWheelQueue) {
       for (OSAlarm *alarm = queue->head; alarm; ) {
          auto next = alarm->link.next;
 
@@ -236,20 +483,12 @@ OSSetPeriodicAlarm(OSAlarm *alarm,
    alarm->state = OSAlarmState::Set;
 
    // Erase from old alarm queue
-   if (alarm->alarmQueue) {
-      internal::AlarmQueue::erase(alarm->alarmQueue, alarm);
-      alarm->alarmQueue = nullptr;
-   }
+   removeAlarmNoALock(alarm);
 
-   // Add to this core's alarm queue
-   auto core = OSGetCoreId();
-   auto queue = sAlarmQueue[core];
-   alarm->alarmQueue = queue;
-   internal::AlarmQueue::append(queue, alarm);
+   // Add to this core's alarm wheel
+   insertAlarmNoALock(OSGetCoreId(), alarm);
 
    // Set the interrupt timer in processor
-   // TODO: Store the last set CPU alarm time, and simply check this
-   // alarm against that time to make finding the soonest alarm cheaper.
    internal::updateCpuAlarmNoALock();
 
    internal::releaseIdLock(sAlarmLock, alarm);
@@ -304,7 +543,7 @@ OSWaitAlarm(OSAlarm *alarm)
    }
 
    OSGetCurrentThread()->alarmCancelled = false;
-   internal::sleepThreadNoLock(&alarm->threadQueue);
+   internal::sleepThreadNoLock(&alarm->threadQueue, internal::SchedulerBlockReason::Alarm);
 
    internal::releaseIdLock(sAlarmLock, alarm);
    internal::rescheduleSelfNoLock();
@@ -323,7 +562,6 @@ uint32_t
 AlarmCallbackThreadEntry(uint32_t core_id,
                          void *arg2)
 {
-   auto queue = sAlarmQueue[core_id];
    auto cbQueue = sAlarmCallbackQueue[core_id];
    auto threadQueue = sAlarmCallbackThreadQueue[core_id];
 
@@ -334,7 +572,7 @@ AlarmCallbackThreadEntry(uint32_t core_id,
       OSAlarm *alarm = internal::AlarmQueue::popFront(cbQueue);
       if (alarm == nullptr) {
          // No alarms currently pending for callback
-         internal::sleepThreadNoLock(threadQueue);
+         internal::sleepThreadNoLock(threadQueue, internal::SchedulerBlockReason::ThreadQueue);
          internal::releaseIdLock(sAlarmLock);
 
          internal::rescheduleSelfNoLock();
@@ -342,11 +580,12 @@ AlarmCallbackThreadEntry(uint32_t core_id,
          continue;
       }
 
+      alarm->alarmQueue = nullptr;
+
       if (alarm->period) {
          alarm->nextFire = alarm->nextFire + alarm->period;
          alarm->state = OSAlarmState::Set;
-         internal::AlarmQueue::append(queue, alarm);
-         alarm->alarmQueue = queue;
+         insertAlarmNoALock(core_id, alarm);
          internal::updateCpuAlarmNoALock();
       }
 
@@ -377,7 +616,7 @@ Module::registerAlarmFunctions()
    RegisterKernelFunction(OSWaitAlarm);
 
    RegisterInternalFunction(AlarmCallbackThreadEntry, sAlarmCallbackThreadEntryPoint);
-   RegisterInternalData(sAlarmQueue);
+   RegisterInternalData(sAlarmWheelQueue);
    RegisterInternalData(sAlarmCallbackQueue);
    RegisterInternalData(sAlarmCallbackThreadQueue);
    RegisterInternalData(sAlarmCallbackThread);
@@ -386,8 +625,12 @@ Module::registerAlarmFunctions()
 void
 Module::initialiseAlarm()
 {
+   for (auto queue : sAlarmWheelQueue) {
+      OSInitAlarmQueue(queue);
+   }
+
    for (auto i = 0u; i < CoreCount; ++i) {
-      OSInitAlarmQueue(sAlarmQueue[i]);
+      sAlarmWheel[i] = AlarmWheel { };
       OSInitAlarmQueue(sAlarmCallbackQueue[i]);
       OSInitThreadQueue(sAlarmCallbackThreadQueue[i]);
    }
@@ -433,76 +676,108 @@ cancelAlarm(OSAlarm *alarm)
 void
 updateCpuAlarmNoALock()
 {
-   auto queue = sAlarmQueue[cpu::this_core::id()];
    auto next = std::chrono::steady_clock::time_point::max();
+   auto nextFire = OSTime { 0 };
 
-   for (OSAlarm *alarm = queue->head; alarm; ) {
-      auto nextAlarm = alarm->link.next;
+   if (getNextAlarmTimeNoALock(cpu::this_core::id(), nextFire)) {
+      next = cpu::tbToTimePoint(nextFire - internal::getBaseTime());
+   }
 
-      // Update next if its not past yet
-      if (alarm->state == OSAlarmState::Set && alarm->nextFire) {
-         auto nextFire = cpu::tbToTimePoint(alarm->nextFire - internal::getBaseTime());
+   cpu::this_core::setNextAlarm(next);
+}
 
-         if (nextFire < next) {
-            next = nextFire;
-         }
-      }
+static void
+triggerAlarmNoALock(uint32_t core_id,
+                    OSAlarm *alarm,
+                    OSContext *context)
+{
+   decaf_check(alarm->state == OSAlarmState::Set);
+
+   alarm->state = OSAlarmState::Expired;
+   alarm->context = context;
 
-      alarm = nextAlarm;
+   if (alarm->threadQueue.head) {
+      wakeupThreadNoLock(&alarm->threadQueue);
+      rescheduleOtherCoreNoLock();
    }
 
-   cpu::this_core::setNextAlarm(next);
+   if (alarm->group == 0xFFFFFFFF) {
+      // System-internal alarm
+      if (alarm->callback) {
+         auto originalMask = cpu::this_core::setInterruptMask(0);
+         alarm->callback(alarm, context);
+         cpu::this_core::setInterruptMask(originalMask);
+      }
+   } else {
+      auto cbQueue = sAlarmCallbackQueue[core_id];
+      internal::AlarmQueue::append(cbQueue, alarm);
+      alarm->alarmQueue = cbQueue;
+
+      wakeupThreadNoLock(sAlarmCallbackThreadQueue[core_id]);
+   }
 }
 
 void
 handleAlarmInterrupt(OSContext *context)
 {
    auto core_id = cpu::this_core::id();
-   auto queue = sAlarmQueue[core_id];
-   auto cbQueue = sAlarmCallbackQueue[core_id];
-   auto cbThreadQueue = sAlarmCallbackThreadQueue[core_id];
-
+   auto &wheel = sAlarmWheel[core_id];
    auto now = OSGetTime();
-   auto next = std::chrono::time_point<std::chrono::system_clock>::max();
-   bool callbacksNeeded = false;
+   auto target = (now >> AlarmWheelResolutionBits) << AlarmWheelResolutionBits;
 
    internal::lockScheduler();
    acquireIdLock(sAlarmLock);
 
-   for (OSAlarm *alarm = queue->head; alarm; ) {
-      auto nextAlarm = alarm->link.next;
-
-      // Expire it if its past its nextFire time
-      if (alarm->nextFire <= now) {
-         decaf_check(alarm->state == OSAlarmState::Set);
+   while (wheel.numAlarms) {
+      auto slot = getAlarmWheelSlot(wheel.current, 0);
+      auto queue = getAlarmWheelQueue(core_id, 0, slot);
 
-         internal::AlarmQueue::erase(queue, alarm);
-         alarm->alarmQueue = nullptr;
+      if (wheel.current >= target) {
+         // This slot contains now, so only some of its alarms may be due
+         for (OSAlarm *alarm = queue->head; alarm; ) {
+            auto nextAlarm = alarm->link.next;
 
-         alarm->state = OSAlarmState::Expired;
-         alarm->context = context;
+            if (alarm->nextFire <= now) {
+               removeAlarmNoALock(alarm);
+               triggerAlarmNoALock(core_id, alarm, context);
+            }
 
-         if (alarm->threadQueue.head) {
-            wakeupThreadNoLock(&alarm->threadQueue);
-            rescheduleOtherCoreNoLock();
+            alarm = nextAlarm;
          }
 
-         if (alarm->group == 0xFFFFFFFF) {
-            // System-internal alarm
-            if (alarm->callback) {
-               auto originalMask = cpu::this_core::setInterruptMask(0);
-               alarm->callback(alarm, context);
-               cpu::this_core::setInterruptMask(originalMask);
-            }
-         } else {
-            internal::AlarmQueue::append(cbQueue, alarm);
-            alarm->alarmQueue = cbQueue;
+         break;
+      }
 
-            wakeupThreadNoLock(cbThreadQueue);
+      // Every alarm in a slot before now is due
+      for (OSAlarm *alarm = queue->head; alarm; alarm = queue->head) {
+         removeAlarmNoALock(alarm);
+         triggerAlarmNoALock(core_id, alarm, context);
+      }
+
+      wheel.occupied[0] &= ~(1ull << slot);
+
+      // Skip ahead to the next slot which may contain alarms, or the start
+      //  of a slot in a higher level which needs to be moved down.
+      auto next = target;
+
+      for (auto level = 0u; level < AlarmWheelLevels; ++level) {
+         auto shift = getAlarmWheelShift(level);
+         auto offset = findOccupiedAlarmWheelSlot(wheel, level, 1);
+
+         if (offset < AlarmWheelSlots) {
+            next = std::min<OSTime>(next, ((wheel.current >> shift) + offset) << shift);
          }
       }
 
-      alarm = nextAlarm;
+      wheel.current = next;
+
+      for (auto level = AlarmWheelLevels - 1; level > 0; --level) {
+         auto shift = getAlarmWheelShift(level);
+
+         if ((wheel.current & make_bitmask<OSTime>(shift)) == 0) {
+            cascadeAlarmsNoALock(core_id, level, getAlarmWheelSlot(wheel.current, level));
+         }
+      }
    }
 
    internal::updateCpuAlarmNoALock();
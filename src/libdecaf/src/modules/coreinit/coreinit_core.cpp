@@ -49,7 +49,7 @@ void
 Module::registerCoreFunctions()
 {
    RegisterKernelFunction(OSGetCoreCount);
-   RegisterKernelFunction(OSGetCoreId);
+   RegisterKernelFunctionFlags(OSGetCoreId, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
    RegisterKernelFunction(OSGetMainCoreId);
    RegisterKernelFunction(OSIsMainCore);
 }
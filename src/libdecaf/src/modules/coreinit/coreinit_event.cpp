@@ -233,7 +233,7 @@ OSWaitEvent(OSEvent *event)
       }
    } else {
       // Wait for event to be set
-      internal::sleepThreadNoLock(&event->queue);
+      internal::sleepThreadNoLock(&event->queue, internal::SchedulerBlockReason::Event);
       internal::rescheduleSelfNoLock();
    }
 
@@ -308,7 +308,7 @@ OSWaitEventWithTimeout(OSEvent *event,
    thread->waitEventTimeoutAlarm = alarm;
 
    // Wait for the event
-   internal::sleepThreadNoLock(&event->queue);
+   internal::sleepThreadNoLock(&event->queue, internal::SchedulerBlockReason::Event);
    internal::rescheduleAllCoreNoLock();
 
    // Clear waitEventTimeoutAlarm
@@ -65,7 +65,7 @@ fastMutexHardLock(OSFastMutex *mutex)
          internal::promoteThreadPriorityNoLock(ownerThread, thread->priority);
 
          // Sleep on the queue waiting for a hard unlock
-         internal::sleepThreadNoLock(&mutex->queue);
+         internal::sleepThreadNoLock(&mutex->queue, internal::SchedulerBlockReason::FastMutex);
          internal::rescheduleSelfNoLock();
 
          // We are no longer attempting to lock this fast mutex
@@ -332,7 +332,7 @@ OSFastCond_Wait(OSFastCondition *condition,
    internal::enableScheduler();
 
    // Sleep the current thread on the condition queue, wait to be signalled
-   internal::sleepThreadNoLock(&condition->queue);
+   internal::sleepThreadNoLock(&condition->queue, internal::SchedulerBlockReason::Condition);
    internal::rescheduleSelfNoLock();
 
    // We must release the scheduler lock before trying to do a FastMutex lock
@@ -252,7 +252,7 @@ Module::registerGhsFunctions()
 {
    RegisterKernelFunctionName("__ghsLock", ghsLock);
    RegisterKernelFunctionName("__ghsUnlock", ghsUnlock);
-   RegisterKernelFunctionName("__gh_errno_ptr", ghs_errno_ptr);
+   RegisterKernelFunctionName("__gh_errno_ptr", ghs_errno_ptr, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
    RegisterKernelFunctionName("__gh_set_errno", ghs_set_errno);
    RegisterKernelFunctionName("__gh_get_errno", ghs_get_errno);
    RegisterKernelFunctionName("__get_eh_globals", ghs_get_eh_globals);
@@ -0,0 +1,264 @@
+#include "coreinit_internal_schedulertrace.h"
+#include "coreinit_thread.h"
+#include "libcpu/cpu.h"
+#include "libcpu/mem.h"
+#include <spdlog/fmt/fmt.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace coreinit
+{
+
+namespace internal
+{
+
+// Number of events kept per core, older events are overwritten
+static const size_t
+SchedulerTraceSize = 1 << 16;
+
+struct SchedulerEvent
+{
+   uint64_t time;
+   SchedulerEventType type;
+   uint32_t thread;
+   uint32_t object;
+   SchedulerBlockReason reason;
+};
+
+/*
+ * Each core records into its own ring so recording never has to share a
+ * cache line with another core.  Every event is recorded while holding the
+ * scheduler lock, which keeps host threads sharing the last ring in order.
+ *
+ * The rings are allocated up front by allocateSchedulerTrace() so that the
+ * recording path never allocates while the scheduler lock is held.
+ */
+struct SchedulerTraceRing
+{
+   std::unique_ptr<SchedulerEvent[]> events;
+   std::atomic<uint64_t> count { 0 };
+};
+
+static std::array<SchedulerTraceRing, 4>
+sSchedulerTrace;
+
+/**
+ * Allocate the per-core event rings, must be called before any events are
+ * recorded if scheduler tracing is enabled.
+ */
+void
+allocateSchedulerTrace()
+{
+   for (auto &ring : sSchedulerTrace) {
+      if (!ring.events) {
+         ring.events.reset(new SchedulerEvent[SchedulerTraceSize]);
+      }
+   }
+}
+
+void
+recordSchedulerEvent(SchedulerEventType type,
+                     OSThread *thread,
+                     uint32_t object,
+                     SchedulerBlockReason reason)
+{
+   auto &ring = sSchedulerTrace[std::min<uint32_t>(cpu::this_core::id(), 3)];
+
+   if (!ring.events) {
+      return;
+   }
+
+   auto index = ring.count.load(std::memory_order_relaxed);
+   auto &event = ring.events[index & (SchedulerTraceSize - 1)];
+   event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   event.type = type;
+   event.thread = thread ? mem::untranslate(thread) : 0;
+   event.object = object;
+   event.reason = reason;
+   ring.count.store(index + 1, std::memory_order_release);
+}
+
+static void
+writeJsonString(std::ofstream &out,
+                const std::string &str)
+{
+   out << '"';
+
+   for (auto c : str) {
+      if (c == '"' || c == '\\') {
+         out << '\\' << c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+         out << ' ';
+      } else {
+         out << c;
+      }
+   }
+
+   out << '"';
+}
+
+static std::string
+getThreadDescription(uint32_t address)
+{
+   if (!address) {
+      return "Idle";
+   }
+
+   auto thread = mem::translate<OSThread>(address);
+   auto name = std::string { "?" };
+
+   if (thread->name) {
+      name = std::string { thread->name.get(), strnlen(thread->name.get(), 64) };
+   }
+
+   return fmt::format("{} [{}]", name, thread->id);
+}
+
+static const char *
+getBlockReasonName(SchedulerBlockReason reason)
+{
+   switch (reason) {
+   case SchedulerBlockReason::ThreadQueue:
+      return "thread queue";
+   case SchedulerBlockReason::Delay:
+      return "delay";
+   case SchedulerBlockReason::Mutex:
+      return "mutex";
+   case SchedulerBlockReason::FastMutex:
+      return "fast mutex";
+   case SchedulerBlockReason::Condition:
+      return "condition";
+   case SchedulerBlockReason::Semaphore:
+      return "semaphore";
+   case SchedulerBlockReason::Event:
+      return "event";
+   case SchedulerBlockReason::MessageSend:
+      return "message send";
+   case SchedulerBlockReason::MessageReceive:
+      return "message receive";
+   case SchedulerBlockReason::Alarm:
+      return "alarm";
+   case SchedulerBlockReason::Join:
+      return "join";
+   case SchedulerBlockReason::Suspend:
+      return "suspend";
+   case SchedulerBlockReason::GpuTimeStamp:
+      return "gpu timestamp";
+   default:
+      return "unknown";
+   }
+}
+
+static void
+writeEventHeader(std::ofstream &out,
+                 const char *name,
+                 const char *phase,
+                 uint32_t core,
+                 uint64_t time)
+{
+   out << ",\n{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"pid\":0,\"tid\":" << core
+       << ",\"ts\":" << (time / 1000) << "." << fmt::format("{:03}", time % 1000);
+}
+
+/**
+ * Write the recorded scheduler events in the Chrome trace event format, which
+ * can be opened in chrome://tracing or the Perfetto UI.
+ */
+bool
+writeSchedulerTrace(const std::string &path)
+{
+   std::ofstream out { path, std::ofstream::out | std::ofstream::trunc };
+   std::array<std::vector<SchedulerEvent>, 4> coreEvents;
+   auto startTime = std::numeric_limits<uint64_t>::max();
+   auto endTime = uint64_t { 0 };
+
+   if (!out.is_open()) {
+      return false;
+   }
+
+   for (auto i = 0u; i < coreEvents.size(); ++i) {
+      auto &ring = sSchedulerTrace[i];
+      auto count = ring.count.load(std::memory_order_acquire);
+      auto first = count > SchedulerTraceSize ? count - SchedulerTraceSize : 0;
+
+      for (auto j = first; j < count; ++j) {
+         auto &event = ring.events[j & (SchedulerTraceSize - 1)];
+         startTime = std::min(startTime, event.time);
+         endTime = std::max(endTime, event.time);
+         coreEvents[i].push_back(event);
+      }
+   }
+
+   out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+   out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"decaf scheduler\"}}";
+
+   for (auto i = 0u; i < coreEvents.size(); ++i) {
+      out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i << ",\"args\":{\"name\":";
+      writeJsonString(out, i < 3 ? fmt::format("Core {}", i) : std::string { "Host" });
+      out << "}}";
+
+      auto runningThread = uint32_t { 0 };
+      auto runningStart = uint64_t { 0 };
+
+      for (auto &event : coreEvents[i]) {
+         auto time = event.time - startTime;
+
+         switch (event.type) {
+         case SchedulerEventType::Switch:
+            if (runningThread) {
+               writeEventHeader(out, "running", "X", i, runningStart);
+               out << ",\"dur\":" << ((time - runningStart) / 1000) << "." << fmt::format("{:03}", (time - runningStart) % 1000)
+                   << ",\"args\":{\"thread\":";
+               writeJsonString(out, getThreadDescription(runningThread));
+               out << "}}";
+            }
+
+            runningThread = event.object;
+            runningStart = time;
+            break;
+         case SchedulerEventType::Wake:
+            writeEventHeader(out, "wake", "i", i, time);
+            out << ",\"s\":\"t\",\"args\":{\"by\":";
+            writeJsonString(out, getThreadDescription(event.thread));
+            out << ",\"thread\":";
+            writeJsonString(out, getThreadDescription(event.object));
+            out << "}}";
+            break;
+         case SchedulerEventType::Block:
+            writeEventHeader(out, "block", "i", i, time);
+            out << ",\"s\":\"t\",\"args\":{\"thread\":";
+            writeJsonString(out, getThreadDescription(event.thread));
+            out << ",\"reason\":\"" << getBlockReasonName(event.reason) << "\"";
+            out << ",\"object\":\"" << fmt::format("0x{:08X}", event.object) << "\"}}";
+            break;
+         case SchedulerEventType::LockContended:
+            writeEventHeader(out, "scheduler lock contended", "i", i, time);
+            out << ",\"s\":\"t\",\"args\":{\"spins\":" << event.object << "}}";
+            break;
+         }
+      }
+
+      if (runningThread && !coreEvents[i].empty()) {
+         auto time = endTime - startTime;
+         writeEventHeader(out, "running", "X", i, runningStart);
+         out << ",\"dur\":" << ((time - runningStart) / 1000) << "." << fmt::format("{:03}", (time - runningStart) % 1000)
+             << ",\"args\":{\"thread\":";
+         writeJsonString(out, getThreadDescription(runningThread));
+         out << "}}";
+      }
+   }
+
+   out << "\n]}\n";
+   return true;
+}
+
+} // namespace internal
+
+} // namespace coreinit
@@ -0,0 +1,103 @@
+#pragma once
+#include "common/types.h"
+#include "decaf_config.h"
+#include <string>
+
+namespace coreinit
+{
+
+struct OSThread;
+
+namespace internal
+{
+
+enum class SchedulerEventType : uint32_t
+{
+   //! A core switched from thread to object, either may be null for idle
+   Switch,
+
+   //! Thread made the thread in object ready to run
+   Wake,
+
+   //! Thread went to sleep waiting on the object in object
+   Block,
+
+   //! A core waited for the scheduler lock, object is the number of spins
+   LockContended,
+};
+
+//! Why a thread went to sleep, recorded with Block events
+enum class SchedulerBlockReason : uint32_t
+{
+   //! OSSleepThread, or a system thread waiting for work
+   ThreadQueue,
+
+   //! OSSleepTicks
+   Delay,
+
+   Mutex,
+   FastMutex,
+   Condition,
+   Semaphore,
+   Event,
+   MessageSend,
+   MessageReceive,
+
+   //! OSWaitAlarm
+   Alarm,
+
+   //! OSJoinThread
+   Join,
+
+   //! OSSuspendThread on another thread, waiting for it to be suspended
+   Suspend,
+
+   //! GX2WaitTimeStamp
+   GpuTimeStamp,
+};
+
+void
+allocateSchedulerTrace();
+
+void
+recordSchedulerEvent(SchedulerEventType type,
+                     OSThread *thread,
+                     uint32_t object,
+                     SchedulerBlockReason reason);
+
+bool
+writeSchedulerTrace(const std::string &path);
+
+/**
+ * Record a scheduling event if scheduler tracing is enabled.
+ *
+ * Recording never formats anything, events are only turned into text when
+ * the trace is written out.
+ */
+inline void
+traceSchedulerEvent(SchedulerEventType type,
+                    OSThread *thread,
+                    uint32_t object)
+{
+   if (decaf::config::log::scheduler_trace) {
+      recordSchedulerEvent(type, thread, object, SchedulerBlockReason::ThreadQueue);
+   }
+}
+
+/**
+ * Record a Block event along with the reason the thread went to sleep, if
+ * scheduler tracing is enabled.
+ */
+inline void
+traceSchedulerBlock(OSThread *thread,
+                    uint32_t object,
+                    SchedulerBlockReason reason)
+{
+   if (decaf::config::log::scheduler_trace) {
+      recordSchedulerEvent(SchedulerEventType::Block, thread, object, reason);
+   }
+}
+
+} // namespace internal
+
+} // namespace coreinit
@@ -182,7 +182,7 @@ LCStoreDMABlocks(void *dst,
    std::memcpy(dst, src, size * 32);
 
    // Also signal the memory store to the GPU, as with DCFlushRange().
-   gpu::notifyCpuFlush(dst, size);
+   gpu::notifyCpuFlush(dst, size * 32);
 }
 
 
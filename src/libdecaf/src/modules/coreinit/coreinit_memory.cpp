@@ -87,6 +87,30 @@ coreinit_memset(void *dst, int val, ppcsize_t size)
    return dst;
 }
 
+static ppcsize_t
+coreinit_strlen(const char *str)
+{
+   return static_cast<ppcsize_t>(std::strlen(str));
+}
+
+static int
+coreinit_strcmp(const char *lhs, const char *rhs)
+{
+   return std::strcmp(lhs, rhs);
+}
+
+static int
+coreinit_strncmp(const char *lhs, const char *rhs, ppcsize_t count)
+{
+   return std::strncmp(lhs, rhs, count);
+}
+
+static int
+coreinit_memcmp(const void *lhs, const void *rhs, ppcsize_t count)
+{
+   return std::memcmp(lhs, rhs, count);
+}
+
 int
 OSGetMemBound(OSMemoryType type, be_val<uint32_t> *addr, be_val<uint32_t> *size)
 {
@@ -284,8 +308,8 @@ OSUnmapMemory(ppcaddr_t virtAddress,
 void
 Module::registerMemoryFunctions()
 {
-   RegisterKernelFunction(OSBlockMove);
-   RegisterKernelFunction(OSBlockSet);
+   RegisterKernelFunctionFlags(OSBlockMove, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterKernelFunctionFlags(OSBlockSet, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
    RegisterKernelFunction(OSGetMemBound);
    RegisterKernelFunction(OSGetForegroundBucket);
    RegisterKernelFunction(OSGetForegroundBucketFreeArea);
@@ -295,9 +319,19 @@ Module::registerMemoryFunctions()
    RegisterKernelFunction(OSFreeVirtAddr);
    RegisterKernelFunction(OSMapMemory);
    RegisterKernelFunction(OSUnmapMemory);
-   RegisterKernelFunctionName("memcpy", coreinit_memcpy);
-   RegisterKernelFunctionName("memset", coreinit_memset);
-   RegisterKernelFunctionName("memmove", coreinit_memmove);
+   RegisterKernelFunctionName("memcpy", coreinit_memcpy, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterKernelFunctionName("memset", coreinit_memset, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterKernelFunctionName("memmove", coreinit_memmove, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+
+   // Statically linked libc functions in guest RPLs, guest code may rely on
+   //  memcpy behaving with overlapping buffers so give it memmove semantics.
+   RegisterGuestRedirectName("memcpy", coreinit_memmove, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterGuestRedirectName("memmove", coreinit_memmove, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterGuestRedirectName("memset", coreinit_memset, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterGuestRedirectName("memcmp", coreinit_memcmp, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterGuestRedirectName("strlen", coreinit_strlen, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterGuestRedirectName("strcmp", coreinit_strcmp, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterGuestRedirectName("strncmp", coreinit_strncmp, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
 }
 
 namespace internal
@@ -63,7 +63,7 @@ lockMutexNoLock(OSMutex *mutex)
       internal::promoteThreadPriorityNoLock(mutex->owner, thread->priority);
 
       // Wait for other owner to unlock
-      internal::sleepThreadNoLock(&mutex->queue);
+      internal::sleepThreadNoLock(&mutex->queue, internal::SchedulerBlockReason::Mutex);
       internal::rescheduleSelfNoLock();
 
       // We are no longer waiting on the mutex
@@ -272,7 +272,7 @@ OSWaitCond(OSCondition *condition,
    internal::enableScheduler();
 
    // Sleep on the condition
-   internal::sleepThreadNoLock(&condition->queue);
+   internal::sleepThreadNoLock(&condition->queue, internal::SchedulerBlockReason::Condition);
    internal::rescheduleSelfNoLock();
 
    // Relock the mutex
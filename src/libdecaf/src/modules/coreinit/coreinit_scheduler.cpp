@@ -1,5 +1,6 @@
 #include <array>
 #include <chrono>
+#include <thread>
 #include "coreinit.h"
 #include "coreinit_alarm.h"
 #include "coreinit_core.h"
@@ -12,12 +13,15 @@
 #include "coreinit_mutex.h"
 #include "coreinit_thread.h"
 #include "coreinit_internal_queue.h"
+#include "coreinit_internal_schedulertrace.h"
+#include "decaf_config.h"
 #include "debugger/debugger.h"
 #include "kernel/kernel.h"
 #include "kernel/kernel_loader.h"
 #include "libcpu/trace.h"
 #include "ppcutils/wfunc_call.h"
 #include "ppcutils/stackobject.h"
+#include "common/bitutils.h"
 #include "common/decaf_assert.h"
 
 namespace coreinit
@@ -32,12 +36,29 @@ sSchedulerEnabled[3];
 static std::atomic<uint32_t>
 sSchedulerLock { 0 };
 
+// Number of times to spin on the scheduler lock before yielding the host thread
+static const uint32_t
+SchedulerLockSpinsBeforeYield = 1000;
+
+// Lock statistics for each core, the last entry is for non-CPU threads
+static std::array<internal::SchedulerLockStats, 4>
+sSchedulerLockStats;
+
 static OSThreadQueue *
 sActiveThreads;
 
+// One run queue per priority from -1 to 32
+static const uint32_t
+NumRunQueuePriorities = 34;
+
+// Threads are queued in the run queue for their priority on every core which
+//  they can run on, the bits of sCoreRunQueueMask mark which are not empty
 static OSThreadQueue *
 sCoreRunQueue[3];
 
+static uint64_t
+sCoreRunQueueMask[3];
+
 static OSThread *
 sCurrentThread[3];
 
@@ -54,9 +75,9 @@ namespace internal
 {
 
 using ActiveQueue = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::activeLink>;
-using CoreRunQueue0 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink0, threadSortFunc>;
-using CoreRunQueue1 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink1, threadSortFunc>;
-using CoreRunQueue2 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink2, threadSortFunc>;
+using CoreRunQueue0 = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink0>;
+using CoreRunQueue1 = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink1>;
+using CoreRunQueue2 = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink2>;
 
 OSThread *
 getCoreRunningThread(uint32_t coreId)
@@ -97,20 +118,57 @@ getCurrentThread()
    return sCurrentThread[cpu::this_core::id()];
 }
 
+/**
+ * Acquire the scheduler lock.
+ *
+ * This is a single lock shared by every core, it protects the state of every
+ * thread, the run queues, and the wait queues of every mutex, event, message
+ * queue and alarm.  Contention is reduced by spinning on a load before
+ * yielding the host thread and by skipping cross-core reschedules which
+ * would not switch threads.
+ */
 void
 lockScheduler()
 {
    uint32_t expected = 0;
    auto id = cpu::this_core::id();
    auto core = 1 << id;
+   auto &stats = sSchedulerLockStats[std::min<uint32_t>(id, 3)];
 
    if (id == cpu::InvalidCoreId) {
       core = SchedulerLockNonCpuCoreId;
    }
 
-   while (!sSchedulerLock.compare_exchange_weak(expected, core, std::memory_order_acquire)) {
-      expected = 0;
+   stats.acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+   if (sSchedulerLock.compare_exchange_strong(expected, core, std::memory_order_acquire)) {
+      return;
    }
+
+   stats.contended.fetch_add(1, std::memory_order_relaxed);
+
+   // Spin on a plain load rather than the exchange so that waiting cores do
+   //  not keep stealing the lock's cache line from the core which holds it.
+   auto spins = uint64_t { 0 };
+
+   do {
+      while (sSchedulerLock.load(std::memory_order_relaxed) != 0) {
+         if (++spins % SchedulerLockSpinsBeforeYield == 0) {
+            std::this_thread::yield();
+         }
+      }
+
+      expected = 0;
+   } while (!sSchedulerLock.compare_exchange_weak(expected, core, std::memory_order_acquire));
+
+   stats.spins.fetch_add(spins, std::memory_order_relaxed);
+   traceSchedulerEvent(SchedulerEventType::LockContended, nullptr, static_cast<uint32_t>(spins));
+}
+
+const SchedulerLockStats &
+getSchedulerLockStats(uint32_t coreId)
+{
+   return sSchedulerLockStats[std::min<uint32_t>(coreId, 3)];
 }
 
 bool
@@ -166,7 +224,10 @@ markThreadActiveNoLock(OSThread *thread)
 {
    decaf_check(!ActiveQueue::contains(sActiveThreads, thread));
    ActiveQueue::append(sActiveThreads, thread);
-   checkActiveThreadsNoLock();
+
+   if (decaf::config::debugger::scheduler_checks) {
+      checkActiveThreadsNoLock();
+   }
 }
 
 void
@@ -174,7 +235,10 @@ markThreadInactiveNoLock(OSThread *thread)
 {
    decaf_check(ActiveQueue::contains(sActiveThreads, thread));
    ActiveQueue::erase(sActiveThreads, thread);
-   checkActiveThreadsNoLock();
+
+   if (decaf::config::debugger::scheduler_checks) {
+      checkActiveThreadsNoLock();
+   }
 }
 
 bool
@@ -187,6 +251,44 @@ isThreadActiveNoLock(OSThread *thread)
    return ActiveQueue::contains(sActiveThreads, thread);
 }
 
+template<typename RunQueue>
+static void
+insertCoreRunQueueNoLock(uint32_t core,
+                         OSThread *thread,
+                         be_ptr<OSThreadQueue> &runQueue)
+{
+   auto index = static_cast<uint32_t>(thread->priority + 1);
+   decaf_check(index < NumRunQueuePriorities);
+   auto queue = sCoreRunQueue[core] + index;
+
+   // Threads of the same priority run in the order they were queued
+   RunQueue::append(queue, thread);
+   runQueue = queue;
+   sCoreRunQueueMask[core] |= 1ull << index;
+}
+
+template<typename RunQueue>
+static void
+eraseCoreRunQueueNoLock(uint32_t core,
+                        OSThread *thread,
+                        be_ptr<OSThreadQueue> &runQueue)
+{
+   OSThreadQueue *queue = runQueue;
+
+   if (!queue) {
+      return;
+   }
+
+   RunQueue::erase(queue, thread);
+   runQueue = nullptr;
+
+   if (!queue->head) {
+      auto index = static_cast<uint32_t>(queue - sCoreRunQueue[core]);
+      decaf_check(index < NumRunQueuePriorities);
+      sCoreRunQueueMask[core] &= ~(1ull << index);
+   }
+}
+
 static void
 queueThreadNoLock(OSThread *thread)
 {
@@ -197,24 +299,24 @@ queueThreadNoLock(OSThread *thread)
 
    // Schedule this thread on any cores which can run it!
    if (thread->attr & OSThreadAttributes::AffinityCPU0) {
-      CoreRunQueue0::insert(sCoreRunQueue[0], thread);
+      insertCoreRunQueueNoLock<CoreRunQueue0>(0, thread, thread->coreRunQueue0);
    }
 
    if (thread->attr & OSThreadAttributes::AffinityCPU1) {
-      CoreRunQueue1::insert(sCoreRunQueue[1], thread);
+      insertCoreRunQueueNoLock<CoreRunQueue1>(1, thread, thread->coreRunQueue1);
    }
 
    if (thread->attr & OSThreadAttributes::AffinityCPU2) {
-      CoreRunQueue2::insert(sCoreRunQueue[2], thread);
+      insertCoreRunQueueNoLock<CoreRunQueue2>(2, thread, thread->coreRunQueue2);
    }
 }
 
 static void
 unqueueThreadNoLock(OSThread *thread)
 {
-   CoreRunQueue0::erase(sCoreRunQueue[0], thread);
-   CoreRunQueue1::erase(sCoreRunQueue[1], thread);
-   CoreRunQueue2::erase(sCoreRunQueue[2], thread);
+   eraseCoreRunQueueNoLock<CoreRunQueue0>(0, thread, thread->coreRunQueue0);
+   eraseCoreRunQueueNoLock<CoreRunQueue1>(1, thread, thread->coreRunQueue1);
+   eraseCoreRunQueueNoLock<CoreRunQueue2>(2, thread, thread->coreRunQueue2);
 }
 
 void
@@ -235,7 +337,13 @@ static OSThread *
 peekNextThreadNoLock(uint32_t core)
 {
    decaf_check(isSchedulerLocked());
-   auto thread = sCoreRunQueue[core]->head;
+   auto index = 0ul;
+
+   if (!bit_scan_forward(&index, sCoreRunQueueMask[core])) {
+      return nullptr;
+   }
+
+   OSThread *thread = sCoreRunQueue[core][index].head;
 
    if (thread) {
       decaf_check(thread->state == OSThreadState::Ready);
@@ -275,7 +383,7 @@ void checkRunningThreadNoLock(bool yielding)
    auto thread = sCurrentThread[coreId];
 
    // Do a check to see if anything has become corrupted...
-   if (thread) {
+   if (thread && decaf::config::debugger::scheduler_checks) {
       checkActiveThreadsNoLock();
    }
 
@@ -308,27 +416,31 @@ void checkRunningThreadNoLock(bool yielding)
       queueThreadNoLock(thread);
    }
 
-   // *snip* log thread switch *snip* ...
+   traceSchedulerEvent(SchedulerEventType::Switch, thread, next ? mem::untranslate(next) : 0);
 
-   const char *threadName = "?";
-   const char *nextName = "?";
-   if (thread && thread->name) {
-      threadName = thread->name;
-   }
-   if (next && next->name) {
-      nextName = next->name;
-   }
-   if (thread) {
-      if (next) {
-         gLog->trace("Core {} leaving thread {}[{}] to thread {}[{}]", coreId, thread->id, threadName, next->id, nextName);
-      } else {
-         gLog->trace("Core {} leaving thread {}[{}] to idle", coreId, thread->id, threadName);
+   // Only build the switch log message when it would actually be written,
+   //  this is one of the hottest paths in the scheduler.
+   if (gLog->should_log(spdlog::level::trace)) {
+      const char *threadName = "?";
+      const char *nextName = "?";
+      if (thread && thread->name) {
+         threadName = thread->name;
       }
-   } else {
-      if (next) {
-         gLog->trace("Core {} leaving idle to thread {}[{}]", coreId, next->id, nextName);
+      if (next && next->name) {
+         nextName = next->name;
+      }
+      if (thread) {
+         if (next) {
+            gLog->trace("Core {} leaving thread {}[{}] to thread {}[{}]", coreId, thread->id, threadName, next->id, nextName);
+         } else {
+            gLog->trace("Core {} leaving thread {}[{}] to idle", coreId, thread->id, threadName);
+         }
       } else {
-         gLog->trace("Core {} leaving idle to idle", coreId);
+         if (next) {
+            gLog->trace("Core {} leaving idle to thread {}[{}]", coreId, next->id, nextName);
+         } else {
+            gLog->trace("Core {} leaving idle to idle", coreId);
+         }
       }
    }
 
@@ -362,7 +474,7 @@ void checkRunningThreadNoLock(bool yielding)
    // Restore interrupts to whatever state they were in
    coreinit::OSRestoreInterrupts(prevState);
 
-   if (thread) {
+   if (thread && decaf::config::debugger::scheduler_checks) {
       checkActiveThreadsNoLock();
    }
 }
@@ -373,12 +485,34 @@ rescheduleSelfNoLock()
    checkRunningThreadNoLock(false);
 }
 
+/**
+ * Check whether checkRunningThreadNoLock would switch threads on a core.
+ */
+static bool
+needsRescheduleNoLock(uint32_t core)
+{
+   auto thread = sCurrentThread[core];
+   auto next = peekNextThreadNoLock(core);
+
+   if (!thread) {
+      return next != nullptr;
+   }
+
+   if (thread->suspendCounter > 0 || thread->state != OSThreadState::Running) {
+      return true;
+   }
+
+   return next && next->priority < thread->priority;
+}
+
 void
 rescheduleNoLock(uint32_t core)
 {
    if (core == cpu::this_core::id()) {
       rescheduleSelfNoLock();
-   } else {
+   } else if (needsRescheduleNoLock(core)) {
+      // Only interrupt the other core when it has something to switch to,
+      //  each interrupt makes that core take the scheduler lock again.
       cpu::interrupt(core, cpu::GENERIC_INTERRUPT);
    }
 }
@@ -427,7 +561,8 @@ resumeThreadNoLock(OSThread *thread, int32_t counter)
 }
 
 void
-sleepThreadNoLock(OSThreadQueue *queue)
+sleepThreadNoLock(OSThreadQueue *queue,
+                  SchedulerBlockReason reason)
 {
    auto thread = OSGetCurrentThread();
    decaf_check(thread->queue == nullptr);
@@ -438,17 +573,23 @@ sleepThreadNoLock(OSThreadQueue *queue)
 
    if (queue) {
       ThreadQueue::insert(queue, thread);
+      traceSchedulerBlock(thread,
+                          queue->parent ? mem::untranslate(queue->parent.get()) : mem::untranslate(queue),
+                          reason);
+   } else {
+      traceSchedulerBlock(thread, 0, reason);
    }
 }
 
 void
-sleepThreadNoLock(OSThreadSimpleQueue *queue)
+sleepThreadNoLock(OSThreadSimpleQueue *queue,
+                  SchedulerBlockReason reason)
 {
    // This is super-strange, it is used by OSFastMutex, and after a few
    //  comparisons, I'm 99% sure they just cast...  I cast it here instead
    //  of inside OSFastMutex so that its closer to the use above to help
    //  ensure nobody mistakenly breaks it...
-   sleepThreadNoLock(reinterpret_cast<OSThreadQueue*>(queue));
+   sleepThreadNoLock(reinterpret_cast<OSThreadQueue*>(queue), reason);
 }
 
 void
@@ -494,6 +635,7 @@ wakeupOneThreadNoLock(OSThread *thread)
    ThreadQueue::erase(thread->queue, thread);
    thread->queue = nullptr;
    queueThreadNoLock(thread);
+   traceSchedulerEvent(SchedulerEventType::Wake, OSGetCurrentThread(), mem::untranslate(thread));
 }
 
 void
@@ -730,8 +872,12 @@ Module::initialiseSchedulerFunctions()
    for (auto i = 0; i < 3; ++i) {
       sSchedulerEnabled[i] = true;
       sCurrentThread[i] = nullptr;
-      sCoreRunQueue[i] = coreinit::internal::sysAlloc<OSThreadQueue>();
-      OSInitThreadQueue(sCoreRunQueue[i]);
+      sCoreRunQueue[i] = reinterpret_cast<OSThreadQueue *>(coreinit::internal::sysAlloc(sizeof(OSThreadQueue) * NumRunQueuePriorities, 4));
+      sCoreRunQueueMask[i] = 0;
+
+      for (auto j = 0u; j < NumRunQueuePriorities; ++j) {
+         OSInitThreadQueue(&sCoreRunQueue[i][j]);
+      }
       sLastSwitchTime[i] = std::chrono::high_resolution_clock::now();
       sCorePauseTime[i] = std::chrono::time_point<std::chrono::high_resolution_clock>::max();
    }
@@ -1,5 +1,7 @@
 #pragma once
 #include "common/types.h"
+#include <atomic>
+#include "coreinit_internal_schedulertrace.h"
 #include "coreinit_thread.h"
 
 namespace coreinit
@@ -11,6 +13,18 @@ struct OSThreadQueue;
 namespace internal
 {
 
+struct SchedulerLockStats
+{
+   //! Number of times the scheduler lock was taken
+   std::atomic<uint64_t> acquisitions { 0 };
+
+   //! Number of times the scheduler lock was already held by someone else
+   std::atomic<uint64_t> contended { 0 };
+
+   //! Number of times we spun waiting for the scheduler lock
+   std::atomic<uint64_t> spins { 0 };
+};
+
 void
 startDefaultCoreThreads();
 
@@ -38,6 +52,9 @@ isSchedulerLocked();
 void
 unlockScheduler();
 
+const SchedulerLockStats &
+getSchedulerLockStats(uint32_t coreId);
+
 bool
 isSchedulerEnabled();
 
@@ -83,10 +100,12 @@ resumeThreadNoLock(OSThread *thread,
                    int32_t counter);
 
 void
-sleepThreadNoLock(OSThreadQueue *queue);
+sleepThreadNoLock(OSThreadQueue *queue,
+                  SchedulerBlockReason reason);
 
 void
-sleepThreadNoLock(OSThreadSimpleQueue *queue);
+sleepThreadNoLock(OSThreadSimpleQueue *queue,
+                  SchedulerBlockReason reason);
 
 void
 suspendThreadNoLock(OSThread *thread);
@@ -49,7 +49,7 @@ OSWaitSemaphore(OSSemaphore *semaphore)
 
    // Wait until we can decrease semaphore
    while (semaphore->count <= 0) {
-      internal::sleepThreadNoLock(&semaphore->queue);
+      internal::sleepThreadNoLock(&semaphore->queue, internal::SchedulerBlockReason::Semaphore);
       internal::rescheduleSelfNoLock();
    }
 
@@ -246,6 +246,12 @@ OSCreateThread(OSThread *thread,
                int32_t priority,
                OSThreadAttributes attributes)
 {
+   // The scheduler has one run queue for each priority from -1 to 32
+   if (priority < -1 || priority > 32) {
+      gLog->warn("OSCreateThread called with invalid priority {}", priority);
+      return FALSE;
+   }
+
    // If no affinity is defined, we need to copy the affinity from the calling thread
    if ((attributes & OSThreadAttributes::AffinityAny) == 0) {
       auto curAttr = internal::getCurrentThread()->attr;
@@ -510,7 +516,7 @@ OSJoinThread(OSThread *thread,
    // If the thread has not ended, let's wait for it
    //  note only one thread is allowed in the join queue
    if (thread->state != OSThreadState::Moribund && !thread->joinQueue.head) {
-      internal::sleepThreadNoLock(&thread->joinQueue);
+      internal::sleepThreadNoLock(&thread->joinQueue, internal::SchedulerBlockReason::Join);
       internal::rescheduleSelfNoLock();
 
       if (!internal::isThreadActiveNoLock(thread)) {
@@ -804,7 +810,7 @@ void
 OSSleepThread(OSThreadQueue *queue)
 {
    internal::lockScheduler();
-   internal::sleepThreadNoLock(queue);
+   internal::sleepThreadNoLock(queue, internal::SchedulerBlockReason::ThreadQueue);
    internal::rescheduleSelfNoLock();
    internal::unlockScheduler();
 }
@@ -835,7 +841,7 @@ OSSleepTicks(OSTime ticks)
    internal::lockScheduler();
    internal::setAlarmInternal(alarm, ticks, sSleepAlarmHandler, OSGetCurrentThread());
 
-   internal::sleepThreadNoLock(queue);
+   internal::sleepThreadNoLock(queue, internal::SchedulerBlockReason::Delay);
    internal::rescheduleSelfNoLock();
 
    internal::unlockScheduler();
@@ -881,7 +887,7 @@ OSSuspendThread(OSThread *thread)
       } else {
          thread->needSuspend++;
          thread->requestFlag = OSThreadRequest::Suspend;
-         internal::sleepThreadNoLock(&thread->suspendQueue);
+         internal::sleepThreadNoLock(&thread->suspendQueue, internal::SchedulerBlockReason::Suspend);
          internal::rescheduleSelfNoLock();
          result = thread->suspendResult;
       }
@@ -1002,7 +1008,7 @@ DeallocatorThreadEntry(uint32_t coreId, void *arg2)
 
       if (!thread) {
          internal::lockScheduler();
-         internal::sleepThreadNoLock(waitQueue);
+         internal::sleepThreadNoLock(waitQueue, internal::SchedulerBlockReason::ThreadQueue);
          internal::rescheduleSelfNoLock();
          internal::unlockScheduler();
          continue;
@@ -1032,13 +1038,13 @@ Module::registerThreadFunctions()
    RegisterKernelFunction(OSDetachThread);
    RegisterKernelFunction(OSExitThread);
    RegisterKernelFunction(OSGetActiveThreadLink);
-   RegisterKernelFunction(OSGetCurrentThread);
+   RegisterKernelFunctionFlags(OSGetCurrentThread, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
    RegisterKernelFunction(OSGetDefaultThread);
-   RegisterKernelFunction(OSGetStackPointer);
+   RegisterKernelFunctionFlags(OSGetStackPointer, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
    RegisterKernelFunction(OSGetThreadAffinity);
    RegisterKernelFunction(OSGetThreadName);
    RegisterKernelFunction(OSGetThreadPriority);
-   RegisterKernelFunction(OSGetThreadSpecific);
+   RegisterKernelFunctionFlags(OSGetThreadSpecific, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
    RegisterKernelFunction(OSInitThreadQueue);
    RegisterKernelFunction(OSInitThreadQueueEx);
    RegisterKernelFunction(OSIsThreadSuspended);
@@ -1054,7 +1060,7 @@ Module::registerThreadFunctions()
    RegisterKernelFunction(OSSetThreadName);
    RegisterKernelFunction(OSSetThreadPriority);
    RegisterKernelFunction(OSSetThreadRunQuantum);
-   RegisterKernelFunction(OSSetThreadSpecific);
+   RegisterKernelFunctionFlags(OSSetThreadSpecific, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
    RegisterKernelFunction(OSSetThreadStackUsage);
    RegisterKernelFunction(OSSleepThread);
    RegisterKernelFunction(OSSleepTicks);
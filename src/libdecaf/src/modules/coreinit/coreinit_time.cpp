@@ -144,10 +144,10 @@ Module::initialiseClock()
 void
 Module::registerTimeFunctions()
 {
-   RegisterKernelFunction(OSGetTime);
-   RegisterKernelFunction(OSGetTick);
-   RegisterKernelFunction(OSGetSystemTime);
-   RegisterKernelFunction(OSGetSystemTick);
+   RegisterKernelFunctionFlags(OSGetTime, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterKernelFunctionFlags(OSGetTick, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterKernelFunctionFlags(OSGetSystemTime, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
+   RegisterKernelFunctionFlags(OSGetSystemTick, cpu::KCFLAG_NO_RESCHEDULE | cpu::KCFLAG_ARGUMENTS_ONLY);
    RegisterKernelFunction(OSTicksToCalendarTime);
    RegisterKernelFunction(OSCalendarTimeToTicks);
 }
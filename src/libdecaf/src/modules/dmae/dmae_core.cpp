@@ -1,5 +1,8 @@
 #include "dmae.h"
+#include "gpu/gpu_memorytracker.h"
+#include "libcpu/mem.h"
 #include "modules/coreinit/coreinit_time.h"
+#include <common/byte_swap_copy.h>
 
 namespace dmae
 {
@@ -41,19 +44,13 @@ DMAECopyMem(void *dst, void *src, uint32_t numDwords, DMAEEndianSwapMode endian)
    if (endian == DMAEEndianSwapMode::None) {
       memcpy(dst, src, numDwords * 4);
    } else if (endian == DMAEEndianSwapMode::Swap8In16) {
-      auto dstWords = reinterpret_cast<uint16_t*>(dst);
-      auto srcWords = reinterpret_cast<uint16_t*>(src);
-      for (uint32_t i = 0; i < numDwords * 2; ++i) {
-         *dstWords++ = byte_swap(*srcWords++);
-      }
+      byte_swap_copy_16(dst, src, numDwords * 2);
    } else if (endian == DMAEEndianSwapMode::Swap8In32) {
-      auto dstDwords = reinterpret_cast<uint32_t*>(dst);
-      auto srcDwords = reinterpret_cast<uint32_t*>(src);
-      for (uint32_t i = 0; i < numDwords; ++i) {
-         *dstDwords++ = byte_swap(*srcDwords++);
-      }
+      byte_swap_copy_32(dst, src, numDwords);
    }
 
+   gpu::markMemoryWritten(mem::untranslate(dst), numDwords * 4);
+
    sLastTimeStamp = coreinit::OSGetTime();
    return sLastTimeStamp;
 }
@@ -69,6 +66,8 @@ DMAEFillMem(void *dst, uint32_t value, uint32_t numDwords)
       dstDwords[i] = dstValue;
    }
 
+   gpu::markMemoryWritten(mem::untranslate(dst), numDwords * 4);
+
    sLastTimeStamp = coreinit::OSGetTime();
    return sLastTimeStamp;
 }
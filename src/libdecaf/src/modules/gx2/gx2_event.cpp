@@ -163,7 +163,7 @@ GX2WaitTimeStamp(OSTime time)
    coreinit::internal::lockScheduler();
 
    while (sRetiredTimestamp.load(std::memory_order_acquire) < time) {
-      coreinit::internal::sleepThreadNoLock(sWaitTimeStampQueue);
+      coreinit::internal::sleepThreadNoLock(sWaitTimeStampQueue, coreinit::internal::SchedulerBlockReason::GpuTimeStamp);
       coreinit::internal::rescheduleSelfNoLock();
    }
 
@@ -279,7 +279,7 @@ FrameCallbackThreadEntry(uint32_t core_id, void *arg2)
 
    while (true) {
       coreinit::internal::lockScheduler();
-      coreinit::internal::sleepThreadNoLock(sFrameCallbackThreadQueue);
+      coreinit::internal::sleepThreadNoLock(sFrameCallbackThreadQueue, coreinit::internal::SchedulerBlockReason::ThreadQueue);
       coreinit::internal::rescheduleSelfNoLock();
       coreinit::internal::unlockScheduler();
 
@@ -0,0 +1,79 @@
+#include <hle_test.h>
+#include <coreinit/time.h>
+
+// Measures the round trip of a host to guest callback, MEMAllocFromAllocator
+//  does nothing but call back into the allocator functions we give it.
+
+#define CALLBACK_ITERATIONS 100000
+
+typedef struct MEMAllocator MEMAllocator;
+typedef void *(*MEMAllocatorAllocFn)(MEMAllocator *allocator, uint32_t size);
+typedef void (*MEMAllocatorFreeFn)(MEMAllocator *allocator, void *block);
+
+typedef struct MEMAllocatorFunctions
+{
+   MEMAllocatorAllocFn alloc;
+   MEMAllocatorFreeFn free;
+} MEMAllocatorFunctions;
+
+struct MEMAllocator
+{
+   MEMAllocatorFunctions *funcs;
+   void *heap;
+   uint32_t align;
+   uint32_t unk0x0c;
+};
+
+void *
+MEMAllocFromAllocator(MEMAllocator *allocator, uint32_t size);
+
+void
+MEMFreeToAllocator(MEMAllocator *allocator, void *block);
+
+int gAllocCount = 0;
+int gFreeCount = 0;
+uint8_t gBlock[64];
+
+void *
+countingAlloc(MEMAllocator *allocator, uint32_t size)
+{
+   gAllocCount++;
+   return gBlock;
+}
+
+void
+countingFree(MEMAllocator *allocator, void *block)
+{
+   gFreeCount++;
+}
+
+MEMAllocatorFunctions gFunctions = { countingAlloc, countingFree };
+
+int
+main(int argc, char **argv)
+{
+   MEMAllocator allocator;
+   OSTime start, end;
+   int i;
+
+   allocator.funcs = &gFunctions;
+   allocator.heap = NULL;
+   allocator.align = 0;
+   allocator.unk0x0c = 0;
+
+   start = OSGetTime();
+
+   for (i = 0; i < CALLBACK_ITERATIONS; ++i) {
+      void *block = MEMAllocFromAllocator(&allocator, sizeof(gBlock));
+      test_assert(block == gBlock);
+      MEMFreeToAllocator(&allocator, block);
+   }
+
+   end = OSGetTime();
+
+   test_assert(gAllocCount == CALLBACK_ITERATIONS);
+   test_assert(gFreeCount == CALLBACK_ITERATIONS);
+   test_report("%d callback round trips took %d us",
+               CALLBACK_ITERATIONS * 2, (int)OSTicksToMicroseconds(end - start));
+   return 0;
+}
@@ -0,0 +1,90 @@
+#include <hle_test.h>
+#include <coreinit/time.h>
+#include <string.h>
+
+// Times the libc routines statically linked into this RPL, run once as is and
+//  once with --redirect-libc to compare the guest code on the JIT against the
+//  host implementations.
+
+#define STRING_ITERATIONS 20000
+#define BLOCK_ITERATIONS 2000
+#define BLOCK_SIZE 0x4000
+
+char gString[256];
+uint8_t gSource[BLOCK_SIZE];
+uint8_t gDest[BLOCK_SIZE];
+
+int
+main(int argc, char **argv)
+{
+   OSTime start, end;
+   size_t length = 0;
+   int i;
+
+   for (i = 0; i < sizeof(gString) - 1; ++i) {
+      gString[i] = 'a' + (i % 26);
+   }
+
+   gString[sizeof(gString) - 1] = 0;
+
+   for (i = 0; i < BLOCK_SIZE; ++i) {
+      gSource[i] = (uint8_t)i;
+   }
+
+   start = OSGetTime();
+
+   for (i = 0; i < STRING_ITERATIONS; ++i) {
+      length += strlen(gString);
+   }
+
+   end = OSGetTime();
+   test_assert(length == STRING_ITERATIONS * (sizeof(gString) - 1));
+   test_report("%d strlen took %d us", STRING_ITERATIONS, (int)OSTicksToMicroseconds(end - start));
+
+   start = OSGetTime();
+
+   for (i = 0; i < BLOCK_ITERATIONS; ++i) {
+      memcpy(gDest, gSource, BLOCK_SIZE);
+   }
+
+   end = OSGetTime();
+   test_assert(memcmp(gDest, gSource, BLOCK_SIZE) == 0);
+   test_report("%d memcpy of %d bytes took %d us", BLOCK_ITERATIONS, BLOCK_SIZE, (int)OSTicksToMicroseconds(end - start));
+
+   start = OSGetTime();
+
+   for (i = 0; i < BLOCK_ITERATIONS; ++i) {
+      memmove(gDest + 1, gDest, BLOCK_SIZE - 1);
+   }
+
+   end = OSGetTime();
+   test_assert(gDest[BLOCK_ITERATIONS] == gSource[0]);
+   test_report("%d overlapping memmove of %d bytes took %d us", BLOCK_ITERATIONS, BLOCK_SIZE - 1, (int)OSTicksToMicroseconds(end - start));
+
+   start = OSGetTime();
+
+   for (i = 0; i < BLOCK_ITERATIONS; ++i) {
+      memset(gDest, 0, BLOCK_SIZE);
+   }
+
+   end = OSGetTime();
+   test_assert(gDest[0] == 0 && gDest[BLOCK_SIZE - 1] == 0);
+   test_report("%d memset of %d bytes took %d us", BLOCK_ITERATIONS, BLOCK_SIZE, (int)OSTicksToMicroseconds(end - start));
+
+   start = OSGetTime();
+
+   for (i = 0; i < BLOCK_ITERATIONS; ++i) {
+      uint32_t *src = (uint32_t *)gSource;
+      uint32_t *dst = (uint32_t *)gDest;
+      int j;
+
+      for (j = 0; j < BLOCK_SIZE / 4; ++j) {
+         dst[j] = __builtin_bswap32(src[j]);
+      }
+   }
+
+   end = OSGetTime();
+   test_assert(gDest[0] == gSource[3]);
+   test_report("%d byte swap copies of %d bytes took %d us", BLOCK_ITERATIONS, BLOCK_SIZE, (int)OSTicksToMicroseconds(end - start));
+   return 0;
+}
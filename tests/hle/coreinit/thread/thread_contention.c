@@ -0,0 +1,90 @@
+#include <hle_test.h>
+#include <coreinit/core.h>
+#include <coreinit/event.h>
+#include <coreinit/mutex.h>
+#include <coreinit/systeminfo.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+
+// Keeps all three cores busy with scheduler heavy operations so that
+//  changes to scheduler locking can be compared by the time taken.
+
+#define MUTEX_ITERATIONS 20000
+#define EVENT_ITERATIONS 5000
+
+OSMutex gMutex;
+OSEvent gPingEvent[3];
+OSEvent gPongEvent[3];
+OSThread gPongThread[3];
+uint8_t gPongThreadStack[3][4096];
+int gCounter = 0;
+
+int
+pongThreadEntry(int argc, const char **argv)
+{
+   int i;
+
+   for (i = 0; i < EVENT_ITERATIONS; ++i) {
+      OSWaitEvent(&gPingEvent[argc]);
+      OSSignalEvent(&gPongEvent[argc]);
+   }
+
+   return 0;
+}
+
+int
+coreEntryPoint(int argc, const char **argv)
+{
+   int i;
+
+   // Every core fights over the same mutex
+   for (i = 0; i < MUTEX_ITERATIONS; ++i) {
+      OSLockMutex(&gMutex);
+      gCounter++;
+      OSUnlockMutex(&gMutex);
+   }
+
+   // Every core ping-pongs with a thread of its own
+   OSCreateThread(&gPongThread[argc], pongThreadEntry, argc, NULL,
+                  gPongThreadStack[argc] + 4096, 4096, 16,
+                  1 << argc);
+   OSResumeThread(&gPongThread[argc]);
+
+   for (i = 0; i < EVENT_ITERATIONS; ++i) {
+      OSSignalEvent(&gPingEvent[argc]);
+      OSWaitEvent(&gPongEvent[argc]);
+   }
+
+   OSJoinThread(&gPongThread[argc], NULL);
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   OSThread *threadCore0 = OSGetDefaultThread(0);
+   OSThread *threadCore2 = OSGetDefaultThread(2);
+   OSTime start, end;
+   int i;
+
+   test_assert(OSGetCoreId() == 1);
+   OSInitMutex(&gMutex);
+
+   for (i = 0; i < 3; ++i) {
+      OSInitEvent(&gPingEvent[i], FALSE, OS_EVENT_MODE_AUTO);
+      OSInitEvent(&gPongEvent[i], FALSE, OS_EVENT_MODE_AUTO);
+   }
+
+   start = OSGetTime();
+   OSRunThread(threadCore0, coreEntryPoint, 0, NULL);
+   OSRunThread(threadCore2, coreEntryPoint, 2, NULL);
+   coreEntryPoint(1, NULL);
+
+   OSJoinThread(threadCore0, NULL);
+   OSJoinThread(threadCore2, NULL);
+   end = OSGetTime();
+
+   test_assert(gCounter == MUTEX_ITERATIONS * 3);
+   test_report("Scheduler contention took %d us", (int)OSTicksToMicroseconds(end - start));
+   return 0;
+}
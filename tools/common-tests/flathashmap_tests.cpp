@@ -0,0 +1,139 @@
+#include "tests.h"
+#include "common/flathashmap.h"
+#include <memory>
+
+// Sends every key to the same bucket so the entries form one probe sequence
+struct CollidingHash
+{
+   uint64_t operator()(uint64_t) const
+   {
+      return 0;
+   }
+};
+
+static void
+testMissingKeys()
+{
+   FlatHashMap<uint64_t, int> map;
+   test_check(map.find(1) == nullptr);
+   test_check(!map.erase(1));
+   test_check(map.empty());
+
+   map[1] = 10;
+   map[2] = 20;
+   test_check(map.find(3) == nullptr);
+   test_check(map.find(1ull << 40) == nullptr);
+   test_check(map.size() == 2);
+}
+
+static void
+testGrowth()
+{
+   FlatHashMap<uint64_t, uint64_t> map;
+   const uint64_t count = 5000;
+
+   // Keys are built like our resource keys, an address in the high bits
+   for (auto i = 0ull; i < count; ++i) {
+      map[i << 32] = i;
+   }
+
+   test_check(map.size() == count);
+
+   auto found = 0ull;
+
+   for (auto i = 0ull; i < count; ++i) {
+      auto value = map.find(i << 32);
+
+      if (value && *value == i) {
+         ++found;
+      }
+   }
+
+   test_check(found == count);
+
+   auto iterated = 0ull;
+
+   for (auto &entry : map) {
+      test_check(entry.second == (entry.first >> 32));
+      ++iterated;
+   }
+
+   test_check(iterated == count);
+
+   // Looking up an existing key does not insert a new one
+   map[0] = 1234;
+   test_check(map.size() == count);
+   test_check(*map.find(0) == 1234);
+}
+
+static void
+testTombstones()
+{
+   FlatHashMap<uint64_t, int, CollidingHash> map;
+
+   for (auto i = 0; i < 8; ++i) {
+      map[i] = i * 10;
+   }
+
+   // Erasing from the middle of the probe sequence must not hide the keys
+   //  after it
+   test_check(map.erase(3));
+   test_check(!map.erase(3));
+   test_check(map.size() == 7);
+   test_check(map.find(3) == nullptr);
+
+   for (auto i = 4; i < 8; ++i) {
+      auto value = map.find(i);
+      test_check(value && *value == i * 10);
+   }
+
+   // A new key reuses the tombstone, the old key comes back empty
+   map[100] = 1000;
+   test_check(map.size() == 8);
+   test_check(*map.find(100) == 1000);
+   test_check(map[3] == 0);
+   test_check(map.size() == 9);
+
+   // Repeated insert and erase fills the table with tombstones, which have
+   //  to be cleaned up for probing to keep terminating
+   for (auto i = 1000; i < 20000; ++i) {
+      map[i] = i;
+      test_check(map.erase(i));
+   }
+
+   test_check(map.size() == 9);
+
+   for (auto i = 0; i < 8; ++i) {
+      test_check(map.find(i) != nullptr);
+   }
+
+   auto iterated = 0;
+
+   for (auto &entry : map) {
+      (void)entry;
+      ++iterated;
+   }
+
+   test_check(iterated == 9);
+}
+
+static void
+testEraseReleasesValue()
+{
+   FlatHashMap<uint64_t, std::shared_ptr<int>> map;
+   auto value = std::make_shared<int>(1);
+
+   map[1] = value;
+   test_check(value.use_count() == 2);
+   test_check(map.erase(1));
+   test_check(value.use_count() == 1);
+}
+
+void
+testFlatHashMap()
+{
+   testMissingKeys();
+   testGrowth();
+   testTombstones();
+   testEraseReleasesValue();
+}
@@ -0,0 +1,18 @@
+#include "tests.h"
+
+int gFailedChecks = 0;
+
+int
+main(int argc, char **argv)
+{
+   testFlatHashMap();
+   testRingAllocator();
+
+   if (gFailedChecks) {
+      std::cout << gFailedChecks << " checks failed" << std::endl;
+      return -1;
+   }
+
+   std::cout << "All checks passed" << std::endl;
+   return 0;
+}
@@ -0,0 +1,128 @@
+#include "tests.h"
+#include "common/ringallocator.h"
+
+static void
+testAlignment()
+{
+   RingAllocator ring { 1024, 256 };
+   RingAllocator::Allocation a, b;
+
+   test_check(ring.allocate(1, a));
+   test_check(a.offset == 0);
+   test_check(a.size == 256);
+   test_check(a.consumed == 256);
+
+   test_check(ring.allocate(300, b));
+   test_check(b.offset == 256);
+   test_check(b.size == 512);
+   test_check(ring.getUsedSize() == 768);
+
+   // Empty and oversized allocations always fail
+   RingAllocator::Allocation c;
+   test_check(!ring.allocate(0, c));
+   test_check(!ring.allocate(2048, c));
+}
+
+static void
+testFullRing()
+{
+   RingAllocator ring { 1024, 256 };
+   RingAllocator::Allocation a, b;
+
+   // Allocating exactly up to the end wraps the head back to the start
+   test_check(ring.allocate(1024, a));
+   test_check(a.offset == 0);
+   test_check(ring.getUsedSize() == 1024);
+   test_check(!ring.allocate(256, b));
+
+   ring.release(a);
+   test_check(ring.getUsedSize() == 0);
+   test_check(ring.allocate(256, b));
+   test_check(b.offset == 0);
+}
+
+static void
+testWrapAround()
+{
+   RingAllocator ring { 1024, 256 };
+   RingAllocator::Allocation a, b, c, d;
+
+   test_check(ring.allocate(512, a));
+   test_check(ring.allocate(256, b));
+   test_check(b.offset == 512);
+
+   // There is no room at the end or the start until a is released
+   test_check(!ring.allocate(512, c));
+   ring.release(a);
+
+   // c does not fit in the 256 bytes left at the end, so it wraps to the
+   //  start and the skipped end of the ring is charged to it
+   test_check(ring.allocate(512, c));
+   test_check(c.offset == 0);
+   test_check(c.consumed == 768);
+   test_check(ring.getUsedSize() == 1024);
+   test_check(!ring.allocate(256, d));
+
+   // Releasing b frees the space between c and the skipped end
+   ring.release(b);
+   test_check(ring.getUsedSize() == 768);
+   test_check(ring.allocate(256, d));
+   test_check(d.offset == 512);
+   test_check(!ring.allocate(256, a));
+
+   // Releasing c gives back both its own space and the skipped end
+   ring.release(c);
+   test_check(ring.getUsedSize() == 256);
+   test_check(ring.allocate(256, a));
+   test_check(a.offset == 768);
+
+   ring.release(d);
+   ring.release(a);
+   test_check(ring.getUsedSize() == 0);
+}
+
+static void
+testReclaimInOrder()
+{
+   RingAllocator ring { 4096, 256 };
+   RingAllocator::Allocation inFlight[4];
+   RingAllocator::Allocation next;
+
+   // Keep a window of four allocations in flight and retire the oldest
+   //  every time, like staged uploads waiting on fences, the ring must
+   //  never run out of space or hand out overlapping ranges.
+   for (auto i = 0u; i < 4; ++i) {
+      test_check(ring.allocate(768, inFlight[i]));
+   }
+
+   for (auto i = 0u; i < 64; ++i) {
+      auto &oldest = inFlight[i % 4];
+      ring.release(oldest);
+      test_check(ring.allocate(768, next));
+
+      for (auto j = 0u; j < 4; ++j) {
+         if (j != i % 4) {
+            auto &other = inFlight[j];
+            test_check(next.offset + next.size <= other.offset
+                       || other.offset + other.size <= next.offset);
+         }
+      }
+
+      oldest = next;
+   }
+
+   for (auto i = 0u; i < 4; ++i) {
+      ring.release(inFlight[(64 + i) % 4]);
+   }
+
+   test_check(ring.getUsedSize() == 0);
+}
+
+void
+testRingAllocator()
+{
+   testAlignment();
+   testFullRing();
+   testWrapAround();
+   testReclaimInOrder();
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <iostream>
+
+// Number of checks which have failed so far
+extern int gFailedChecks;
+
+#define test_check(x) \
+   if (!(x)) { \
+      std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " << #x << std::endl; \
+      ++gFailedChecks; \
+   }
+
+void
+testFlatHashMap();
+
+void
+testRingAllocator();
@@ -0,0 +1,66 @@
+#include "common/platform_fiber.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// Measures how quickly we can switch between two fibers, which bounds how
+//  quickly the emulated kernel can switch between guest threads.
+
+static platform::Fiber *
+sMainFiber = nullptr;
+
+static platform::Fiber *
+sPingFiber = nullptr;
+
+static platform::Fiber *
+sPongFiber = nullptr;
+
+static uint64_t
+sSwitchesRemaining = 0;
+
+static void
+pingEntry(void *)
+{
+   // Each iteration switches to pong and back again
+   while (sSwitchesRemaining >= 2) {
+      sSwitchesRemaining -= 2;
+      platform::swapToFiber(sPingFiber, sPongFiber);
+   }
+
+   platform::swapToFiber(sPingFiber, sMainFiber);
+}
+
+static void
+pongEntry(void *)
+{
+   while (true) {
+      platform::swapToFiber(sPongFiber, sPingFiber);
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   auto numSwitches = uint64_t { 10000000 };
+
+   if (argc > 1) {
+      numSwitches = std::strtoull(argv[1], nullptr, 0);
+   }
+
+   sMainFiber = platform::getThreadFiber();
+   sPingFiber = platform::createFiber(pingEntry, nullptr);
+   sPongFiber = platform::createFiber(pongEntry, nullptr);
+   sSwitchesRemaining = numSwitches;
+
+   auto start = std::chrono::high_resolution_clock::now();
+   platform::swapToFiber(sMainFiber, sPingFiber);
+   auto end = std::chrono::high_resolution_clock::now();
+
+   auto seconds = std::chrono::duration<double>(end - start).count();
+   std::cout << numSwitches << " fiber switches in " << seconds << "s, "
+             << static_cast<uint64_t>(numSwitches / seconds) << " switches per second" << std::endl;
+
+   platform::destroyFiber(sPingFiber);
+   platform::destroyFiber(sPongFiber);
+   return 0;
+}
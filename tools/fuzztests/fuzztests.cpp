@@ -1,32 +1,125 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
 #include <random>
 #include <string>
+#include <thread>
 #include "fuzztests.h"
 #include "common/bitutils.h"
+#include "common/decaf_assert.h"
 #include "common/log.h"
 #include "libcpu/src/interpreter/interpreter.h"
 #include "libcpu/src/interpreter/interpreter_insreg.h"
 #include "libcpu/src/jit/jit.h"
 #include "libcpu/state.h"
-#include "libcpu/src/utils.h"
 #include "libcpu/mem.h"
-#include "libcpu/trace.h"
+#include "libcpu/espresso/espresso_disassembler.h"
 #include "libcpu/espresso/espresso_instructionset.h"
 #include "libcpu/espresso/espresso_spr.h"
+#include <spdlog/fmt/fmt.h>
 using namespace espresso;
 
 template<size_t SIZE, class T> inline size_t array_size(T (&arr)[SIZE]) {
    return SIZE;
 }
 
+/*
+ * Every case is a short random sequence of instructions which is run once
+ * through the interpreter and once through the JIT, starting from the same
+ * randomised registers and scratch memory, and the results compared.
+ *
+ * Cases run in parallel on as many host threads as we like.  Each thread
+ * has its own cpu::Core and its own window of scratch memory, and every case
+ * in a batch is written to its own slot of code so the JIT never sees two
+ * different sequences at the same address.  The JIT cache is cleared between
+ * batches, when no thread is running guest code.
+ */
+
+// Code for each case in a batch, a case is at most MaxSequenceLength
+//  instructions of up to five words each plus the return.
+static const uint32_t CodeBase = mem::MEM2Base;
+static const uint32_t CodeSlotSize = 0x400;
+static const uint32_t BatchSize = 0x8000;
+
+// Scratch memory for each worker thread, memory instructions are steered
+//  into the middle of the window so even lmw and stmw stay within it.
+static const uint32_t DataBase = mem::MEM2Base + 0x04000000;
+static const uint32_t ScratchSize = 0x400;
+static const uint32_t ScratchTargetStart = 0x100;
+static const uint32_t ScratchTargetEnd = 0x300;
+
+static const unsigned MaxWorkers = 256;
+static const unsigned MaxSequenceLength = 32;
+
+// Registers which instructions are allowed to use, kept small so that
+//  instructions in a sequence depend on each other.
+static const uint32_t GprPool[] = { 0, 3, 4, 5, 6, 7, 8, 9, 10 };
+static const uint32_t AddressGprPool[] = { 3, 4, 5, 6, 7, 8, 9, 10 };
+static const uint32_t FprPool[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+// How to generate the value of each instruction field
+enum class FieldKind
+{
+   Marker,
+   Gpr,
+   Fpr,
+   Spr,
+   Random,
+   Zero,
+   Unsupported,
+};
+
+enum class AddressMode
+{
+   None,
+   D,
+   QD,
+   X,
+};
+
 struct InstructionFuzzData {
+   bool fuzzable = false;
    uint32_t baseInstr;
    std::vector<InstructionField> allFields;
 };
 
-static const uint32_t instructionBase = mem::MEM2Base;
-static const uint32_t dataBase = instructionBase + 0x01000000;
-std::vector<InstructionFuzzData> instructionFuzzData;
+struct FuzzInstruction
+{
+   InstructionID id;
+
+   //! Setup instructions for the address registers followed by the instruction
+   std::vector<uint32_t> words;
+};
+
+struct FuzzCase
+{
+   uint32_t seed;
+   uint32_t dataAddress;
+   std::vector<FuzzInstruction> sequence;
+   cpu::CoreRegs state;
+   std::array<uint8_t, ScratchSize> memory;
+};
+
+struct FuzzResult
+{
+   cpu::CoreRegs state;
+   std::array<uint8_t, ScratchSize> memory;
+};
+
+static std::array<FieldKind, static_cast<size_t>(InstructionField::FieldCount)>
+sFieldKinds;
+
+static std::vector<InstructionFuzzData>
+instructionFuzzData;
+
+static std::vector<InstructionID>
+sInstructionPool;
+
+static std::atomic<uint32_t>
+sNextCodeSlot;
 
 bool buildFuzzData(InstructionID instrId, InstructionFuzzData &fuzzData)
 {
@@ -101,427 +194,862 @@ bool buildFuzzData(InstructionID instrId, InstructionFuzzData &fuzzData)
       return false;
    }
 
+   fuzzData.fuzzable = hasInterpHandler;
    fuzzData.baseInstr = instr;
    fuzzData.allFields = std::move(allFields);
-   return true;
-}
 
-bool
-setupFuzzData() {
-   instructionFuzzData.resize((size_t)InstructionID::InstructionCount);
-   bool res = true;
-   for (int i = 0; i < (int)InstructionID::InstructionCount; ++i) {
-      res &= buildFuzzData((InstructionID)i, instructionFuzzData[i]);
+   for (auto i : fuzzData.allFields) {
+      if (sFieldKinds[static_cast<size_t>(i)] == FieldKind::Unsupported) {
+         fuzzData.fuzzable = false;
+      }
    }
-   return res;
-}
 
-void setFieldValue(Instruction &instr, InstructionField field, uint32_t value) {
-   instr.value |= (value << getInstructionFieldStart(field)) & getInstructionFieldBitmask(field);
+   return true;
 }
 
-bool
-compareStateField(int field, const TraceFieldValue &x, const TraceFieldValue &y)
+/**
+ * Every field in espresso_instruction_fields.inl gets a random value of its
+ * width unless we know better, reserved fields are left as zero.
+ */
+static void
+setupFieldKinds()
 {
-   if (field >= StateField::FPR0 && field <= StateField::FPR31) {
-      return fabs(x.f64v0 - y.f64v0) < 0.0001 && fabs(x.f64v1 - y.f64v1) < 0.0001;
+   static const FieldKind defaultKinds[] = {
+      FieldKind::Unsupported,
+#define FLD(x, ...) FieldKind::Random,
+#define MRKR(x, ...) FieldKind::Marker,
+#include "libcpu/espresso/espresso_instruction_fields.inl"
+#undef FLD
+#undef MRKR
+   };
+
+   static_assert(sizeof(defaultKinds) / sizeof(defaultKinds[0]) == static_cast<size_t>(InstructionField::FieldCount),
+                 "Every instruction field must have a default kind");
+
+   for (auto i = 1u; i < sFieldKinds.size(); ++i) {
+      auto field = static_cast<InstructionField>(i);
+      sFieldKinds[i] = defaultKinds[i];
+
+      if (sFieldKinds[i] == FieldKind::Random && getInstructionFieldName(field)[0] == '_') {
+         sFieldKinds[i] = FieldKind::Zero;
+      }
    }
-   return x.u64v0 == y.u64v0 && x.u64v1 == y.u64v1;
-}
 
-bool
-compareStateField(int field, const TraceFieldValue &x, const TraceFieldValue &y, const TraceFieldValue &m, bool neg = false)
-{
-   if (field >= StateField::FPR0 && field <= StateField::FPR31) {
-      uint64_t xa = x.u64v0 & m.u64v0;
-      uint64_t xb = x.u64v1 & m.u64v1;
-      uint64_t ya = y.u64v0 & m.u64v0;
-      uint64_t yb = y.u64v1 & m.u64v1;
-      return (*(double*)&xa) == (*(double*)&ya) && (*(double*)&xb) == (*(double*)&yb);
-   }
-
-   return (x.u32v0 & m.u32v0) == (y.u32v0 & m.u32v0) &&
-      (x.u32v0 & m.u32v1) == (y.u32v0 & m.u32v1) &&
-      (x.u32v0 & m.u32v2) == (y.u32v0 & m.u32v2) &&
-      (x.u32v0 & m.u32v3) == (y.u32v0 & m.u32v3);
+   sFieldKinds[static_cast<size_t>(InstructionField::Invalid)] = FieldKind::Unsupported;
+
+   for (auto field : { InstructionField::rA, InstructionField::rB, InstructionField::rD, InstructionField::rS }) {
+      sFieldKinds[static_cast<size_t>(field)] = FieldKind::Gpr;
+   }
+
+   for (auto field : { InstructionField::frA, InstructionField::frB, InstructionField::frC, InstructionField::frD, InstructionField::frS }) {
+      sFieldKinds[static_cast<size_t>(field)] = FieldKind::Fpr;
+   }
+
+   sFieldKinds[static_cast<size_t>(InstructionField::spr)] = FieldKind::Spr;
+
+   // cmp and friends require l to be 0
+   sFieldKinds[static_cast<size_t>(InstructionField::l)] = FieldKind::Zero;
+
+   // Branches, kernel calls and time base reads cannot be compared
+   for (auto field : { InstructionField::aa, InstructionField::bd, InstructionField::bi, InstructionField::bo,
+                       InstructionField::kcn, InstructionField::li, InstructionField::lk, InstructionField::tbr }) {
+      sFieldKinds[static_cast<size_t>(field)] = FieldKind::Unsupported;
+   }
 }
 
-bool
-executeInstrTest(uint32_t test_seed)
+static bool
+isFuzzableInstruction(InstructionID instrId,
+                      const FuzzOptions &options)
 {
-   std::mt19937 test_rand(test_seed);
-   InstructionID instrId = (InstructionID)(test_rand() % (int)InstructionID::InstructionCount);
-
-   // Special cases that we can't test easily
    switch (instrId) {
    case InstructionID::Invalid:
-      return true;
-   case InstructionID::lmw:
+      return false;
    case InstructionID::lswi:
    case InstructionID::lswx:
-   case InstructionID::stmw:
    case InstructionID::stswi:
    case InstructionID::stswx:
-      // Multi-word logic, disabled for now
-      return true;
-   case InstructionID::psq_l:
-   case InstructionID::psq_lu:
-   case InstructionID::psq_lux:
-   case InstructionID::psq_lx:
-   case InstructionID::psq_st:
-   case InstructionID::psq_stu:
-   case InstructionID::psq_stux:
-   case InstructionID::psq_stx:
-      // Quantization Registers need to be properly configured for these, disabled for now
-      return true;
+      // String logic wraps around the register file, disabled for now
+      return false;
+   case InstructionID::lwarx:
+   case InstructionID::stwcx:
+      // Reservations are not repeatable
+      return false;
    case InstructionID::b:
    case InstructionID::bc:
    case InstructionID::bcctr:
    case InstructionID::bclr:
+   case InstructionID::rfi:
       // Branching cannot be fuzzed
-      return true;
+      return false;
    case InstructionID::kc:
       // Emulator Instruction
-      return true;
+      return false;
+   case InstructionID::mftb:
+      // The time base moves between the two runs
+      return false;
+   case InstructionID::mcrfs:
+   case InstructionID::mffs:
+      // These read FPSCR, which the JIT does not fully maintain
+      return options.checkFpscr;
    case InstructionID::sc:
    case InstructionID::tw:
    case InstructionID::twi:
+   case InstructionID::mfmsr:
+   case InstructionID::mtmsr:
    case InstructionID::mfsr:
    case InstructionID::mfsrin:
    case InstructionID::mtsr:
    case InstructionID::mtsrin:
+   case InstructionID::tlbie:
+   case InstructionID::tlbsync:
+   case InstructionID::eciwx:
+   case InstructionID::ecowx:
       // Supervisory Instructions
-      return true;
+      return false;
    default:
-      break;
+      return true;
    }
+}
 
-   const auto data = findInstructionInfo(instrId);
-   const InstructionFuzzData *fuzzData = &instructionFuzzData[(int)instrId];
-   if (!data || !fuzzData) {
-      return false;
+bool
+setupFuzzData(const FuzzOptions &options)
+{
+   setupFieldKinds();
+
+   instructionFuzzData.resize((size_t)InstructionID::InstructionCount);
+   bool res = true;
+   for (int i = 0; i < (int)InstructionID::InstructionCount; ++i) {
+      res &= buildFuzzData((InstructionID)i, instructionFuzzData[i]);
    }
 
-   if (!cpu::interpreter::hasInstruction(instrId)) {
-      // No handler, skip it...
-      return true;
+   if (!res) {
+      return false;
    }
 
-   Instruction instr(fuzzData->baseInstr);
+   sInstructionPool.clear();
 
-   {
-      // TODO: Add handling for rA==0 being 0 :S
-      uint32_t gprAlloc = 0;
-      uint32_t fprAlloc = 0;
-      uint32_t gqrAlloc = 0;
-      static const uint32_t gprAllocatable[] = { 5, 6, 7, 8, 9 };
-      static const uint32_t fprAllocatable[] = { 0, 1, 2, 3 };
-      static const uint32_t gqrAllocatable[] = { 0, 1, 2, 3 };
-      auto nextGpr = [&]() {
-         assert(gprAlloc < array_size(gprAllocatable));
-         return gprAllocatable[gprAlloc++];
-      };
-      auto nextFpr = [&]() {
-         assert(fprAlloc < array_size(fprAllocatable));
-         return fprAllocatable[fprAlloc++];
-      };
-      auto nextGqr = [&]() {
-         assert(gqrAlloc < array_size(gqrAllocatable));
-         return gqrAllocatable[gqrAlloc++];
-      };
-      for (auto i : fuzzData->allFields) {
-         if (isInstructionFieldMarker(i)) {
+   for (int i = 0; i < (int)InstructionID::InstructionCount; ++i) {
+      auto instrId = static_cast<InstructionID>(i);
+
+      if (!instructionFuzzData[i].fuzzable || !isFuzzableInstruction(instrId, options)) {
+         continue;
+      }
+
+      if (!options.instructions.empty()) {
+         auto name = findInstructionInfo(instrId)->name;
+
+         if (std::find(options.instructions.begin(), options.instructions.end(), name) == options.instructions.end()) {
             continue;
          }
+      }
 
-         switch (i) {
-         case InstructionField::rA: // gpr Targets
-         case InstructionField::rB:
-         case InstructionField::rD:
-         case InstructionField::rS:
-            setFieldValue(instr, i, nextGpr());
-            break;
-         case InstructionField::frA: // fpr Targets
-         case InstructionField::frB:
-         case InstructionField::frC:
-         case InstructionField::frD:
-         case InstructionField::frS:
-            setFieldValue(instr, i, nextFpr());
-            break;
-         case InstructionField::i: // gqr Targets
-         case InstructionField::qi:
-            setFieldValue(instr, i, test_rand() & 4);
-         case InstructionField::crbA: // crb Targets
-         case InstructionField::crbB:
-         case InstructionField::crbD:
-            setFieldValue(instr, i, test_rand());
-            break;
-         case InstructionField::crfD: // crf Targets
-         case InstructionField::crfS:
-            setFieldValue(instr, i, test_rand());
-            break;
-         case InstructionField::imm: // Random Values
-         case InstructionField::simm:
-         case InstructionField::uimm:
-         case InstructionField::rc: // Record Condition
-         case InstructionField::frc:
-         case InstructionField::oe:
-         case InstructionField::crm:
-         case InstructionField::fm:
-         case InstructionField::w:
-         case InstructionField::qw:
-         case InstructionField::sh: // Shift Registers
-         case InstructionField::mb:
-         case InstructionField::me:
-            setFieldValue(instr, i, test_rand());
-            break;
-         case InstructionField::d: // Memory Delta...
-         case InstructionField::qd:
-            setFieldValue(instr, i, test_rand());
-            break;
-         case InstructionField::spr: // Special Purpose Registers
-         {
-            SPR validSprs[] = {
-               SPR::XER,
-               SPR::CTR,
-               SPR::GQR0,
-               SPR::GQR1,
-               SPR::GQR2,
-               SPR::GQR3,
-               SPR::GQR4,
-               SPR::GQR5,
-               SPR::GQR6,
-               SPR::GQR7
-            };
-            encodeSPR(instr, validSprs[test_rand() % array_size(validSprs)]);
-            break;
-         }
-         case InstructionField::tbr: // Time Base Registers
-         {
-            SPR validTbrs[] = {
-               SPR::TBL,
-               SPR::TBU
-            };
-            encodeSPR(instr, validTbrs[test_rand() % array_size(validTbrs)]);
-            break;
+      sInstructionPool.push_back(instrId);
+   }
+
+   if (sInstructionPool.empty()) {
+      gLog->error("No instructions left to fuzz");
+      return false;
+   }
+
+   return true;
+}
+
+void setFieldValue(Instruction &instr, InstructionField field, uint32_t value) {
+   instr.value &= ~getInstructionFieldBitmask(field);
+   instr.value |= (value << getInstructionFieldStart(field)) & getInstructionFieldBitmask(field);
+}
+
+static AddressMode
+getAddressMode(InstructionID instrId)
+{
+   switch (instrId) {
+   case InstructionID::lbz:
+   case InstructionID::lbzu:
+   case InstructionID::lha:
+   case InstructionID::lhau:
+   case InstructionID::lhz:
+   case InstructionID::lhzu:
+   case InstructionID::lwz:
+   case InstructionID::lwzu:
+   case InstructionID::lfs:
+   case InstructionID::lfsu:
+   case InstructionID::lfd:
+   case InstructionID::lfdu:
+   case InstructionID::stb:
+   case InstructionID::stbu:
+   case InstructionID::sth:
+   case InstructionID::sthu:
+   case InstructionID::stw:
+   case InstructionID::stwu:
+   case InstructionID::stfs:
+   case InstructionID::stfsu:
+   case InstructionID::stfd:
+   case InstructionID::stfdu:
+   case InstructionID::lmw:
+   case InstructionID::stmw:
+      return AddressMode::D;
+   case InstructionID::psq_l:
+   case InstructionID::psq_lu:
+   case InstructionID::psq_st:
+   case InstructionID::psq_stu:
+      return AddressMode::QD;
+   case InstructionID::lbzx:
+   case InstructionID::lbzux:
+   case InstructionID::lhax:
+   case InstructionID::lhaux:
+   case InstructionID::lhzx:
+   case InstructionID::lhzux:
+   case InstructionID::lwzx:
+   case InstructionID::lwzux:
+   case InstructionID::lhbrx:
+   case InstructionID::lwbrx:
+   case InstructionID::lfsx:
+   case InstructionID::lfsux:
+   case InstructionID::lfdx:
+   case InstructionID::lfdux:
+   case InstructionID::stbx:
+   case InstructionID::stbux:
+   case InstructionID::sthx:
+   case InstructionID::sthux:
+   case InstructionID::stwx:
+   case InstructionID::stwux:
+   case InstructionID::sthbrx:
+   case InstructionID::stwbrx:
+   case InstructionID::stfsx:
+   case InstructionID::stfsux:
+   case InstructionID::stfdx:
+   case InstructionID::stfdux:
+   case InstructionID::stfiwx:
+   case InstructionID::psq_lx:
+   case InstructionID::psq_lux:
+   case InstructionID::psq_stx:
+   case InstructionID::psq_stux:
+   case InstructionID::dcbz:
+   case InstructionID::dcbz_l:
+      return AddressMode::X;
+   default:
+      return AddressMode::None;
+   }
+}
+
+// Integer loads with update are invalid when rD == rA
+static bool
+isIntegerLoadWithUpdate(InstructionID instrId)
+{
+   switch (instrId) {
+   case InstructionID::lbzu:
+   case InstructionID::lbzux:
+   case InstructionID::lhau:
+   case InstructionID::lhaux:
+   case InstructionID::lhzu:
+   case InstructionID::lhzux:
+   case InstructionID::lwzu:
+   case InstructionID::lwzux:
+      return true;
+   default:
+      return false;
+   }
+}
+
+// Emit lis and ori to load value into gpr
+static void
+emitLoadImmediate(std::vector<uint32_t> &words, uint32_t gpr, uint32_t value)
+{
+   auto lis = encodeInstruction(InstructionID::addis);
+   lis.rD = gpr;
+   lis.rA = 0;
+   lis.simm = value >> 16;
+   words.push_back(lis.value);
+
+   auto ori = encodeInstruction(InstructionID::ori);
+   ori.rA = gpr;
+   ori.rS = gpr;
+   ori.uimm = value & 0xFFFF;
+   words.push_back(ori.value);
+}
+
+static uint32_t
+randomGpr(std::mt19937 &rand)
+{
+   return GprPool[rand() % array_size(GprPool)];
+}
+
+static uint32_t
+randomFpr(std::mt19937 &rand)
+{
+   return FprPool[rand() % array_size(FprPool)];
+}
+
+static SPR
+randomSpr(std::mt19937 &rand, InstructionID instrId)
+{
+   // mtspr must not touch LR, which we return with, or write an invalid
+   //  quantisation type to a GQR
+   static const SPR mfsprs[] = {
+      SPR::XER, SPR::LR, SPR::CTR,
+      SPR::UGQR0, SPR::UGQR1, SPR::UGQR2, SPR::UGQR3,
+      SPR::UGQR4, SPR::UGQR5, SPR::UGQR6, SPR::UGQR7,
+   };
+   static const SPR mtsprs[] = {
+      SPR::XER, SPR::CTR,
+   };
+
+   if (instrId == InstructionID::mtspr) {
+      return mtsprs[rand() % array_size(mtsprs)];
+   } else {
+      return mfsprs[rand() % array_size(mfsprs)];
+   }
+}
+
+static bool
+generateInstruction(std::mt19937 &rand,
+                    InstructionID instrId,
+                    uint32_t dataAddress,
+                    FuzzInstruction &out)
+{
+   const auto &fuzzData = instructionFuzzData[static_cast<size_t>(instrId)];
+   Instruction instr(fuzzData.baseInstr);
+
+   for (auto field : fuzzData.allFields) {
+      switch (sFieldKinds[static_cast<size_t>(field)]) {
+      case FieldKind::Marker:
+      case FieldKind::Zero:
+         break;
+      case FieldKind::Gpr:
+         setFieldValue(instr, field, randomGpr(rand));
+         break;
+      case FieldKind::Fpr:
+         setFieldValue(instr, field, randomFpr(rand));
+         break;
+      case FieldKind::Spr:
+         encodeSPR(instr, randomSpr(rand, instrId));
+         break;
+      case FieldKind::Random:
+         setFieldValue(instr, field, rand());
+         break;
+      case FieldKind::Unsupported:
+         gLog->error("Instruction {} field {} is unsupported by fuzzer",
+                     findInstructionInfo(instrId)->name, getInstructionFieldName(field));
+         return false;
+      }
+   }
+
+   out.id = instrId;
+   out.words.clear();
+
+   // Point memory instructions somewhere inside our scratch window
+   auto mode = getAddressMode(instrId);
+
+   if (mode != AddressMode::None) {
+      auto target = dataAddress + ScratchTargetStart + rand() % (ScratchTargetEnd - ScratchTargetStart);
+      auto rA = AddressGprPool[rand() % array_size(AddressGprPool)];
+
+      if (instrId == InstructionID::lmw || instrId == InstructionID::stmw) {
+         // Keep rA out of the registers being loaded
+         instr.rD = 11 + rand() % 21;
+      } else if (isIntegerLoadWithUpdate(instrId)) {
+         while (instr.rD == rA) {
+            instr.rD = randomGpr(rand);
          }
-         case InstructionField::l:
-            // l always must be 0
-            instr.l = 0;
-            break;
+      }
 
-         default:
-            gLog->error("Instruction {} field {} is unsupported by fuzzer", data->name, (uint32_t)i);
-            return false;
+      instr.rA = rA;
+
+      if (mode == AddressMode::D) {
+         emitLoadImmediate(out.words, rA, target - sign_extend<16, int32_t>(instr.d));
+      } else if (mode == AddressMode::QD) {
+         emitLoadImmediate(out.words, rA, target - sign_extend<12, int32_t>(instr.qd));
+      } else {
+         auto rB = rA;
+
+         while (rB == rA) {
+            rB = AddressGprPool[rand() % array_size(AddressGprPool)];
          }
+
+         auto base = static_cast<uint32_t>(rand());
+         instr.rB = rB;
+         emitLoadImmediate(out.words, rA, base);
+         emitLoadImmediate(out.words, rB, target - base);
       }
    }
 
-   // Write an instruction
-   mem::write(instructionBase + 0, instr.value);
+   out.words.push_back(instr.value);
+   return true;
+}
 
-   // Write a return for the Interpreter
-   auto bclr = encodeInstruction(InstructionID::bclr);
-   bclr.bo = 0x1f;
-   mem::write(instructionBase + 4, bclr.value);
-
-#define STATEFIELDO(x, y) (StateField::Field)((int)x + y)
-   StateField::Field randFields[] = {
-      STATEFIELDO(StateField::GPR, 0),
-      STATEFIELDO(StateField::GPR, 5),
-      STATEFIELDO(StateField::GPR, 6),
-      STATEFIELDO(StateField::GPR, 7),
-      STATEFIELDO(StateField::GPR, 8),
-      STATEFIELDO(StateField::GPR, 9),
-      STATEFIELDO(StateField::FPR, 0),
-      STATEFIELDO(StateField::FPR, 1),
-      STATEFIELDO(StateField::FPR, 2),
-      STATEFIELDO(StateField::FPR, 3),
-      STATEFIELDO(StateField::GQR, 0),
-      STATEFIELDO(StateField::GQR, 1),
-      STATEFIELDO(StateField::GQR, 2),
-      STATEFIELDO(StateField::GQR, 3),
-      StateField::CR,
-      StateField::FPSCR,
-      StateField::XER,
-      StateField::CTR
+static uint32_t
+randomGprValue(std::mt19937 &rand)
+{
+   static const uint32_t special[] = {
+      0x00000000, 0x00000001, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0x0000FFFF, 0xFFFF8000,
    };
-#undef STATEFIELDO
-   size_t numRandFields = array_size(randFields);
-
-   // Build some randomized state data
-   cpu::Core iState, jState;
-   for (auto i = 0u; i < numRandFields; ++i) {
-      auto field = randFields[i];
-
-      TraceFieldValue v;
-      v.u32v0 = test_rand();
-      v.u32v1 = test_rand();
-      v.u32v2 = test_rand();
-      v.u32v3 = test_rand();
-
-      restoreStateField(&iState, field, v);
-      restoreStateField(&jState, field, v);
-   }
-
-   // Build some randomized memory data
-   const uint32_t memSize = 64;
-   uint8_t iMem[memSize], jMem[memSize];
-   for (auto i = 0u; i < memSize; ++i) {
-      auto randVal = (uint8_t)test_rand();
-      iMem[i] = randVal;
-      jMem[i] = randVal;
-   }
-
-   // Some instructions need to be forced to a certain address
-#define SETGPR(i, v) \
-   iState.gpr[i]=v; \
-   jState.gpr[i]=v;
-#define CONFIG_rA_rB() { \
-      auto d = static_cast<int32_t>(test_rand()); \
-      SETGPR(instr.rA, d); \
-      SETGPR(instr.rB, dataBase - d); \
-      break; }
-#define CONFIG_rA_D() { \
-      auto d = sign_extend<16, int32_t>(instr.d); \
-      SETGPR(instr.rA, dataBase - d); \
-      break; }
-#define CONFIG_rA_QD() { \
-      auto d = sign_extend<12, int32_t>(instr.qd); \
-      SETGPR(instr.rA, dataBase - d); \
-      break; }
-
-   switch (instrId) {
-   case InstructionID::lbz: CONFIG_rA_D();
-   case InstructionID::lbzu: CONFIG_rA_D();
-   case InstructionID::lha: CONFIG_rA_D();
-   case InstructionID::lhau: CONFIG_rA_D();
-   case InstructionID::lhz: CONFIG_rA_D();
-   case InstructionID::lhzu: CONFIG_rA_D();
-   case InstructionID::lwz: CONFIG_rA_D();
-   case InstructionID::lwzu: CONFIG_rA_D();
-   case InstructionID::lfs: CONFIG_rA_D();
-   case InstructionID::lfsu: CONFIG_rA_D();
-   case InstructionID::lfd: CONFIG_rA_D();
-   case InstructionID::lfdu: CONFIG_rA_D();
-   case InstructionID::lbzx: CONFIG_rA_rB();
-   case InstructionID::lbzux: CONFIG_rA_rB();
-   case InstructionID::lhax: CONFIG_rA_rB();
-   case InstructionID::lhaux: CONFIG_rA_rB();
-   case InstructionID::lhbrx: CONFIG_rA_rB();
-   case InstructionID::lhzx: CONFIG_rA_rB();
-   case InstructionID::lhzux: CONFIG_rA_rB();
-   case InstructionID::lwbrx: CONFIG_rA_rB();
-   case InstructionID::lwarx: CONFIG_rA_rB();
-   case InstructionID::lwzx: CONFIG_rA_rB();
-   case InstructionID::lwzux: CONFIG_rA_rB();
-   case InstructionID::lfsx: CONFIG_rA_rB();
-   case InstructionID::lfsux: CONFIG_rA_rB();
-   case InstructionID::lfdx: CONFIG_rA_rB();
-   case InstructionID::lfdux: CONFIG_rA_rB();
-
-   case InstructionID::stb: CONFIG_rA_D();
-   case InstructionID::stbu: CONFIG_rA_D();
-   case InstructionID::sth: CONFIG_rA_D();
-   case InstructionID::sthu: CONFIG_rA_D();
-   case InstructionID::stw: CONFIG_rA_D();
-   case InstructionID::stwu: CONFIG_rA_D();
-   case InstructionID::stfs: CONFIG_rA_D();
-   case InstructionID::stfsu: CONFIG_rA_D();
-   case InstructionID::stfd: CONFIG_rA_D();
-   case InstructionID::stfdu: CONFIG_rA_D();
-   case InstructionID::stbx: CONFIG_rA_rB();
-   case InstructionID::stbux: CONFIG_rA_rB();
-   case InstructionID::sthx: CONFIG_rA_rB();
-   case InstructionID::sthux: CONFIG_rA_rB();
-   case InstructionID::stwx: CONFIG_rA_rB();
-   case InstructionID::stwux: CONFIG_rA_rB();
-   case InstructionID::sthbrx: CONFIG_rA_rB();
-   case InstructionID::stwbrx: CONFIG_rA_rB();
-   case InstructionID::stwcx: CONFIG_rA_rB();
-   case InstructionID::stfsx: CONFIG_rA_rB();
-   case InstructionID::stfsux: CONFIG_rA_rB();
-   case InstructionID::stfdx: CONFIG_rA_rB();
-   case InstructionID::stfdux: CONFIG_rA_rB();
-   case InstructionID::stfiwx: CONFIG_rA_rB();
-
-   case InstructionID::psq_l: CONFIG_rA_QD();
-   case InstructionID::psq_lx: CONFIG_rA_rB();
-   case InstructionID::psq_lu: CONFIG_rA_QD();
-   case InstructionID::psq_lux: CONFIG_rA_rB();
-
-   case InstructionID::dcbz: CONFIG_rA_rB();
-   case InstructionID::dcbz_l: CONFIG_rA_rB();
 
+   switch (rand() % 4) {
+   case 0:
+      return special[rand() % array_size(special)];
+   case 1:
+      return static_cast<uint32_t>(static_cast<int32_t>(rand() % 64) - 32);
    default:
+      return rand();
+   }
+}
+
+static uint64_t
+randomFprValue(std::mt19937 &rand)
+{
+   static const uint64_t special[] = {
+      0x0000000000000000ull, // +0
+      0x8000000000000000ull, // -0
+      0x3FF0000000000000ull, // 1
+      0xBFF0000000000000ull, // -1
+      0x7FF0000000000000ull, // +inf
+      0xFFF0000000000000ull, // -inf
+      0x7FF8000000000000ull, // QNaN
+      0x7FF4000000000000ull, // SNaN
+      0x0000000000000001ull, // Smallest double denormal
+      0x7FEFFFFFFFFFFFFFull, // Largest double
+      0x36A0000000000000ull, // Smallest single denormal
+      0x47EFFFFFE0000000ull, // Largest single
+   };
+   double value;
+   uint64_t bits;
+
+   switch (rand() % 4) {
+   case 0:
+      return special[rand() % array_size(special)];
+   case 1:
+   {
+      // Something a paired single instruction would produce
+      uint32_t singleBits = rand();
+      float single;
+      std::memcpy(&single, &singleBits, sizeof(single));
+      value = static_cast<double>(single);
       break;
    }
+   case 2:
+      value = static_cast<double>(static_cast<int32_t>(rand() % 2048) - 1024) / 16.0;
+      break;
+   default:
+      return (static_cast<uint64_t>(rand()) << 32) | rand();
+   }
 
-#undef SETGPR
-#undef CONFIG_rA_rB
-#undef CONFIG_rA_D
-#undef CONFIG_rA_QD
+   std::memcpy(&bits, &value, sizeof(bits));
+   return bits;
+}
 
+static uint32_t
+randomGqrValue(std::mt19937 &rand)
+{
+   static const uint32_t validTypes[] = { 0, 4, 5, 6, 7 };
+   gqr_t gqr;
+   gqr.value = 0;
+   gqr.st_type = validTypes[rand() % array_size(validTypes)];
+   gqr.st_scale = rand();
+   gqr.ld_type = validTypes[rand() % array_size(validTypes)];
+   gqr.ld_scale = rand();
+   return gqr.value;
+}
 
-   // Disable Reserveds for now
-   iState.reserve = false;
-   jState.reserve = false;
+static bool
+generateCase(uint32_t seed,
+             uint32_t dataAddress,
+             const FuzzOptions &options,
+             FuzzCase &fuzzCase)
+{
+   std::mt19937 rand(seed);
+   fuzzCase.seed = seed;
+   fuzzCase.dataAddress = dataAddress;
+   fuzzCase.sequence.resize(1 + rand() % options.maxLength);
 
-   // Required to be set to this
-   iState.tracer = nullptr;
-   iState.cia = 0;
-   iState.nia = instructionBase;
-   jState.tracer = nullptr;
-   jState.cia = 0;
-   jState.nia = instructionBase;
+   for (auto &instr : fuzzCase.sequence) {
+      auto instrId = sInstructionPool[rand() % sInstructionPool.size()];
 
-   {
-      memcpy(mem::translate(dataBase), iMem, memSize);
-      // TODO: FIX ME!
-      //cpu::interpreter::executeSub(&iState);
-      memcpy(iMem, mem::translate(dataBase), memSize);
+      if (!generateInstruction(rand, instrId, dataAddress, instr)) {
+         return false;
+      }
    }
 
-   {
-      cpu::jit::clearCache();
+   auto &state = fuzzCase.state;
+   std::memset(&state, 0, sizeof(state));
 
-      memcpy(mem::translate(dataBase), jMem, memSize);
-      // TODO: FIX ME!
-      //cpu::jit::executeSub(&jState);
-      memcpy(jMem, mem::translate(dataBase), memSize);
+   for (auto i = 0; i < 32; ++i) {
+      state.gpr[i] = randomGprValue(rand);
+      state.fpr[i].idw = randomFprValue(rand);
+      state.fpr[i].idw_paired1 = randomFprValue(rand);
    }
 
-   for (auto i = 0u; i < numRandFields; ++i) {
-      auto field = randFields[i];
+   for (auto i = 0; i < 8; ++i) {
+      state.gqr[i].value = randomGqrValue(rand);
+   }
 
-      TraceFieldValue iVal, jVal;
-      saveStateField(&iState, field, iVal);
-      saveStateField(&jState, field, jVal);
+   state.cr.value = rand();
+   state.xer.value = rand() & 0xE000007F;
+   state.ctr = rand();
+   state.fpscr.value = rand() & 3;
 
-      if (!compareStateField(field, iVal, jVal)) {
-         gLog->warn("{}({:08x}) :: JIT does not match Interp on {}", data->name, test_seed, getStateFieldName(field));
-      }
+   for (auto &byte : fuzzCase.memory) {
+      byte = static_cast<uint8_t>(rand());
    }
 
    return true;
 }
 
+static void
+executeCase(const FuzzCase &fuzzCase,
+            uint32_t codeAddress,
+            bool useJit,
+            FuzzResult &result)
+{
+   cpu::Core core;
+   std::memcpy(static_cast<cpu::CoreRegs *>(&core), &fuzzCase.state, sizeof(cpu::CoreRegs));
+   core.tracer = nullptr;
+   core.id = cpu::InvalidCoreId;
+   core.cia = 0;
+   core.nia = codeAddress;
+   core.lr = cpu::CALLBACK_ADDR;
+
+   std::memcpy(mem::translate(fuzzCase.dataAddress), fuzzCase.memory.data(), ScratchSize);
+   cpu::this_core::setState(&core);
+
+   if (useJit) {
+      cpu::jit::resume();
+   } else {
+      cpu::interpreter::resume();
+   }
+
+   cpu::this_core::setState(nullptr);
+   std::memcpy(&result.state, static_cast<cpu::CoreRegs *>(&core), sizeof(cpu::CoreRegs));
+   std::memcpy(result.memory.data(), mem::translate(fuzzCase.dataAddress), ScratchSize);
+}
+
+static bool
+isNaN(uint64_t bits)
+{
+   return (bits & 0x7FF0000000000000ull) == 0x7FF0000000000000ull
+       && (bits & 0x000FFFFFFFFFFFFFull) != 0;
+}
+
+static bool
+compareFpr(uint64_t x, uint64_t y, const FuzzOptions &options)
+{
+   if (x == y) {
+      return true;
+   }
+
+   return !options.strictNaN && isNaN(x) && isNaN(y);
+}
+
+static std::vector<std::string>
+compareResults(const FuzzResult &interp,
+               const FuzzResult &jit,
+               const FuzzOptions &options)
+{
+   std::vector<std::string> differences;
+   auto &i = interp.state;
+   auto &j = jit.state;
+
+   auto compare = [&](const std::string &name, uint32_t found, uint32_t expected) {
+      if (found != expected) {
+         differences.push_back(fmt::format("{} found 0x{:08X} expected 0x{:08X}", name, found, expected));
+      }
+   };
+
+   compare("NIA", j.nia, i.nia);
+
+   for (auto n = 0; n < 32; ++n) {
+      compare(fmt::format("r{}", n), j.gpr[n], i.gpr[n]);
+   }
+
+   for (auto n = 0; n < 32; ++n) {
+      if (!compareFpr(j.fpr[n].idw, i.fpr[n].idw, options)) {
+         differences.push_back(fmt::format("f{} found 0x{:016X} ({:g}) expected 0x{:016X} ({:g})",
+                                           n, j.fpr[n].idw, j.fpr[n].value, i.fpr[n].idw, i.fpr[n].value));
+      }
+
+      if (!compareFpr(j.fpr[n].idw_paired1, i.fpr[n].idw_paired1, options)) {
+         differences.push_back(fmt::format("ps1 f{} found 0x{:016X} ({:g}) expected 0x{:016X} ({:g})",
+                                           n, j.fpr[n].idw_paired1, j.fpr[n].paired1, i.fpr[n].idw_paired1, i.fpr[n].paired1));
+      }
+   }
+
+   for (auto n = 0; n < 8; ++n) {
+      compare(fmt::format("GQR{}", n), j.gqr[n].value, i.gqr[n].value);
+   }
+
+   compare("CR", j.cr.value, i.cr.value);
+   compare("XER", j.xer.value, i.xer.value);
+   compare("LR", j.lr, i.lr);
+   compare("CTR", j.ctr, i.ctr);
+
+   if (options.checkFpscr) {
+      compare("FPSCR", j.fpscr.value, i.fpscr.value);
+   }
+
+   for (auto n = 0u; n < ScratchSize; ++n) {
+      if (jit.memory[n] != interp.memory[n]) {
+         differences.push_back(fmt::format("Memory at +0x{:03X} found 0x{:02X} expected 0x{:02X}",
+                                           n, jit.memory[n], interp.memory[n]));
+      }
+   }
+
+   return differences;
+}
+
+/**
+ * Run a case through both the interpreter and the JIT and return how the
+ * JIT result differs from the interpreter, an empty list means it passed.
+ */
+static std::vector<std::string>
+runCase(const FuzzCase &fuzzCase,
+        const FuzzOptions &options)
+{
+   auto slot = sNextCodeSlot.fetch_add(1);
+   decaf_check(slot < BatchSize);
+
+   auto codeAddress = CodeBase + slot * CodeSlotSize;
+   auto address = codeAddress;
+
+   for (auto &instr : fuzzCase.sequence) {
+      for (auto word : instr.words) {
+         mem::write(address, word);
+         address += 4;
+      }
+   }
+
+   auto bclr = encodeInstruction(InstructionID::bclr);
+   bclr.bo = 20;
+   bclr.bi = 0;
+   mem::write(address, bclr.value);
+
+   FuzzResult interp, jit;
+   executeCase(fuzzCase, codeAddress, false, interp);
+   executeCase(fuzzCase, codeAddress, true, jit);
+   return compareResults(interp, jit, options);
+}
+
+// Forget every JIT block and start handing out code slots from the start
+static void
+resetCodeSlots()
+{
+   cpu::jit::clearCache();
+   sNextCodeSlot.store(0);
+}
+
+/**
+ * Shrink a failing case by removing instructions and then zeroing its
+ * initial state piece by piece, keeping every change which still fails.
+ */
+static FuzzCase
+minimiseCase(const FuzzCase &fuzzCase,
+             const FuzzOptions &options)
+{
+   auto best = fuzzCase;
+   auto stillFails = [&](const FuzzCase &candidate) {
+      return !runCase(candidate, options).empty();
+   };
+
+   resetCodeSlots();
+
+   for (auto progress = true; progress && best.sequence.size() > 1; ) {
+      progress = false;
+
+      for (auto i = best.sequence.size(); i-- > 0 && best.sequence.size() > 1; ) {
+         auto candidate = best;
+         candidate.sequence.erase(candidate.sequence.begin() + i);
+
+         if (stillFails(candidate)) {
+            best = candidate;
+            progress = true;
+         }
+      }
+   }
+
+   for (auto i = 0; i < 32; ++i) {
+      auto candidate = best;
+      candidate.state.gpr[i] = 0;
+
+      if (candidate.state.gpr[i] != best.state.gpr[i] && stillFails(candidate)) {
+         best = candidate;
+      }
+   }
+
+   for (auto i = 0; i < 32; ++i) {
+      auto candidate = best;
+      candidate.state.fpr[i].idw = 0;
+      candidate.state.fpr[i].idw_paired1 = 0;
+
+      if ((best.state.fpr[i].idw || best.state.fpr[i].idw_paired1) && stillFails(candidate)) {
+         best = candidate;
+      }
+   }
+
+   auto candidate = best;
+   candidate.state.cr.value = 0;
+   candidate.state.xer.value = 0;
+   candidate.state.ctr = 0;
+
+   if (stillFails(candidate)) {
+      best = candidate;
+   }
+
+   candidate = best;
+   candidate.memory.fill(0);
+
+   if (stillFails(candidate)) {
+      best = candidate;
+   }
+
+   return best;
+}
+
+static std::string
+disassemble(uint32_t instr,
+            uint32_t address)
+{
+   espresso::Disassembly disassembly;
+
+   if (!espresso::disassemble(static_cast<espresso::Instruction>(instr), disassembly, address)) {
+      return "<invalid>";
+   }
+
+   return disassembly.text;
+}
+
+static void
+reportFailure(const FuzzCase &original,
+              const FuzzCase &minimised,
+              const FuzzOptions &options)
+{
+   gLog->error("Case {:08X} failed, minimised from {} to {} instructions",
+               original.seed, original.sequence.size(), minimised.sequence.size());
+
+   auto address = uint32_t { 0 };
+
+   for (auto &instr : minimised.sequence) {
+      for (auto word : instr.words) {
+         gLog->error("   {:04X}: {:08X}  {}", address, word, disassemble(word, address));
+         address += 4;
+      }
+   }
+
+   auto &state = minimised.state;
+
+   for (auto i = 0; i < 32; ++i) {
+      if (state.gpr[i]) {
+         gLog->error("   Initial r{} = 0x{:08X}", i, state.gpr[i]);
+      }
+   }
+
+   for (auto i = 0; i < 32; ++i) {
+      if (state.fpr[i].idw || state.fpr[i].idw_paired1) {
+         gLog->error("   Initial f{} = 0x{:016X} ({:g}), ps1 0x{:016X} ({:g})",
+                     i, state.fpr[i].idw, state.fpr[i].value, state.fpr[i].idw_paired1, state.fpr[i].paired1);
+      }
+   }
+
+   gLog->error("   Initial CR = 0x{:08X}, XER = 0x{:08X}, CTR = 0x{:08X}, FPSCR = 0x{:08X}",
+               state.cr.value, state.xer.value, state.ctr, state.fpscr.value);
+
+   for (auto &difference : runCase(minimised, options)) {
+      gLog->error("   {}", difference);
+   }
+}
+
 bool
-executeFuzzTests(uint32_t suite_seed)
+executeFuzzTests(const FuzzOptions &options)
 {
-   if (!setupFuzzData()) {
+   if (options.maxLength < 1 || options.maxLength > MaxSequenceLength) {
+      gLog->error("Sequence length must be between 1 and {}", MaxSequenceLength);
+      return false;
+   }
+
+   if (!setupFuzzData(options)) {
       return false;
    }
 
-   std::mt19937 suite_rand(suite_seed);
+   auto numThreads = options.threads ? options.threads : std::thread::hardware_concurrency();
+   numThreads = std::max(1u, std::min(numThreads, MaxWorkers));
+
+   if (options.singleCase) {
+      numThreads = 1;
+   }
+
+   gLog->info("Fuzzing {} instructions on {} threads", sInstructionPool.size(), numThreads);
+
+   // Case seeds come from the suite seed alone, so the same cases run
+   //  regardless of how many threads we use.
+   std::mt19937 suite_rand(options.seed);
+   std::vector<FuzzCase> failures;
+   auto numCases = options.singleCase ? 1u : options.cases;
+   auto casesRun = 0u;
+
+   while (casesRun < numCases && failures.size() < options.maxFailures) {
+      auto batchSize = std::min(numCases - casesRun, BatchSize);
+      std::vector<uint32_t> seeds(batchSize);
+      std::vector<FuzzCase> batchFailures;
+      std::vector<std::thread> workers;
+      std::atomic<uint32_t> nextCase { 0 };
+      std::atomic<bool> generateFailed { false };
+      std::mutex failuresMutex;
 
-   for (auto i = 0; i < 10000; ++i) {
-      if (false) {
-         gLog->info("Executing test {}", i);
+      for (auto &seed : seeds) {
+         seed = options.singleCase ? options.caseSeed : suite_rand();
       }
 
-      executeInstrTest(suite_rand());
+      resetCodeSlots();
+
+      for (auto w = 0u; w < numThreads; ++w) {
+         workers.emplace_back([&, w]() {
+            auto dataAddress = DataBase + w * ScratchSize;
+            FuzzCase fuzzCase;
+
+            while (!generateFailed) {
+               auto index = nextCase.fetch_add(1);
+
+               if (index >= batchSize) {
+                  break;
+               }
+
+               if (!generateCase(seeds[index], dataAddress, options, fuzzCase)) {
+                  generateFailed = true;
+                  break;
+               }
+
+               if (!runCase(fuzzCase, options).empty()) {
+                  std::unique_lock<std::mutex> lock { failuresMutex };
+                  batchFailures.push_back(fuzzCase);
+               }
+            }
+         });
+      }
+
+      for (auto &worker : workers) {
+         worker.join();
+      }
+
+      if (generateFailed) {
+         return false;
+      }
+
+      casesRun += batchSize;
+
+      // Report in seed order so output does not depend on thread timing
+      std::sort(batchFailures.begin(), batchFailures.end(),
+                [&](const FuzzCase &lhs, const FuzzCase &rhs) {
+                   return std::find(seeds.begin(), seeds.end(), lhs.seed) < std::find(seeds.begin(), seeds.end(), rhs.seed);
+                });
+
+      for (auto &failure : batchFailures) {
+         if (failures.size() >= options.maxFailures) {
+            break;
+         }
+
+         reportFailure(failure, minimiseCase(failure, options), options);
+         failures.push_back(failure);
+      }
+
+      gLog->info("Ran {} of {} cases, {} failed", casesRun, numCases, failures.size());
    }
 
-   return true;
+   return failures.empty();
 }
@@ -1,5 +1,38 @@
 #pragma once
 #include <cstdint>
+#include <string>
+#include <vector>
+
+struct FuzzOptions
+{
+   //! Seed used to generate the seed of every case
+   uint32_t seed = 0x12345678;
+
+   //! Number of host threads to run cases on, 0 to use every hardware thread
+   unsigned threads = 0;
+
+   //! Number of cases to run
+   unsigned cases = 100000;
+
+   //! Maximum number of instructions in a case
+   unsigned maxLength = 8;
+
+   //! Stop after this many failing cases
+   unsigned maxFailures = 10;
+
+   //! Only run the case with this seed, used to reproduce a failure
+   bool singleCase = false;
+   uint32_t caseSeed = 0;
+
+   //! Only generate these instructions, every instruction when empty
+   std::vector<std::string> instructions;
+
+   //! Compare FPSCR, which the JIT does not fully maintain
+   bool checkFpscr = false;
+
+   //! Treat NaNs with different bit patterns as different
+   bool strictNaN = false;
+};
 
 bool
-executeFuzzTests(uint32_t suite_seed = 0x12345678);
+executeFuzzTests(const FuzzOptions &options);
@@ -1,5 +1,8 @@
+#include <cstdlib>
+#include <iostream>
 #include <memory>
 #include <spdlog/spdlog.h>
+#include <string>
 #include "fuzztests.h"
 #include "libcpu/cpu.h"
 #include "libcpu/mem.h"
@@ -9,14 +12,42 @@ gLog;
 
 int main(int argc, char *argv[])
 {
-   gLog = std::make_shared<spdlog::logger>("logger", std::make_shared<spdlog::sinks::stdout_sink_st>());
-   gLog->set_level(spdlog::level::debug);
+   FuzzOptions options;
+
+   for (auto i = 1; i < argc; ++i) {
+      auto arg = std::string { argv[i] };
+
+      if (arg == "--seed" && i + 1 < argc) {
+         options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+      } else if (arg == "--threads" && i + 1 < argc) {
+         options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+      } else if (arg == "--cases" && i + 1 < argc) {
+         options.cases = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+      } else if (arg == "--length" && i + 1 < argc) {
+         options.maxLength = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+      } else if (arg == "--max-failures" && i + 1 < argc) {
+         options.maxFailures = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+      } else if (arg == "--case" && i + 1 < argc) {
+         options.singleCase = true;
+         options.caseSeed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 16));
+      } else if (arg == "--instruction" && i + 1 < argc) {
+         options.instructions.push_back(argv[++i]);
+      } else if (arg == "--check-fpscr") {
+         options.checkFpscr = true;
+      } else if (arg == "--strict-nan") {
+         options.strictNaN = true;
+      } else {
+         std::cout << "Usage: fuzztests [--seed n] [--threads n] [--cases n] [--length n] [--max-failures n]" << std::endl
+                   << "                 [--case hexseed] [--instruction name]... [--check-fpscr] [--strict-nan]" << std::endl;
+         return -1;
+      }
+   }
+
+   gLog = std::make_shared<spdlog::logger>("logger", std::make_shared<spdlog::sinks::stdout_sink_mt>());
+   gLog->set_level(spdlog::level::info);
 
    mem::initialise();
    cpu::initialise();
 
-   auto result = executeFuzzTests() ? 0 : 1;
-
-   system("PAUSE");
-   return result;
+   return executeFuzzTests(options) ? 0 : 1;
 }
@@ -0,0 +1,219 @@
+#include "common/platform.h"
+#include "libcpu/cpu.h"
+#include "libcpu/mem.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+#ifdef PLATFORM_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Repeatedly runs the tests/cpu/achurch.bin workload and reports how long it
+//  took along with the host dTLB misses and instructions retired, so that
+//  runs with and without --huge-pages can be compared.
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+static std::vector<char>
+sProgram;
+
+static unsigned
+sNumRuns = 20;
+
+#ifdef PLATFORM_LINUX
+class PerfCounter
+{
+public:
+   PerfCounter(uint32_t type, uint64_t config)
+   {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = type;
+      attr.config = config;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      mFd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+   }
+
+   ~PerfCounter()
+   {
+      if (mFd != -1) {
+         close(mFd);
+      }
+   }
+
+   bool
+   valid() const
+   {
+      return mFd != -1;
+   }
+
+   void
+   start()
+   {
+      if (mFd != -1) {
+         ioctl(mFd, PERF_EVENT_IOC_RESET, 0);
+         ioctl(mFd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+   }
+
+   uint64_t
+   stop()
+   {
+      uint64_t value = 0;
+
+      if (mFd != -1) {
+         ioctl(mFd, PERF_EVENT_IOC_DISABLE, 0);
+
+         if (read(mFd, &value, sizeof(value)) != sizeof(value)) {
+            value = 0;
+         }
+      }
+
+      return value;
+   }
+
+private:
+   int mFd = -1;
+};
+#endif
+
+static bool
+runWorkload()
+{
+   std::memcpy(mem::translate<char>(0x01000000), sProgram.data(), sProgram.size());
+
+   auto core = cpu::this_core::state();
+   core->nia = 0x01000000;
+   core->gpr[3] = 0;
+   core->gpr[4] = 0x04000000;
+   core->gpr[5] = 0x02000000;
+   core->fpr[1].paired0 = 1.0;
+   cpu::this_core::executeSub();
+
+   return core->gpr[3] == 0;
+}
+
+static void
+runBenchmark()
+{
+#ifdef PLATFORM_LINUX
+   PerfCounter tlbMisses {
+      PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_DTLB
+         | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+   };
+   PerfCounter instructions { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS };
+   auto totalTlbMisses = uint64_t { 0 };
+   auto totalInstructions = uint64_t { 0 };
+#endif
+
+   // Run once first so the JIT has compiled everything before we measure
+   if (!runWorkload()) {
+      std::cout << "Warning: workload reported failed tests" << std::endl;
+   }
+
+   auto start = std::chrono::high_resolution_clock::now();
+
+   for (auto i = 0u; i < sNumRuns; ++i) {
+#ifdef PLATFORM_LINUX
+      tlbMisses.start();
+      instructions.start();
+#endif
+
+      runWorkload();
+
+#ifdef PLATFORM_LINUX
+      totalInstructions += instructions.stop();
+      totalTlbMisses += tlbMisses.stop();
+#endif
+   }
+
+   auto end = std::chrono::high_resolution_clock::now();
+   auto seconds = std::chrono::duration<double>(end - start).count();
+
+   std::cout << sNumRuns << " runs in " << seconds << "s, "
+             << (seconds * 1000.0 / sNumRuns) << "ms per run" << std::endl;
+
+#ifdef PLATFORM_LINUX
+   if (tlbMisses.valid()) {
+      std::cout << "dTLB load misses: " << (totalTlbMisses / sNumRuns) << " per run" << std::endl;
+   } else {
+      std::cout << "dTLB load misses: unavailable" << std::endl;
+   }
+
+   if (instructions.valid()) {
+      std::cout << "Host instructions: " << (totalInstructions / sNumRuns) << " per run, "
+                << (totalInstructions / seconds / 1e6) << "M per second" << std::endl;
+   } else {
+      std::cout << "Host instructions: unavailable" << std::endl;
+   }
+#endif
+}
+
+int
+main(int argc, char **argv)
+{
+   auto hugePages = false;
+   auto jitMode = cpu::jit_mode::enabled;
+   auto path = std::string { "tests/cpu/achurch.bin" };
+
+   for (auto i = 1; i < argc; ++i) {
+      auto arg = std::string { argv[i] };
+
+      if (arg == "--huge-pages") {
+         hugePages = true;
+      } else if (arg == "--interpreter") {
+         jitMode = cpu::jit_mode::disabled;
+      } else if (arg == "--runs" && i + 1 < argc) {
+         sNumRuns = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+      } else if (arg == "--program" && i + 1 < argc) {
+         path = argv[++i];
+      } else {
+         std::cout << "Usage: mem-bench [--huge-pages] [--interpreter] [--runs n] [--program path]" << std::endl;
+         return -1;
+      }
+   }
+
+   gLog = std::make_shared<spdlog::logger>("logger", std::make_shared<spdlog::sinks::stdout_sink_st>());
+   gLog->set_level(spdlog::level::warn);
+
+   std::ifstream file { path, std::ifstream::in | std::ifstream::binary };
+
+   if (!file.is_open()) {
+      std::cout << "Could not open " << path << std::endl;
+      return -1;
+   }
+
+   sProgram.assign(std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> { });
+
+   mem::setHugePagesEnabled(hugePages);
+   mem::initialise();
+   cpu::initialise();
+   cpu::setJitMode(jitMode);
+
+   cpu::setCoreEntrypointHandler(
+      []() {
+         if (cpu::this_core::id() == 1) {
+            runBenchmark();
+         }
+      });
+
+   cpu::start();
+   cpu::join();
+   return 0;
+}